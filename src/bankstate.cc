@@ -181,10 +181,48 @@ void BankState::UpdateState(const Command& cmd) {
     return;
 }
 
+bool BankState::FunctionalAccess(int row, bool close_page) {
+    bool row_hit = state_ == State::OPEN && open_row_ == row;
+    if (close_page) {
+        state_ = State::CLOSED;
+        open_row_ = -1;
+        row_hit_count_ = 0;
+    } else if (row_hit) {
+        row_hit_count_++;
+    } else {
+        state_ = State::OPEN;
+        open_row_ = row;
+        row_hit_count_ = 1;
+    }
+    return row_hit;
+}
+
 void BankState::UpdateTiming(CommandType cmd_type, uint64_t time) {
     cmd_timing_[static_cast<int>(cmd_type)] =
         std::max(cmd_timing_[static_cast<int>(cmd_type)], time);
     return;
 }
 
+void BankState::SaveState(CheckpointWriter& ckpt) const {
+    Save(ckpt, state_);
+    Save(ckpt, cmd_timing_);
+    Save(ckpt, open_row_);
+    Save(ckpt, row_hit_count_);
+    Save(ckpt, in_serve);
+    Save(ckpt, serve_end_cycle);
+    Save(ckpt, precharge_by_refresh);
+    Save(ckpt, activate_by_who);
+}
+
+void BankState::LoadState(CheckpointReader& ckpt) {
+    Load(ckpt, state_);
+    Load(ckpt, cmd_timing_);
+    Load(ckpt, open_row_);
+    Load(ckpt, row_hit_count_);
+    Load(ckpt, in_serve);
+    Load(ckpt, serve_end_cycle);
+    Load(ckpt, precharge_by_refresh);
+    Load(ckpt, activate_by_who);
+}
+
 }  // namespace dramsim3
@@ -2,6 +2,7 @@
 #define __BANKSTATE_H
 
 #include <vector>
+#include "checkpoint.h"
 #include "common.h"
 
 namespace dramsim3 {
@@ -19,6 +20,10 @@ class BankState {
     // Update the existing timing constraints for the command
     void UpdateTiming(const CommandType cmd_type, uint64_t time);
 
+    // Functional (timing-less) access to row, leaves the bank in the state
+    // the equivalent ACT/READ(P)/WRITE(P) sequence would, returns row hit
+    bool FunctionalAccess(int row, bool close_page);
+
     bool IsRowOpen() const { return state_ == State::OPEN; }
     int OpenRow() const { return open_row_; }
     int RowHitCount() const { return row_hit_count_; }
@@ -35,6 +40,9 @@ class BankState {
     bool ReturnActivateByWho() const { return activate_by_who; }
     //MZOU
 
+    void SaveState(CheckpointWriter& ckpt) const;
+    void LoadState(CheckpointReader& ckpt);
+
    private:
     // Current state of the Bank
     // Apriori or instantaneously transitions on a command.
@@ -0,0 +1,565 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "./../ext/headers/args.hxx"
+#include "channel_state.h"
+#include "command_queue.h"
+#include "controller.h"
+#include "fmt/format.h"
+#include "memory_system.h"
+#include "simple_stats.h"
+#include "timing.h"
+
+// Microbenchmarks of the simulator hot paths. Every result is printed as one
+// JSON object per line so that runs from different commits can be diffed or
+// loaded into a dataframe directly.
+
+using namespace dramsim3;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// results of the timed bodies are folded in here so they can't be elided
+volatile uint64_t g_sink = 0;
+
+struct BenchOptions {
+    std::string config_dir;
+    std::string output_dir;
+    std::string filter;
+    int repeats;
+    uint64_t ops;
+    uint64_t cycles;
+    int threads;
+};
+
+// Times body(ops) repeats times and reports the best and median ns per op,
+// body returns a value that is folded into g_sink so it is not optimized out.
+// setup(ops), if given, runs before each repetition outside of the timing
+void Report(const BenchOptions& opts, const std::string& name,
+            const std::string& config, const std::string& param, uint64_t ops,
+            const std::function<uint64_t(uint64_t)>& body,
+            const std::function<void(uint64_t)>& setup = nullptr) {
+    if (!opts.filter.empty() && name.find(opts.filter) == std::string::npos) {
+        return;
+    }
+    std::vector<double> ns_per_op;
+    for (int r = 0; r < opts.repeats; r++) {
+        if (setup) {
+            setup(ops);
+        }
+        auto start = Clock::now();
+        g_sink = g_sink + body(ops);
+        auto end = Clock::now();
+        double ns =
+            std::chrono::duration<double, std::nano>(end - start).count();
+        ns_per_op.push_back(ns / ops);
+    }
+    std::sort(ns_per_op.begin(), ns_per_op.end());
+    double best = ns_per_op.front();
+    double median = ns_per_op[ns_per_op.size() / 2];
+    std::cout << fmt::format(
+                     "{{\"bench\": \"{}\", \"config\": \"{}\", \"param\": "
+                     "\"{}\", \"ops\": {}, \"repeats\": {}, \"best_ns_per_op\": "
+                     "{:.3f}, \"median_ns_per_op\": {:.3f}, "
+                     "\"ops_per_sec\": {:.1f}}}",
+                     name, config, param, ops, opts.repeats, best, median,
+                     1e9 / median)
+              << std::endl;
+}
+
+std::vector<uint64_t> RandomAddresses(uint64_t n, uint64_t seed) {
+    std::mt19937_64 gen(seed);
+    std::vector<uint64_t> addrs(n);
+    for (auto& a : addrs) {
+        a = gen();
+    }
+    return addrs;
+}
+
+void BenchAddressMapping(const BenchOptions& opts, const std::string& name,
+                         const Config& config) {
+    auto addrs = RandomAddresses(4096, 1);
+    Report(opts, "address_mapping", name, "", opts.ops, [&](uint64_t ops) {
+        uint64_t acc = 0;
+        for (uint64_t i = 0; i < ops; i++) {
+            auto addr = config.AddressMapping(addrs[i & 4095]);
+            acc += addr.channel + addr.bank + addr.row + addr.column;
+        }
+        return acc;
+    });
+}
+
+// the config's own fields with the low column bits below the bank group,
+// a layout only address_bits can express
+std::string SplitLayout(const Config& config) {
+    auto width = [](uint64_t mask) {
+        return LogBase2(static_cast<int>(mask + 1));
+    };
+    int co = width(config.co_mask);
+    return fmt::format("ro{} ch{} ra{} ba{} co{} bg{} co{}",
+                       width(config.ro_mask), width(config.ch_mask),
+                       width(config.ra_mask), width(config.ba_mask), co - 2,
+                       width(config.bg_mask), 2);
+}
+
+void BenchAddressBits(const BenchOptions& opts, const std::string& name,
+                      const std::string& config_file) {
+    INIReader ini(config_file);
+    Config plain(ini, ConfigOverrides(), opts.output_dir);
+    Config config(ini, {{"system.address_bits", SplitLayout(plain)}},
+                  opts.output_dir);
+    auto addrs = RandomAddresses(4096, 5);
+#ifdef __BMI2__
+    for (auto addr : addrs) {
+        if (config.GatherFieldsLUT(addr) != config.GatherFieldsPEXT(addr)) {
+            std::cerr << "PEXT and table decoding differ for " << std::hex
+                      << addr << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+    }
+#endif  // __BMI2__
+    Report(opts, "address_mapping", name, "address_bits", opts.ops,
+           [&](uint64_t ops) {
+               uint64_t acc = 0;
+               for (uint64_t i = 0; i < ops; i++) {
+                   auto addr = config.AddressMapping(addrs[i & 4095]);
+                   acc += addr.channel + addr.bank + addr.row + addr.column;
+               }
+               return acc;
+           });
+    Report(opts, "address_gather", name, "lut", opts.ops, [&](uint64_t ops) {
+        uint64_t acc = 0;
+        for (uint64_t i = 0; i < ops; i++) {
+            acc += config.GatherFieldsLUT(addrs[i & 4095]);
+        }
+        return acc;
+    });
+#ifdef __BMI2__
+    Report(opts, "address_gather", name, "pext", opts.ops, [&](uint64_t ops) {
+        uint64_t acc = 0;
+        for (uint64_t i = 0; i < ops; i++) {
+            acc += config.GatherFieldsPEXT(addrs[i & 4095]);
+        }
+        return acc;
+    });
+#endif  // __BMI2__
+}
+
+// mixed radix mapping of a non power of two organization
+void BenchRadixMapping(const BenchOptions& opts, const std::string& name,
+                       const std::string& config_file) {
+    INIReader ini(config_file);
+    Config config(ini, {{"system.channels", "3"}}, opts.output_dir);
+    auto addrs = RandomAddresses(4096, 6);
+    Report(opts, "address_mapping", name, "channels=3", opts.ops,
+           [&](uint64_t ops) {
+               uint64_t acc = 0;
+               for (uint64_t i = 0; i < ops; i++) {
+                   auto addr = config.AddressMapping(addrs[i & 4095]);
+                   acc += addr.channel + addr.bank + addr.row + addr.column;
+               }
+               return acc;
+           });
+}
+
+void BenchAddTransaction(const BenchOptions& opts, const std::string& name,
+                         const Config& config, const Timing& timing,
+                         const OutputNames& outputs) {
+    // fill fresh controllers up to their queue capacity, constructing them
+    // is left out of the timed region
+    auto addrs = RandomAddresses(config.trans_queue_size, 2);
+    std::vector<std::unique_ptr<Controller>> ctrls;
+    auto setup = [&](uint64_t ops) {
+        ctrls.clear();
+        for (uint64_t i = 0; i < ops; i += addrs.size()) {
+            ctrls.emplace_back(new Controller(0, config, timing, outputs));
+        }
+    };
+    Report(opts, "controller_add_transaction", name, "", opts.ops / 10,
+           [&](uint64_t ops) {
+               uint64_t acc = 0;
+               for (uint64_t i = 0; i < ops; i++) {
+                   auto& ctrl = ctrls[i / addrs.size()];
+                   uint64_t addr = addrs[i % addrs.size()];
+                   bool is_write = (i % 3 == 0);
+                   if (ctrl->WillAcceptTransaction(addr, is_write)) {
+                       acc += ctrl->AddTransaction(Transaction(addr, is_write));
+                   }
+               }
+               return acc;
+           },
+           setup);
+    Report(opts, "controller_add_transaction", name, "try_add", opts.ops / 10,
+           [&](uint64_t ops) {
+               uint64_t acc = 0;
+               for (uint64_t i = 0; i < ops; i++) {
+                   auto& ctrl = ctrls[i / addrs.size()];
+                   uint64_t addr = addrs[i % addrs.size()];
+                   bool is_write = (i % 3 == 0);
+                   acc += IsAccepted(
+                       ctrl->TryAddTransaction(Transaction(addr, is_write)));
+               }
+               return acc;
+           },
+           setup);
+}
+
+void BenchGetCommandToIssue(const BenchOptions& opts, const std::string& name,
+                            const Config& config, const Timing& timing,
+                            const OutputNames& outputs) {
+    // Every bank gets its row opened at cycle 0 and the queues are filled
+    // with accesses to other rows, so nothing can issue and each call walks
+    // every command in every queue, which is the steady state of a loaded
+    // controller waiting on timing constraints
+    std::vector<int> occupancies = {0, 1, config.cmd_queue_size / 2,
+                                    config.cmd_queue_size};
+    for (auto occupancy : occupancies) {
+        ChannelState channel_state(config, timing);
+        SimpleStats simple_stats(config, outputs, 0);
+        CommandQueue cmd_queue(0, config, channel_state, simple_stats);
+        for (int r = 0; r < config.ranks; r++) {
+            for (int bg = 0; bg < config.bankgroups; bg++) {
+                for (int b = 0; b < config.banks_per_group; b++) {
+                    Address addr(0, r, bg, b, 0, 0);
+                    channel_state.UpdateTimingAndStates(
+                        Command(CommandType::ACTIVATE, addr, 0), 0);
+                    for (int i = 0; i < occupancy; i++) {
+                        Address other(0, r, bg, b, i + 1, i);
+                        if (!cmd_queue.WillAcceptCommand(r, bg, b)) {
+                            break;
+                        }
+                        cmd_queue.AddCommand(
+                            Command(CommandType::READ, other, i + 1));
+                    }
+                }
+            }
+        }
+        Report(opts, "command_queue_get_command_to_issue", name,
+               fmt::format("occupancy={}", cmd_queue.QueueUsage()),
+               opts.ops / 10, [&](uint64_t ops) {
+                   uint64_t acc = 0;
+                   for (uint64_t i = 0; i < ops; i++) {
+                       acc += cmd_queue.GetCommandToIssue().IsValid();
+                   }
+                   return acc;
+               });
+    }
+}
+
+void BenchUpdateTiming(const BenchOptions& opts, const std::string& name,
+                       const Config& config, const Timing& timing) {
+    std::vector<std::pair<CommandType, std::string>> cmd_types = {
+        {CommandType::READ, "read"},
+        {CommandType::READ_PRECHARGE, "read_p"},
+        {CommandType::WRITE, "write"},
+        {CommandType::WRITE_PRECHARGE, "write_p"},
+        {CommandType::ACTIVATE, "activate"},
+        {CommandType::PRECHARGE, "precharge"},
+        {CommandType::REFRESH_BANK, "refresh_bank"},
+        {CommandType::REFRESH, "refresh"},
+        {CommandType::SREF_ENTER, "self_refresh_enter"},
+        {CommandType::SREF_EXIT, "self_refresh_exit"}};
+    for (const auto& cmd_type : cmd_types) {
+        ChannelState channel_state(config, timing);
+        Command cmd(cmd_type.first, Address(0, 0, 0, 0, 0, 0), 0);
+        uint64_t clk = 0;
+        Report(opts, "channel_state_update_timing", name, cmd_type.second,
+               opts.ops / 10, [&](uint64_t ops) {
+                   for (uint64_t i = 0; i < ops; i++) {
+                       channel_state.UpdateTiming(cmd, clk++);
+                   }
+                   return clk;
+               });
+    }
+}
+
+void BenchSimpleStats(const BenchOptions& opts, const std::string& name,
+                      const Config& config, const OutputNames& outputs) {
+    SimpleStats simple_stats(config, outputs, 0);
+    Report(opts, "simple_stats_increment", name, "counter", opts.ops,
+           [&](uint64_t ops) {
+               for (uint64_t i = 0; i < ops; i++) {
+                   simple_stats.Increment("num_read_cmds");
+               }
+               return ops;
+           });
+    Report(opts, "simple_stats_increment", name, "vec_counter", opts.ops,
+           [&](uint64_t ops) {
+               for (uint64_t i = 0; i < ops; i++) {
+                   simple_stats.IncrementVec("rank_active_cycles",
+                                             i % config.ranks);
+               }
+               return ops;
+           });
+    Report(opts, "simple_stats_increment", name, "histogram", opts.ops,
+           [&](uint64_t ops) {
+               for (uint64_t i = 0; i < ops; i++) {
+                   simple_stats.AddValue("read_latency", i & 255);
+               }
+               return ops;
+           });
+}
+
+// config_file with [system] backend overridden
+std::shared_ptr<const Config> WithBackend(const BenchOptions& opts,
+                                          const std::string& config_file,
+                                          const std::string& backend) {
+    INIReader ini(config_file);
+    return std::make_shared<const Config>(
+        ini, ConfigOverrides{{"system.backend", backend}}, opts.output_dir);
+}
+
+// Random traffic at full speed, same as RandomCPU, returns a hash of when
+// each request completed
+uint64_t RandomTraffic(std::shared_ptr<const Config> config, uint64_t cycles) {
+    uint64_t clk = 0;
+    uint64_t hash = 0;
+    auto callback = [&clk, &hash](uint64_t addr) {
+        hash = hash * 31 + (addr ^ clk);
+    };
+    MemorySystem memory_system(config, callback, callback);
+    std::mt19937_64 gen(3);
+    uint64_t addr = gen();
+    bool is_write = false;
+    for (clk = 0; clk < cycles; clk++) {
+        memory_system.ClockTick();
+        if (memory_system.WillAcceptTransaction(addr, is_write)) {
+            memory_system.AddTransaction(addr, is_write);
+            addr = gen();
+            is_write = (gen() % 3 == 0);
+        }
+    }
+    return hash;
+}
+
+void BenchEndToEnd(const BenchOptions& opts, const std::string& name,
+                   std::shared_ptr<const Config> config,
+                   const std::string& param) {
+    Report(opts, "end_to_end_cycles", name, param, opts.cycles,
+           [&](uint64_t cycles) { return RandomTraffic(config, cycles); });
+}
+
+// Independent memory systems ticked from their own threads. They all see the
+// same traffic so each has to finish exactly like a single threaded run,
+// anything else means instances share state.
+void BenchConcurrent(const BenchOptions& opts, const std::string& name,
+                     std::shared_ptr<const Config> config) {
+    if (!opts.filter.empty() &&
+        std::string("concurrent_instances").find(opts.filter) ==
+            std::string::npos) {
+        return;
+    }
+    uint64_t expected = RandomTraffic(config, opts.cycles);
+    Report(opts, "concurrent_instances", name,
+           fmt::format("threads={}", opts.threads), opts.cycles * opts.threads,
+           [&](uint64_t ops) {
+               std::vector<uint64_t> hashes(opts.threads, 0);
+               std::vector<std::thread> threads;
+               for (int i = 0; i < opts.threads; i++) {
+                   threads.emplace_back([&, i]() {
+                       hashes[i] = RandomTraffic(config, opts.cycles);
+                   });
+               }
+               for (auto& t : threads) {
+                   t.join();
+               }
+               for (int i = 0; i < opts.threads; i++) {
+                   if (hashes[i] != expected) {
+                       std::cerr << "Instance " << i << " of " << opts.threads
+                                 << " diverged from the single threaded run"
+                                 << std::endl;
+                       AbruptExit(__FILE__, __LINE__);
+                   }
+               }
+               return hashes[0];
+           });
+}
+
+// Cost of bringing up one more memory system, either parsing its config
+// file or sharing a Config that is already built
+void BenchConstruction(const BenchOptions& opts, const std::string& name,
+                       const std::string& config_file,
+                       std::shared_ptr<const Config> config) {
+    auto callback = [](uint64_t) {};
+    uint64_t instances = std::max(opts.ops / 10000, static_cast<uint64_t>(10));
+    Report(opts, "memory_system_construction", name, "config_file",
+           instances, [&](uint64_t ops) {
+               uint64_t acc = 0;
+               for (uint64_t i = 0; i < ops; i++) {
+                   MemorySystem memory_system(config_file, opts.output_dir,
+                                              callback, callback);
+                   acc += memory_system.GetChannels();
+               }
+               return acc;
+           });
+    Report(opts, "memory_system_construction", name, "shared_config",
+           instances, [&](uint64_t ops) {
+               uint64_t acc = 0;
+               for (uint64_t i = 0; i < ops; i++) {
+                   MemorySystem memory_system(config, callback, callback);
+                   acc += memory_system.GetChannels();
+               }
+               return acc;
+           });
+}
+
+void BenchFunctionalWarmup(const BenchOptions& opts, const std::string& name,
+                           const std::string& config_file) {
+    auto addrs = RandomAddresses(4096, 4);
+    uint64_t done = 0;
+    MemorySystem memory_system(config_file, opts.output_dir,
+                               [&done](uint64_t) { done++; },
+                               [&done](uint64_t) { done++; });
+    memory_system.SetFunctionalMode(true);
+    Report(opts, "functional_warmup_access", name, "random", opts.ops,
+           [&](uint64_t ops) {
+               for (uint64_t i = 0; i < ops; i++) {
+                   memory_system.AddTransaction(addrs[i & 4095], i % 3 == 0);
+               }
+               return done;
+           });
+}
+
+// Bursts of requests from the host, added one call each or as one batch.
+// Both clock the memory system once per burst, so queues keep draining.
+void BenchBatchAdd(const BenchOptions& opts, const std::string& name,
+                   const std::string& config_file) {
+    const size_t burst = 32;
+    std::vector<Request> requests;
+    for (auto addr : RandomAddresses(4096, 7)) {
+        requests.push_back({addr, addr % 3 == 0, addr, 0});
+    }
+    std::vector<AddResult> results(burst);
+    std::unique_ptr<MemorySystem> memory_system;
+    auto setup = [&](uint64_t) {
+        // release the output prefix before the next one claims it
+        memory_system.reset();
+        memory_system.reset(new MemorySystem(config_file, opts.output_dir,
+                                             [](uint64_t) {},
+                                             [](uint64_t) {}));
+    };
+    Report(opts, "memory_system_add_burst", name, "single", opts.ops / 10,
+           [&](uint64_t ops) {
+               uint64_t acc = 0;
+               for (uint64_t i = 0; i < ops; i += burst) {
+                   for (size_t j = 0; j < burst; j++) {
+                       const auto& req = requests[(i + j) & 4095];
+                       acc += IsAccepted(memory_system->TryAddTransaction(
+                           req.addr, req.is_write, req.req_id));
+                   }
+                   memory_system->ClockTick();
+               }
+               return acc;
+           },
+           setup);
+    Report(opts, "memory_system_add_burst", name,
+           fmt::format("batch={}", burst), opts.ops / 10,
+           [&](uint64_t ops) {
+               uint64_t acc = 0;
+               for (uint64_t i = 0; i < ops; i += burst) {
+                   acc += memory_system->AddTransactions(
+                       &requests[i & 4095], burst, results.data());
+                   memory_system->ClockTick();
+               }
+               return acc;
+           },
+           setup);
+}
+
+}  // namespace
+
+int main(int argc, const char **argv) {
+    args::ArgumentParser parser(
+        "DRAMSim3 simulator throughput microbenchmarks.",
+        "Prints one JSON object per result line.\n"
+        "Examples: \n"
+        "./build/dramsim3bench -d configs/\n"
+        "./build/dramsim3bench -d configs/ -f end_to_end -c 1000000");
+    args::HelpFlag help(parser, "help", "Display the help menu", {'h', "help"});
+    args::ValueFlag<std::string> config_dir_arg(
+        parser, "config_dir", "Directory holding the DDR4/HBM2/HMC configs",
+        {'d', "config-dir"}, "configs");
+    args::ValueFlag<std::string> output_dir_arg(
+        parser, "output_dir", "Output directory for stats files",
+        {'o', "output-dir"}, ".");
+    args::ValueFlag<std::string> filter_arg(
+        parser, "filter", "Only run benchmarks whose name contains this",
+        {'f', "filter"}, "");
+    args::ValueFlag<int> repeats_arg(parser, "repeats",
+                                     "Repetitions of each benchmark",
+                                     {'r', "repeats"}, 5);
+    args::ValueFlag<uint64_t> ops_arg(parser, "ops",
+                                      "Operations per microbenchmark",
+                                      {'n', "ops"}, 1000000);
+    args::ValueFlag<uint64_t> cycles_arg(
+        parser, "cycles", "Cycles per end-to-end run", {'c', "cycles"},
+        200000);
+    args::ValueFlag<int> threads_arg(
+        parser, "threads", "Instances run side by side in the concurrent case",
+        {'j', "threads"},
+        static_cast<int>(std::thread::hardware_concurrency()));
+
+    try {
+        parser.ParseCLI(argc, argv);
+    } catch (args::Help const&) {
+        std::cout << parser;
+        return 0;
+    } catch (args::ParseError const&) {
+        std::cerr << "ParserError" << std::endl;
+        std::cerr << parser;
+        return 1;
+    }
+
+    BenchOptions opts;
+    opts.config_dir = args::get(config_dir_arg);
+    opts.output_dir = args::get(output_dir_arg);
+    opts.filter = args::get(filter_arg);
+    opts.repeats = std::max(args::get(repeats_arg), 1);
+    opts.ops = std::max(args::get(ops_arg), static_cast<uint64_t>(100));
+    opts.cycles = args::get(cycles_arg);
+    opts.threads = std::max(args::get(threads_arg), 2);
+
+    std::vector<std::pair<std::string, std::string>> configs = {
+        {"DDR4", "DDR4_8Gb_x8_3200.ini"},
+        {"HBM2", "HBM2_4Gb_x128.ini"},
+        {"HMC", "HMC_4GB_4Lx16.ini"}};
+
+    for (const auto& name_file : configs) {
+        std::string config_file = opts.config_dir + "/" + name_file.second;
+        auto shared_config =
+            std::make_shared<const Config>(config_file, opts.output_dir);
+        const Config& config = *shared_config;
+        const Timing& timing = config.GetTiming();
+        const auto& name = name_file.first;
+        {
+            // released before the memory systems below claim the prefix
+            OutputNames outputs(config);
+            BenchAddressMapping(opts, name, config);
+            BenchAddressBits(opts, name, config_file);
+            BenchRadixMapping(opts, name, config_file);
+            BenchAddTransaction(opts, name, config, timing, outputs);
+            BenchGetCommandToIssue(opts, name, config, timing, outputs);
+            BenchUpdateTiming(opts, name, config, timing);
+            BenchSimpleStats(opts, name, config, outputs);
+        }
+        BenchEndToEnd(opts, name, shared_config, "random");
+        if (!config.IsHMC()) {
+            BenchEndToEnd(opts, name,
+                          WithBackend(opts, config_file, "ANALYTICAL"),
+                          "random_analytical");
+        }
+        BenchFunctionalWarmup(opts, name, config_file);
+        BenchBatchAdd(opts, name, config_file);
+        BenchConstruction(opts, name, config_file, shared_config);
+        BenchConcurrent(opts, name, shared_config);
+    }
+    return 0;
+}
@@ -158,6 +158,15 @@ void ChannelState::UpdateState(const Command& cmd, uint64_t clk) {
     return;
 }
 
+bool ChannelState::FunctionalAccess(const Address& addr, bool close_page) {
+    if (rank_is_sref_[addr.rank]) {
+        UpdateState(Command(CommandType::SREF_EXIT, addr, 0), 0);
+    }
+    rank_idle_cycles[addr.rank] = 0;
+    return bank_states_[addr.rank][addr.bankgroup][addr.bank].FunctionalAccess(
+        addr.row, close_page);
+}
+
 // cmd是当前cycle开始处理的command，clk是当前cycle
 void ChannelState::UpdateTiming(const Command& cmd, uint64_t clk) {
     switch (cmd.cmd_type) {
@@ -338,4 +347,34 @@ bool ChannelState::Is32AWReady(int rank, uint64_t curr_time) const {
     return true;
 }
 
+void ChannelState::SaveState(CheckpointWriter& ckpt) const {
+    Save(ckpt, rank_idle_cycles);
+    Save(ckpt, rank_is_sref_);
+    for (const auto& rank_states : bank_states_) {
+        for (const auto& bg_states : rank_states) {
+            for (const auto& bank_state : bg_states) {
+                bank_state.SaveState(ckpt);
+            }
+        }
+    }
+    Save(ckpt, refresh_q_);
+    Save(ckpt, four_aw_);
+    Save(ckpt, thirty_two_aw_);
+}
+
+void ChannelState::LoadState(CheckpointReader& ckpt) {
+    Load(ckpt, rank_idle_cycles);
+    Load(ckpt, rank_is_sref_);
+    for (auto& rank_states : bank_states_) {
+        for (auto& bg_states : rank_states) {
+            for (auto& bank_state : bg_states) {
+                bank_state.LoadState(ckpt);
+            }
+        }
+    }
+    Load(ckpt, refresh_q_);
+    Load(ckpt, four_aw_);
+    Load(ckpt, thirty_two_aw_);
+}
+
 }  // namespace dramsim3
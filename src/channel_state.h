@@ -16,6 +16,8 @@ class ChannelState {
     void UpdateState(const Command& cmd, uint64_t clk);
     void UpdateTiming(const Command& cmd, uint64_t clk);
     void UpdateTimingAndStates(const Command& cmd, uint64_t clk);
+    // row buffer update without timing, wakes the rank up if it's in SREF
+    bool FunctionalAccess(const Address& addr, bool close_page);
     bool ActivationWindowOk(int rank, uint64_t curr_time) const;
     void UpdateActivationTimes(int rank, uint64_t curr_time);
     bool IsRowOpen(int rank, int bankgroup, int bank) const {
@@ -55,6 +57,9 @@ class ChannelState {
         return bank_states_[rank][bankgroup][bank].RowHitCount();
     };
 
+    void SaveState(CheckpointWriter& ckpt) const;
+    void LoadState(CheckpointReader& ckpt);
+
     std::vector<int> rank_idle_cycles;
 
    private:
@@ -0,0 +1,59 @@
+#include "checkpoint.h"
+#include "configuration.h"
+
+namespace dramsim3 {
+
+namespace {
+// FNV-1a, good enough to tell configs apart
+void HashBytes(uint64_t& hash, const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+}
+
+void HashInt(uint64_t& hash, int64_t val) { HashBytes(hash, &val, sizeof(val)); }
+
+void HashString(uint64_t& hash, const std::string& str) {
+    HashInt(hash, str.size());
+    HashBytes(hash, str.data(), str.size());
+}
+}  // namespace
+
+uint64_t ConfigFingerprint(const Config& config) {
+    uint64_t hash = 14695981039346656037ULL;
+    HashInt(hash, static_cast<int64_t>(config.protocol));
+    HashString(hash, config.memory_backend);
+    HashInt(hash, config.channels);
+    HashInt(hash, config.ranks);
+    HashInt(hash, config.bankgroups);
+    HashInt(hash, config.banks_per_group);
+    HashInt(hash, config.rows);
+    HashInt(hash, config.columns);
+    HashInt(hash, config.bus_width);
+    HashInt(hash, config.BL);
+    HashString(hash, config.address_mapping);
+    if (!config.address_bits.empty()) {
+        HashString(hash, config.address_bits);
+    }
+    for (const auto masks :
+         {&config.ch_hash, &config.ra_hash, &config.bg_hash, &config.ba_hash}) {
+        for (auto mask : *masks) {
+            HashInt(hash, static_cast<int64_t>(mask));
+        }
+    }
+    HashString(hash, config.queue_structure);
+    HashInt(hash, config.unified_queue);
+    HashInt(hash, config.trans_queue_size);
+    HashInt(hash, config.cmd_queue_size);
+    HashInt(hash, static_cast<int64_t>(config.refresh_policy));
+    if (config.IsHMC()) {
+        HashInt(hash, config.num_links);
+        HashInt(hash, config.xbar_queue_depth);
+        HashInt(hash, config.block_size);
+    }
+    return hash;
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,268 @@
+#ifndef __CHECKPOINT_H
+#define __CHECKPOINT_H
+
+#include <stdint.h>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "common.h"
+
+namespace dramsim3 {
+
+class Config;
+
+// Bump this whenever the layout of any saved state changes
+const uint32_t kCheckpointVersion = 8;
+
+// Hash of the parts of a Config that determine the shape and meaning of the
+// saved state, i.e. organization, address mapping and queueing. Timing,
+// power and scheduling policies are left out on purpose so that one warmed up
+// state can be resumed under several variants of those.
+uint64_t ConfigFingerprint(const Config& config);
+
+class CheckpointWriter {
+   public:
+    explicit CheckpointWriter(const std::string& path)
+        : out_(path, std::ofstream::binary) {}
+    bool IsOpen() const { return out_.is_open(); }
+    void WriteBytes(const void* data, size_t size) {
+        out_.write(static_cast<const char*>(data), size);
+    }
+    // flushes, false if anything so far failed to reach the file
+    bool Finish() {
+        out_.flush();
+        return out_.good();
+    }
+
+   private:
+    std::ofstream out_;
+};
+
+class CheckpointReader {
+   public:
+    explicit CheckpointReader(const std::string& path)
+        : in_(path, std::ifstream::binary) {}
+    bool IsOpen() const { return in_.is_open(); }
+    void ReadBytes(void* data, size_t size) {
+        in_.read(static_cast<char*>(data), size);
+        if (!in_) {
+            std::cerr << "Checkpoint file is truncated or corrupted"
+                      << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+    }
+
+   private:
+    std::ifstream in_;
+};
+
+// Save/Load overloads for everything the simulator keeps as state, data is
+// written raw in host byte order since checkpoints are not meant to be moved
+// across machines
+template <typename T>
+typename std::enable_if<std::is_arithmetic<T>::value ||
+                        std::is_enum<T>::value>::type
+Save(CheckpointWriter& ckpt, const T& val) {
+    ckpt.WriteBytes(&val, sizeof(T));
+}
+
+template <typename T>
+typename std::enable_if<std::is_arithmetic<T>::value ||
+                        std::is_enum<T>::value>::type
+Load(CheckpointReader& ckpt, T& val) {
+    ckpt.ReadBytes(&val, sizeof(T));
+}
+
+inline void Save(CheckpointWriter& ckpt, const std::string& str) {
+    Save(ckpt, static_cast<uint64_t>(str.size()));
+    ckpt.WriteBytes(str.data(), str.size());
+}
+
+inline void Load(CheckpointReader& ckpt, std::string& str) {
+    uint64_t size;
+    Load(ckpt, size);
+    str.resize(size);
+    if (size > 0) {
+        ckpt.ReadBytes(&str[0], size);
+    }
+}
+
+inline void Save(CheckpointWriter& ckpt, const Address& addr) {
+    Save(ckpt, addr.channel);
+    Save(ckpt, addr.rank);
+    Save(ckpt, addr.bankgroup);
+    Save(ckpt, addr.bank);
+    Save(ckpt, addr.row);
+    Save(ckpt, addr.column);
+}
+
+inline void Load(CheckpointReader& ckpt, Address& addr) {
+    Load(ckpt, addr.channel);
+    Load(ckpt, addr.rank);
+    Load(ckpt, addr.bankgroup);
+    Load(ckpt, addr.bank);
+    Load(ckpt, addr.row);
+    Load(ckpt, addr.column);
+}
+
+inline void Save(CheckpointWriter& ckpt, const Command& cmd) {
+    Save(ckpt, cmd.cmd_type);
+    Save(ckpt, cmd.addr);
+    Save(ckpt, cmd.hex_addr);
+}
+
+inline void Load(CheckpointReader& ckpt, Command& cmd) {
+    Load(ckpt, cmd.cmd_type);
+    Load(ckpt, cmd.addr);
+    Load(ckpt, cmd.hex_addr);
+}
+
+inline void Save(CheckpointWriter& ckpt, const Transaction& trans) {
+    Save(ckpt, trans.addr);
+    Save(ckpt, trans.added_cycle);
+    Save(ckpt, trans.complete_cycle);
+    Save(ckpt, trans.is_write);
+    Save(ckpt, trans.req_id);
+    Save(ckpt, trans.served_by);
+    Save(ckpt, trans.bursts);
+    Save(ckpt, trans.group);
+    Save(ckpt, trans.split);
+}
+
+inline void Load(CheckpointReader& ckpt, Transaction& trans) {
+    Load(ckpt, trans.addr);
+    Load(ckpt, trans.added_cycle);
+    Load(ckpt, trans.complete_cycle);
+    Load(ckpt, trans.is_write);
+    Load(ckpt, trans.req_id);
+    Load(ckpt, trans.served_by);
+    Load(ckpt, trans.bursts);
+    Load(ckpt, trans.group);
+    Load(ckpt, trans.split);
+}
+
+template <typename K, typename V>
+void Save(CheckpointWriter& ckpt, const std::pair<K, V>& pair) {
+    Save(ckpt, pair.first);
+    Save(ckpt, pair.second);
+}
+
+template <typename K, typename V>
+void Load(CheckpointReader& ckpt, std::pair<K, V>& pair) {
+    Load(ckpt, pair.first);
+    Load(ckpt, pair.second);
+}
+
+template <typename T>
+void Save(CheckpointWriter& ckpt, const std::vector<T>& vec) {
+    Save(ckpt, static_cast<uint64_t>(vec.size()));
+    for (size_t i = 0; i < vec.size(); i++) {
+        Save(ckpt, vec[i]);
+    }
+}
+
+// capacity is left alone, the controller relies on reserve()d capacity to
+// bound its queues
+template <typename T>
+void Load(CheckpointReader& ckpt, std::vector<T>& vec) {
+    uint64_t size;
+    Load(ckpt, size);
+    vec.clear();
+    for (uint64_t i = 0; i < size; i++) {
+        T val;
+        Load(ckpt, val);
+        vec.push_back(val);
+    }
+}
+
+template <typename T>
+void Save(CheckpointWriter& ckpt, const std::deque<T>& deq) {
+    Save(ckpt, static_cast<uint64_t>(deq.size()));
+    for (const auto& val : deq) {
+        Save(ckpt, val);
+    }
+}
+
+template <typename T>
+void Load(CheckpointReader& ckpt, std::deque<T>& deq) {
+    uint64_t size;
+    Load(ckpt, size);
+    deq.clear();
+    for (uint64_t i = 0; i < size; i++) {
+        T val;
+        Load(ckpt, val);
+        deq.push_back(val);
+    }
+}
+
+// all the associative containers go through here, entries are restored in
+// the order they were saved so multimaps keep the order of equal keys
+template <typename C>
+void SaveContainer(CheckpointWriter& ckpt, const C& container) {
+    Save(ckpt, static_cast<uint64_t>(container.size()));
+    for (const auto& entry : container) {
+        Save(ckpt, entry);
+    }
+}
+
+template <typename C, typename E>
+void LoadContainer(CheckpointReader& ckpt, C& container) {
+    uint64_t size;
+    Load(ckpt, size);
+    container.clear();
+    for (uint64_t i = 0; i < size; i++) {
+        E entry;
+        Load(ckpt, entry);
+        container.insert(container.end(), entry);
+    }
+}
+
+template <typename K, typename V>
+void Save(CheckpointWriter& ckpt, const std::map<K, V>& map) {
+    SaveContainer(ckpt, map);
+}
+
+template <typename K, typename V>
+void Load(CheckpointReader& ckpt, std::map<K, V>& map) {
+    LoadContainer<std::map<K, V>, std::pair<K, V>>(ckpt, map);
+}
+
+template <typename K, typename V>
+void Save(CheckpointWriter& ckpt, const std::multimap<K, V>& map) {
+    SaveContainer(ckpt, map);
+}
+
+template <typename K, typename V>
+void Load(CheckpointReader& ckpt, std::multimap<K, V>& map) {
+    LoadContainer<std::multimap<K, V>, std::pair<K, V>>(ckpt, map);
+}
+
+template <typename K, typename V>
+void Save(CheckpointWriter& ckpt, const std::unordered_map<K, V>& map) {
+    SaveContainer(ckpt, map);
+}
+
+template <typename K, typename V>
+void Load(CheckpointReader& ckpt, std::unordered_map<K, V>& map) {
+    LoadContainer<std::unordered_map<K, V>, std::pair<K, V>>(ckpt, map);
+}
+
+template <typename T>
+void Save(CheckpointWriter& ckpt, const std::unordered_set<T>& set) {
+    SaveContainer(ckpt, set);
+}
+
+template <typename T>
+void Load(CheckpointReader& ckpt, std::unordered_set<T>& set) {
+    LoadContainer<std::unordered_set<T>, T>(ckpt, set);
+}
+
+}  // namespace dramsim3
+#endif
@@ -250,4 +250,26 @@ bool CommandQueue::HasRWDependency(const CMDIterator& cmd_it,
     return false;
 }
 
+void CommandQueue::SaveState(CheckpointWriter& ckpt) const {
+    Save(ckpt, rank_q_empty);
+    for (const auto& queue : queues_) {
+        Save(ckpt, queue);
+    }
+    Save(ckpt, ref_q_indices_);
+    Save(ckpt, is_in_ref_);
+    Save(ckpt, queue_idx_);
+    Save(ckpt, clk_);
+}
+
+void CommandQueue::LoadState(CheckpointReader& ckpt) {
+    Load(ckpt, rank_q_empty);
+    for (auto& queue : queues_) {
+        Load(ckpt, queue);
+    }
+    Load(ckpt, ref_q_indices_);
+    Load(ckpt, is_in_ref_);
+    Load(ckpt, queue_idx_);
+    Load(ckpt, clk_);
+}
+
 }  // namespace dramsim3
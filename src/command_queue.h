@@ -25,6 +25,8 @@ class CommandQueue {
     bool AddCommand(Command cmd);
     bool QueueEmpty() const;
     int QueueUsage() const;
+    void SaveState(CheckpointWriter& ckpt) const;
+    void LoadState(CheckpointReader& ckpt);
     std::vector<bool> rank_q_empty;
 
    private:
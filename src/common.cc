@@ -92,4 +92,12 @@ bool DirExist(std::string dir) {
     }
 }
 
+bool MakeDir(const std::string& dir) {
+    if (DirExist(dir)) {
+        return true;
+    }
+    mkdir(dir.c_str(), 0755);
+    return DirExist(dir);
+}
+
 }  // namespace dramsim3
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <iostream>
 #include <vector>
+#include "request_types.h"
 
 namespace dramsim3 {
 
@@ -40,6 +41,34 @@ inline uint32_t ModuloWidth(uint64_t addr, uint32_t bit_width, uint32_t pos) {
     return static_cast<uint32_t>(store ^ addr);
 }
 
+// Division and modulo by a divisor known at runtime as multiplications,
+// exact for every 64 bit dividend (Lemire, Kaser, Kurz, "Faster remainder
+// by direct computation", 2019). The divisor has to be at least 2.
+class FastDivider {
+   public:
+    FastDivider() : divisor_(2), magic_(0) {}
+    explicit FastDivider(uint64_t divisor)
+        : divisor_(divisor),
+          magic_(~static_cast<unsigned __int128>(0) / divisor + 1) {}
+    uint64_t Divisor() const { return divisor_; }
+    uint64_t Divide(uint64_t n) const { return MulHigh(magic_, n); }
+    uint64_t Modulo(uint64_t n) const {
+        return MulHigh(magic_ * n, divisor_);
+    }
+
+   private:
+    // upper 64 bits of the 192 bit product
+    static uint64_t MulHigh(unsigned __int128 a, uint64_t b) {
+        unsigned __int128 low = static_cast<uint64_t>(a) *
+                                static_cast<unsigned __int128>(b);
+        unsigned __int128 high = static_cast<uint64_t>(a >> 64) *
+                                 static_cast<unsigned __int128>(b);
+        return static_cast<uint64_t>((high + (low >> 64)) >> 64);
+    }
+    uint64_t divisor_;
+    unsigned __int128 magic_;
+};
+
 // extern std::function<Address(uint64_t)> AddressMapping;
 int GetBitInPos(uint64_t bits, int pos);
 // it's 2017 and c++ std::string still lacks a split function, oh well
@@ -50,6 +79,8 @@ void StringSplit(const std::string& s, char delim, Out result);
 int LogBase2(int power_of_two);
 void AbruptExit(const std::string& file, int line);
 bool DirExist(std::string dir);
+// creates dir unless it is there already, false if it still doesn't exist
+bool MakeDir(const std::string& dir);
 
 enum class CommandType {
     READ,
@@ -106,21 +137,46 @@ struct Command {
 };
 
 struct Transaction {
-    Transaction() {}
+    Transaction() : bursts(1), group(0), split(0) {}
     Transaction(uint64_t addr, bool is_write)
+        : Transaction(addr, is_write, addr) {}
+    Transaction(uint64_t addr, bool is_write, uint64_t req_id)
+        : Transaction(addr, is_write, req_id, 1) {}
+    Transaction(uint64_t addr, bool is_write, uint64_t req_id, int bursts)
         : addr(addr),
           added_cycle(0),
           complete_cycle(0),
-          is_write(is_write) {}
+          is_write(is_write),
+          req_id(req_id),
+          served_by(ServedBy::ROW_MISS),
+          bursts(bursts),
+          group(0),
+          split(0) {}
     Transaction(const Transaction& tran)
         : addr(tran.addr),
           added_cycle(tran.added_cycle),
           complete_cycle(tran.complete_cycle),
-          is_write(tran.is_write) {}
+          is_write(tran.is_write),
+          req_id(tran.req_id),
+          served_by(tran.served_by),
+          bursts(tran.bursts),
+          group(tran.group),
+          split(tran.split) {}
     uint64_t addr;
     uint64_t added_cycle;
     uint64_t complete_cycle;
     bool is_write;
+    uint64_t req_id;
+    ServedBy served_by;
+    // request_size_bytes bursts at addr and the following addresses
+    int bursts;
+    // the controller splits multi burst reads into one transaction per
+    // burst, all with the same group id, 0 for everything else
+    uint64_t group;
+    // a request whose bursts map to more than one channel goes in as one
+    // part per channel run, all with the same split id, 0 for everything
+    // else
+    uint64_t split;
 
     friend std::ostream& operator<<(std::ostream& os, const Transaction& trans);
     friend std::istream& operator>>(std::istream& is, Transaction& trans);
@@ -1,6 +1,12 @@
 #include "configuration.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <mutex>
+#include <set>
 #include <vector>
+#include "timing.h"
 
 #ifdef THERMAL
 #include <math.h>
@@ -8,14 +14,125 @@
 
 namespace dramsim3 {
 
+namespace {
+// output prefixes of the live memory systems, shared by every instance in the
+// process so it is the one piece of state behind a lock
+std::mutex prefix_mutex;
+std::set<std::string> claimed_prefixes;
+}  // namespace
+
+namespace {
+std::string LowerCase(std::string str) {
+    std::transform(str.begin(), str.end(), str.begin(), ::tolower);
+    return str;
+}
+}  // namespace
+
+ConfigReader::ConfigReader(const INIReader* ini,
+                           const ConfigOverrides& overrides)
+    : ini_(ini) {
+    for (const auto& key_value : overrides) {
+        overrides_[LowerCase(key_value.first)] = key_value.second;
+    }
+}
+
+bool ConfigReader::Lookup(const std::string& section, const std::string& name,
+                          std::string& value) const {
+    auto it = overrides_.find(LowerCase(section + "." + name));
+    if (it != overrides_.end()) {
+        value = it->second;
+    } else if (ini_ != nullptr) {
+        // INIReader can't tell a missing key from an empty one either
+        value = ini_->Get(section, name, "");
+        if (value.empty()) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    if (!value.empty() && value[0] == '{') {
+        std::cerr << section << "." << name << " = " << value
+                  << " is a sweep, run it with --sweep" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    return true;
+}
+
+std::string ConfigReader::Get(const std::string& section,
+                              const std::string& name,
+                              const std::string& default_value) const {
+    std::string value;
+    return Lookup(section, name, value) ? value : default_value;
+}
+
+long ConfigReader::GetInteger(const std::string& section,
+                              const std::string& name,
+                              long default_value) const {
+    std::string value;
+    if (!Lookup(section, name, value)) {
+        return default_value;
+    }
+    // same as INIReader, decimal, 0x hex or 0 octal
+    const char* start = value.c_str();
+    char* end;
+    long n = std::strtol(start, &end, 0);
+    return end > start ? n : default_value;
+}
+
+double ConfigReader::GetReal(const std::string& section,
+                             const std::string& name,
+                             double default_value) const {
+    std::string value;
+    if (!Lookup(section, name, value)) {
+        return default_value;
+    }
+    const char* start = value.c_str();
+    char* end;
+    double n = std::strtod(start, &end);
+    return end > start ? n : default_value;
+}
+
+bool ConfigReader::GetBoolean(const std::string& section,
+                              const std::string& name,
+                              bool default_value) const {
+    std::string value;
+    if (!Lookup(section, name, value)) {
+        return default_value;
+    }
+    value = LowerCase(value);
+    if (value == "true" || value == "yes" || value == "on" || value == "1") {
+        return true;
+    } else if (value == "false" || value == "no" || value == "off" ||
+               value == "0") {
+        return false;
+    }
+    return default_value;
+}
+
 //读取configs/DDR*，并设置相应的内容
 Config::Config(std::string config_file, std::string out_dir)
-    : output_dir(out_dir), reader_(new INIReader(config_file)) {
-    if (reader_->ParseError() < 0) {
+    : output_dir(out_dir), reader_(nullptr) {
+    INIReader ini(config_file);
+    if (ini.ParseError() < 0) {
         std::cerr << "Can't load config file - " << config_file << std::endl;
         AbruptExit(__FILE__, __LINE__);
     }
+    Init(ConfigReader(&ini, ConfigOverrides()));
+}
+
+Config::Config(const INIReader& ini, const ConfigOverrides& overrides,
+               std::string out_dir)
+    : output_dir(out_dir), reader_(nullptr) {
+    Init(ConfigReader(&ini, overrides));
+}
+
+Config::Config(const ConfigOverrides& values, std::string out_dir)
+    : output_dir(out_dir), reader_(nullptr) {
+    Init(ConfigReader(nullptr, values));
+}
 
+void Config::Init(const ConfigReader& reader) {
+    reader_ = &reader;
     // The initialization of the parameters has to be strictly in this order
     // because of internal dependencies
     InitSystemParams();
@@ -28,13 +145,57 @@ Config::Config(std::string config_file, std::string out_dir)
 #ifdef THERMAL
     InitThermalParams();
 #endif  // THERMAL
-    delete (reader_);
+    reader_ = nullptr;
+    timing_.reset(new Timing(*this));
+}
+
+Config::~Config() {}
+
+OutputNames::OutputNames(const Config& config) : OutputNames(config, "") {}
+
+OutputNames::OutputNames(const Config& config, const std::string& suffix) {
+    // give a prefix instead of specify the output name one by one...
+    // this would allow outputing to a directory and you can always override
+    // these values
+    std::string output_dir = config.output_dir;
+    if (!DirExist(output_dir)) {
+        std::cout << "WARNING: Output directory " << output_dir
+                  << " not exists! Using current directory for output!"
+                  << std::endl;
+        output_dir = "./";
+    } else {
+        output_dir = output_dir + "/";
+    }
+    std::string wanted = output_dir + config.output_name + suffix;
+    std::lock_guard<std::mutex> lock(prefix_mutex);
+    output_prefix = wanted;
+    for (int i = 1; claimed_prefixes.count(output_prefix) > 0; i++) {
+        output_prefix = wanted + "_" + std::to_string(i);
+    }
+    if (output_prefix != wanted) {
+        std::cerr << "WARNING: Output prefix " << wanted
+                  << " is used by another memory system, using "
+                  << output_prefix << " instead" << std::endl;
+    }
+    claimed_prefixes.insert(output_prefix);
+    json_stats_name = output_prefix + ".json";
+    json_epoch_name = output_prefix + "epoch.json";
+    txt_stats_name = output_prefix + ".txt";
+}
+
+OutputNames::~OutputNames() {
+    std::lock_guard<std::mutex> lock(prefix_mutex);
+    claimed_prefixes.erase(output_prefix);
 }
 
 //根据channel，rank，bankgroup，bank，row和column的位置与mask，将一个十六位地址解析为Address(channel, rank, bankgroup, bank, row, column)
 //pos和mask都是根据configs里的文件读取之后计算出来的
 Address Config::AddressMapping(uint64_t hex_addr) const {
     hex_addr >>= shift_bits;
+    if (!radix_fields_.empty()) {
+        return RadixMapping(hex_addr);
+    }
+    hex_addr = GatherFields(HashAddress(hex_addr));
     int channel = (hex_addr >> ch_pos) & ch_mask;
     int rank = (hex_addr >> ra_pos) & ra_mask;
     int bg = (hex_addr >> bg_pos) & bg_mask;
@@ -53,7 +214,8 @@ void Config::CalculateSize() {
     int page_size = columns * device_width / 8;  // page size in bytes
     // std::cout << "page size: " << page_size << std::endl;
     // 每个bank都是 row * column * device_width（bytes）
-    int megs_per_bank = page_size * (rows / 1024) / 1024;
+    int megs_per_bank =
+        static_cast<int>(static_cast<int64_t>(page_size) * rows / 1024 / 1024);
     // std::cout << "megs per bank: " << megs_per_bank << std::endl;
     // banks是bank_per_group * bankgroups，即这一个rank一共有多少个bank
     int megs_per_rank = megs_per_bank * banks * devices_per_rank;
@@ -173,22 +335,9 @@ void Config::InitOtherParams() {
     // 2: adds histogram outputs in a different CSV format
     output_level = reader.GetInteger("other", "output_level", 1);
     // Other Parameters
-    // give a prefix instead of specify the output name one by one...
-    // this would allow outputing to a directory and you can always override
-    // these values
-    if (!DirExist(output_dir)) {
-        std::cout << "WARNING: Output directory " << output_dir
-                  << " not exists! Using current directory for output!"
-                  << std::endl;
-        output_dir = "./";
-    } else {
-        output_dir = output_dir + "/";
-    }
-    output_prefix =
-        output_dir + reader.Get("other", "output_prefix", "dramsim3");
-    json_stats_name = output_prefix + ".json";
-    json_epoch_name = output_prefix + "epoch.json";
-    txt_stats_name = output_prefix + ".txt";
+    // the directory is only looked at once a memory system writes to it,
+    // see OutputNames
+    output_name = reader.Get("other", "output_prefix", "dramsim3");
     return;
 }
 
@@ -231,7 +380,17 @@ void Config::InitSystemParams() {
     channel_size = GetInteger("system", "channel_size", 1024);
     channels = GetInteger("system", "channels", 1);
     bus_width = GetInteger("system", "bus_width", 64);
+    memory_backend = reader.Get("system", "backend", "JEDEC");
+    if (memory_backend != "JEDEC" && memory_backend != "IDEAL" &&
+        memory_backend != "ANALYTICAL") {
+        std::cerr << "Unknown backend " << memory_backend
+                  << ", use one of JEDEC IDEAL ANALYTICAL" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    analytical_calibration =
+        GetInteger("system", "analytical_calibration", 2000);
     address_mapping = reader.Get("system", "address_mapping", "chrobabgraco");
+    address_bits = reader.Get("system", "address_bits", "");
     queue_structure = reader.Get("system", "queue_structure", "PER_BANK");
     row_buf_policy = reader.Get("system", "row_buf_policy", "OPEN_PAGE");
     cmd_queue_size = GetInteger("system", "cmd_queue_size", 16);
@@ -347,6 +506,9 @@ void Config::InitTimingParams() {
     tRCDWR = GetInteger("timing", "tRCDWR", 20);
 
     ideal_memory_latency = GetInteger("timing", "ideal_memory_latency", 10);
+    ideal_bandwidth_limit =
+        reader.GetBoolean("timing", "ideal_bandwidth_limit", false);
+    ideal_queue_size = GetInteger("timing", "ideal_queue_size", 0);
 
     // calculated timing
     RL = AL + CL;
@@ -361,21 +523,33 @@ void Config::SetAddressMapping() {
     // multiple bytes because of bus width, and burst length
     request_size_bytes = bus_width / 8 * BL;
     shift_bits = LogBase2(request_size_bytes);
-    int col_low_bits = LogBase2(BL);
-    int actual_col_bits = LogBase2(columns) - col_low_bits;
 
     // has to strictly follow the order of chan, rank, bg, bank, row, col
+    std::map<std::string, int> field_counts;
+    field_counts["ch"] = channels;
+    field_counts["ra"] = ranks;
+    field_counts["bg"] = bankgroups;
+    field_counts["ba"] = banks_per_group;
+    field_counts["ro"] = rows;
+    field_counts["co"] = columns / BL;
+    // bits to hold each field, rounded up for non power of two counts
     std::map<std::string, int> field_widths;
-    field_widths["ch"] = LogBase2(channels);
-    field_widths["ra"] = LogBase2(ranks);
-    field_widths["bg"] = LogBase2(bankgroups);
-    field_widths["ba"] = LogBase2(banks_per_group);
-    field_widths["ro"] = LogBase2(rows);
-    field_widths["co"] = actual_col_bits;
+    bool all_power_of_two = true;
+    for (const auto& field : field_counts) {
+        int width = 0;
+        while ((1 << width) < field.second) {
+            width++;
+        }
+        field_widths[field.first] = width;
+        all_power_of_two = all_power_of_two && (1 << width) == field.second;
+    }
     //std::cout << "channel: " << LogBase2(channels) << ", rank: " << LogBase2(ranks) << ", bankgroup: " << LogBase2(bankgroups) << ", bankspergroup: " << LogBase2(banks_per_group) << ", rows: "
     //<< LogBase2(rows) << ", columns: " << actual_col_bits << std::endl;
 
-    if (address_mapping.size() != 12) {
+    // address_bits layouts are gathered into this one
+    std::string layout =
+        address_bits.empty() ? address_mapping : "rochrababgco";
+    if (layout.size() != 12) {
         std::cerr << "Unknown address mapping (6 fields each 2 chars required)"
                   << std::endl;
         AbruptExit(__FILE__, __LINE__);
@@ -386,12 +560,13 @@ void Config::SetAddressMapping() {
     // // each field must be 2 chars
     std::vector<std::string> fields;
 
-    for (size_t i = 0; i < address_mapping.size(); i += 2) {
-        std::string token = address_mapping.substr(i, 2);
+    for (size_t i = 0; i < layout.size(); i += 2) {
+        std::string token = layout.substr(i, 2);
         fields.push_back(token);
     }
 
     std::map<std::string, int> field_pos;
+    std::vector<std::string> lsb_first;
     int pos = 0;
     while (!fields.empty()) {
         auto token = fields.back();
@@ -402,6 +577,7 @@ void Config::SetAddressMapping() {
         }
         field_pos[token] = pos;
         pos += field_widths[token];
+        lsb_first.push_back(token);
     }
 
     ch_pos = field_pos.at("ch");
@@ -419,6 +595,249 @@ void Config::SetAddressMapping() {
     ro_mask = (1 << field_widths.at("ro")) - 1;
     co_mask = (1 << field_widths.at("co")) - 1;
     // std::cout << "co_mask: " << co_mask << std::endl;
+    ch_bits = ch_mask << ch_pos;
+    ra_bits = ra_mask << ra_pos;
+    bg_bits = bg_mask << bg_pos;
+    ba_bits = ba_mask << ba_pos;
+    ro_bits = ro_mask << ro_pos;
+    co_bits = co_mask << co_pos;
+    if (!address_bits.empty()) {
+        SetAddressBits(field_widths);
+    }
+
+    // Non power of two counts, e.g. 3 or 12 channels, leave holes in bit
+    // fields, so the address is split as a mixed radix number in the
+    // address_mapping order instead, every field being the remainder of
+    // what the fields below it left over
+    if (!all_power_of_two) {
+        if (!address_bits.empty()) {
+            std::cerr << "address_bits needs power of two channels, ranks, "
+                         "banks, rows and columns"
+                      << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        std::map<std::string, int> field_index = {
+            {"ch", 0}, {"ra", 1}, {"bg", 2}, {"ba", 3}, {"ro", 4}, {"co", 5}};
+        for (const auto& token : lsb_first) {
+            // single value fields are always 0 and FastDivider needs 2+
+            if (field_counts.at(token) > 1) {
+                RadixField field = {field_index.at(token),
+                                    FastDivider(field_counts.at(token))};
+                radix_fields_.push_back(field);
+            }
+        }
+    }
+    SetAddressHashing();
+}
+
+Address Config::RadixMapping(uint64_t hex_addr) const {
+    int values[6] = {0, 0, 0, 0, 0, 0};
+    for (const auto& field : radix_fields_) {
+        uint64_t rest = field.divider.Divide(hex_addr);
+        values[field.index] =
+            static_cast<int>(hex_addr - rest * field.divider.Divisor());
+        hex_addr = rest;
+    }
+    return Address(values[0], values[1], values[2], values[3], values[4],
+                   values[5]);
+}
+
+int Config::GetChannel(uint64_t hex_addr) const {
+    if (!radix_fields_.empty()) {
+        return AddressMapping(hex_addr).channel;
+    }
+    hex_addr = GatherFields(HashAddress(hex_addr >> shift_bits));
+    return (hex_addr >> ch_pos) & ch_mask;
+}
+
+void Config::GetChannels(const uint64_t* hex_addrs, size_t count,
+                         int* channels) const {
+    if (!radix_fields_.empty() || !hash_tables_.empty() ||
+        !gather_tables_.empty()) {
+        for (size_t i = 0; i < count; i++) {
+            channels[i] = GetChannel(hex_addrs[i]);
+        }
+        return;
+    }
+    int shift = shift_bits + ch_pos;
+    uint64_t mask = ch_mask;
+    for (size_t i = 0; i < count; i++) {
+        channels[i] = static_cast<int>((hex_addrs[i] >> shift) & mask);
+    }
+}
+
+void Config::SetAddressBits(const std::map<std::string, int>& field_widths) {
+    std::map<std::string, uint64_t*> field_bits = {
+        {"ch", &ch_bits}, {"ra", &ra_bits}, {"bg", &bg_bits},
+        {"ba", &ba_bits}, {"ro", &ro_bits}, {"co", &co_bits}};
+    for (auto& field : field_bits) {
+        *field.second = 0;
+    }
+    std::vector<std::string> tokens;
+    for (const auto& item : StringSplit(address_bits, ' ')) {
+        StringSplit(item, ',', std::back_inserter(tokens));
+    }
+    // least significant bits first
+    int bit = 0;
+    for (auto it = tokens.rbegin(); it != tokens.rend(); ++it) {
+        auto field = field_bits.find(it->substr(0, 2));
+        const char* start = it->c_str() + std::min<size_t>(2, it->size());
+        char* end;
+        long count = *start == '\0' ? 1 : std::strtol(start, &end, 10);
+        if (field == field_bits.end() || count < 0 ||
+            (*start != '\0' && *end != '\0') || bit + count > 64) {
+            std::cerr << "Bad address_bits token \"" << *it
+                      << "\", use ch, ra, bg, ba, ro or co with an optional "
+                         "bit count"
+                      << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        for (long i = 0; i < count; i++, bit++) {
+            *field->second |= uint64_t(1) << bit;
+        }
+    }
+    for (const auto& field : field_bits) {
+        int width = 0;
+        for (uint64_t bits = *field.second; bits != 0; bits &= bits - 1) {
+            width++;
+        }
+        if (width != field_widths.at(field.first)) {
+            std::cerr << "address_bits gives " << field.first << " " << width
+                      << " bits, the organization needs "
+                      << field_widths.at(field.first) << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+    }
+
+    // where each address bit ends up in the rochrababgco layout
+    uint64_t bit_map[64] = {0};
+    std::vector<std::pair<uint64_t, int>> fields = {
+        {ch_bits, ch_pos}, {ra_bits, ra_pos}, {bg_bits, bg_pos},
+        {ba_bits, ba_pos}, {ro_bits, ro_pos}, {co_bits, co_pos}};
+    for (const auto& field : fields) {
+        int pos = field.second;
+        for (int b = 0; b < 64; b++) {
+            if (field.first >> b & 1) {
+                bit_map[b] = uint64_t(1) << pos++;
+            }
+        }
+    }
+    gather_tables_ = ByteTables(bit_map);
+}
+
+std::vector<Config::ByteTable> Config::ByteTables(
+    const uint64_t (&bit_map)[64]) {
+    // bit_map is what each address bit maps to, a byte maps to the XOR of
+    // its bits' values, tables of bytes that map to nothing are left out
+    std::vector<ByteTable> tables;
+    for (int shift = 0; shift < 64; shift += 8) {
+        ByteTable table;
+        table.shift = shift;
+        bool maps_any = false;
+        for (int value = 0; value < 256; value++) {
+            table.bits[value] = 0;
+            for (int b = 0; b < 8; b++) {
+                if (value >> b & 1) {
+                    table.bits[value] ^= bit_map[shift + b];
+                }
+            }
+            maps_any = maps_any || table.bits[value] != 0;
+        }
+        if (maps_any) {
+            tables.push_back(table);
+        }
+    }
+    return tables;
+}
+
+uint64_t Config::GatherFields(uint64_t hex_addr) const {
+    if (gather_tables_.empty()) {
+        return hex_addr;
+    }
+#ifdef __BMI2__
+    return GatherFieldsPEXT(hex_addr);
+#else
+    return GatherFieldsLUT(hex_addr);
+#endif  // __BMI2__
+}
+
+uint64_t Config::GatherFieldsLUT(uint64_t hex_addr) const {
+    uint64_t gathered = 0;
+    for (const auto& table : gather_tables_) {
+        gathered |= table.bits[(hex_addr >> table.shift) & 0xff];
+    }
+    return gathered;
+}
+
+// e.g. bank_hash = 0x8000, 0x10000 folds the two lowest row bits of
+// rochrababgco on DDR4 into the bank bits, so power of two strides that
+// only differ in the row spread over the banks instead of conflicting
+void Config::SetAddressHashing() {
+    const auto& reader = *reader_;
+    // the hashed fields are only a permutation of the address space as long
+    // as no mask reads a hashed bit
+    uint64_t hashed_bits = ch_bits | ra_bits | bg_bits | ba_bits;
+    auto parse = [&](const std::string& name, uint64_t field_mask) {
+        std::vector<uint64_t> masks;
+        std::string value = reader.Get("system", name, "");
+        if (value.empty()) {
+            return masks;
+        }
+        for (const auto& item : StringSplit(value, ',')) {
+            const char* start = item.c_str();
+            char* end;
+            uint64_t mask = std::strtoull(start, &end, 0);
+            while (*end == ' ' || *end == '\t') {
+                end++;
+            }
+            if (end == start || *end != '\0' || (mask & hashed_bits) != 0) {
+                std::cerr << "Bad " << name << " mask \"" << item
+                          << "\", masks are numbers that must not pick "
+                             "channel, rank, bankgroup or bank bits"
+                          << std::endl;
+                AbruptExit(__FILE__, __LINE__);
+            }
+            masks.push_back(mask);
+        }
+        if (masks.size() > static_cast<size_t>(LogBase2(field_mask + 1))) {
+            std::cerr << name << " has more masks than the field has bits"
+                      << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        return masks;
+    };
+    ch_hash = parse("channel_hash", ch_mask);
+    ra_hash = parse("rank_hash", ra_mask);
+    bg_hash = parse("bankgroup_hash", bg_mask);
+    ba_hash = parse("bank_hash", ba_mask);
+    if (!radix_fields_.empty() &&
+        !(ch_hash.empty() && ra_hash.empty() && bg_hash.empty() &&
+          ba_hash.empty())) {
+        std::cerr << "XOR hashing needs power of two channels, ranks, banks, "
+                     "rows and columns"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+
+    // address bits of the fields flipped by each address bit, bit i of a
+    // field being the i-th lowest of its bits
+    uint64_t bit_flips[64] = {0};
+    std::vector<std::pair<const std::vector<uint64_t>*, uint64_t>> fields = {
+        {&ch_hash, ch_bits}, {&ra_hash, ra_bits}, {&bg_hash, bg_bits},
+        {&ba_hash, ba_bits}};
+    for (const auto& field : fields) {
+        uint64_t field_bits = field.second;
+        for (size_t i = 0; i < field.first->size(); i++) {
+            uint64_t target = field_bits & (~field_bits + 1);  // lowest left
+            field_bits &= field_bits - 1;
+            for (int b = 0; b < 64; b++) {
+                if ((*field.first)[i] >> b & 1) {
+                    bit_flips[b] |= target;
+                }
+            }
+        }
+    }
+    hash_tables_ = ByteTables(bit_flips);
 }
 
 }  // namespace dramsim3
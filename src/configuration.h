@@ -2,11 +2,18 @@
 #define __CONFIG_H
 
 #include <fstream>
+#include <map>
+#include <memory>
 #include <string>
+#include <vector>
 #include "common.h"
 
 #include "INIReader.h"
 
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif  // __BMI2__
+
 namespace dramsim3 {
 
 enum class DRAMProtocol {
@@ -31,10 +38,58 @@ enum class RefreshPolicy {
     SIZE 
 };
 
+class Timing;
+
+// "section.key" -> value text, same syntax as in the ini files
+using ConfigOverrides = std::map<std::string, std::string>;
+
+// INIReader lookups with overrides on top, so configs can be varied without
+// writing new files. Values in {} are sweeps and only make sense to the sweep
+// runner, reading one is an error.
+class ConfigReader {
+   public:
+    ConfigReader(const INIReader* ini, const ConfigOverrides& overrides);
+    std::string Get(const std::string& section, const std::string& name,
+                    const std::string& default_value) const;
+    long GetInteger(const std::string& section, const std::string& name,
+                    long default_value) const;
+    double GetReal(const std::string& section, const std::string& name,
+                   double default_value) const;
+    bool GetBoolean(const std::string& section, const std::string& name,
+                    bool default_value) const;
+
+   private:
+    bool Lookup(const std::string& section, const std::string& name,
+                std::string& value) const;
+
+    const INIReader* ini_;
+    ConfigOverrides overrides_;  // keys lower cased like INIReader does
+};
+
+// Everything derived from a config file. Nothing changes after construction,
+// so one Config can be shared read-only by any number of memory systems on
+// any number of threads, see MemorySystem.
 class Config {
    public:
     Config(std::string config_file, std::string out_dir);
+    // from an ini file parsed beforehand, overrides take precedence over it
+    Config(const INIReader& ini, const ConfigOverrides& overrides,
+           std::string out_dir);
+    // no file at all, every key not in values takes its default
+    Config(const ConfigOverrides& values, std::string out_dir);
+    ~Config();
+    Config(const Config&) = delete;
+    Config& operator=(const Config&) = delete;
     Address AddressMapping(uint64_t hex_addr) const;
+    int GetChannel(uint64_t hex_addr) const;
+    // GetChannel of count addresses, without hashing, address_bits or radix
+    // fields it is one shift and mask loop the compiler can vectorize
+    void GetChannels(const uint64_t* hex_addrs, size_t count,
+                     int* channels) const;
+    // non power of two organizations, no bit fields and no XOR hashing
+    bool IsRadixMapping() const { return !radix_fields_.empty(); }
+    // timing constraint tables, built once with the rest of the config
+    const Timing& GetTiming() const { return *timing_; }
     // DRAM physical structure
     DRAMProtocol protocol;
     int channel_size;
@@ -50,10 +105,44 @@ class Config {
     int devices_per_rank;
     int BL;
 
-    // Address mapping numbers
+    // Address mapping numbers, with address_bits the positions are the ones
+    // in the rochrababgco layout GatherFields puts the fields into. Fields
+    // with a non power of two count are not bit fields, see RadixMapping,
+    // their masks cover the next power of two.
     int shift_bits;
     int ch_pos, ra_pos, bg_pos, ba_pos, ro_pos, co_pos;
     uint64_t ch_mask, ra_mask, bg_mask, ba_mask, ro_mask, co_mask;
+    // address bits (after shift_bits) each field is made of
+    uint64_t ch_bits, ra_bits, bg_bits, ba_bits, ro_bits, co_bits;
+    // XOR hashing, bit i of a field is flipped by the parity of the address
+    // bits (after shift_bits) picked by its i-th mask, empty if not hashed
+    std::vector<uint64_t> ch_hash, ra_hash, bg_hash, ba_hash;
+    // The hashing is linear, so it is applied as one table lookup per address
+    // byte that any mask picks, giving the field bits that byte flips. No
+    // tables at all without hashing. Takes and returns shifted addresses.
+    uint64_t HashAddress(uint64_t hex_addr) const {
+        uint64_t flips = 0;
+        for (const auto& table : hash_tables_) {
+            flips ^= table.bits[(hex_addr >> table.shift) & 0xff];
+        }
+        return hex_addr ^ flips;
+    }
+    // Moves the bits of an address_bits layout into rochrababgco order,
+    // leaves address_mapping layouts alone. PEXT when built with BMI2
+    // (cmake -DBMI2=ON), otherwise one table lookup per address byte that
+    // holds field bits. Both give the same results.
+    uint64_t GatherFields(uint64_t hex_addr) const;
+    uint64_t GatherFieldsLUT(uint64_t hex_addr) const;
+#ifdef __BMI2__
+    uint64_t GatherFieldsPEXT(uint64_t hex_addr) const {
+        return _pext_u64(hex_addr, ch_bits) << ch_pos |
+               _pext_u64(hex_addr, ra_bits) << ra_pos |
+               _pext_u64(hex_addr, bg_bits) << bg_pos |
+               _pext_u64(hex_addr, ba_bits) << ba_pos |
+               _pext_u64(hex_addr, ro_bits) << ro_pos |
+               _pext_u64(hex_addr, co_bits) << co_pos;
+    }
+#endif  // __BMI2__
 
     // Generic DRAM timing parameters
     double tCK;
@@ -121,7 +210,15 @@ class Config {
     int xbar_queue_depth;
 
     // System
+    std::string memory_backend;  // JEDEC, IDEAL or ANALYTICAL
+    int analytical_calibration;  // reads checked against JEDEC, 0 to skip
     std::string address_mapping;
+    // Per-bit layout, overrides address_mapping. Fields from the most
+    // significant bit down like address_mapping, each with a bit count, so
+    // "ch1 ro16 ra1 ba2 bg2 co5 ch1 co2" interleaves two channels every 256B
+    // and puts the other channel bit above the row. Bit k of a field is the
+    // k-th lowest address bit assigned to it.
+    std::string address_bits;
     std::string queue_structure;
     std::string row_buf_policy;
     RefreshPolicy refresh_policy;
@@ -137,11 +234,8 @@ class Config {
 
     int epoch_period;
     int output_level;
-    std::string output_dir;
-    std::string output_prefix;
-    std::string json_stats_name;
-    std::string json_epoch_name;
-    std::string txt_stats_name;
+    std::string output_dir;   // as given, checked by OutputNames
+    std::string output_name;  // [other] output_prefix, without the directory
 
     // Computed parameters
     int request_size_bytes;
@@ -160,6 +254,8 @@ class Config {
     bool IsDDR4() const { return (protocol == DRAMProtocol::DDR4); }
 
     int ideal_memory_latency;
+    bool ideal_bandwidth_limit;  // one burst per burst_cycle per channel
+    int ideal_queue_size;        // bursts per channel, 0 for unbounded
 
 #ifdef THERMAL
     std::string loc_mapping;
@@ -183,7 +279,25 @@ class Config {
 #endif  // THERMAL
 
    private:
-    INIReader* reader_;
+    const ConfigReader* reader_;  // only valid during construction
+    std::unique_ptr<const Timing> timing_;
+    // what each value of the address byte at shift maps to
+    struct ByteTable {
+        int shift;
+        uint64_t bits[256];
+    };
+    std::vector<ByteTable> hash_tables_;
+    std::vector<ByteTable> gather_tables_;
+    // fields of a non power of two organization, least significant first,
+    // empty if everything is a power of two
+    struct RadixField {
+        int index;  // in Address order, channel is 0 and column 5
+        FastDivider divider;
+    };
+    std::vector<RadixField> radix_fields_;
+    Address RadixMapping(uint64_t hex_addr) const;
+    static std::vector<ByteTable> ByteTables(const uint64_t (&bit_map)[64]);
+    void Init(const ConfigReader& reader);
     void CalculateSize();
     DRAMProtocol GetDRAMProtocol(std::string protocol_str);
     int GetInteger(const std::string& sec, const std::string& opt,
@@ -197,6 +311,27 @@ class Config {
 #endif  // THERMAL
     void InitTimingParams();
     void SetAddressMapping();
+    void SetAddressBits(const std::map<std::string, int>& field_widths);
+    void SetAddressHashing();
+};
+
+// Output file names of one memory system. Memory systems sharing a Config
+// still need files of their own, so the names live here instead: the output
+// prefix is reserved among the live memory systems in the process, a taken
+// one gets _1, _2... appended, and it is released again on destruction.
+class OutputNames {
+   public:
+    explicit OutputNames(const Config& config);
+    // for a helper system of the one using config, suffix goes after the
+    // output name
+    OutputNames(const Config& config, const std::string& suffix);
+    ~OutputNames();
+    OutputNames(const OutputNames&) = delete;
+    OutputNames& operator=(const OutputNames&) = delete;
+    std::string output_prefix;
+    std::string json_stats_name;
+    std::string json_epoch_name;
+    std::string txt_stats_name;
 };
 
 }  // namespace dramsim3
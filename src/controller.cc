@@ -1,4 +1,5 @@
 #include "controller.h"
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <limits>
@@ -7,14 +8,16 @@ namespace dramsim3 {
 
 #ifdef THERMAL
 Controller::Controller(int channel, const Config &config, const Timing &timing,
+                       const OutputNames &outputs,
                        ThermalCalculator &thermal_calc)
 #else
-Controller::Controller(int channel, const Config &config, const Timing &timing)
+Controller::Controller(int channel, const Config &config, const Timing &timing,
+                       const OutputNames &outputs)
 #endif  // THERMAL
     : channel_id_(channel),
       clk_(0),
       config_(config),
-      simple_stats_(config_, channel_id_),
+      simple_stats_(config_, outputs, channel_id_),
       channel_state_(config, timing),
       cmd_queue_(channel_id_, config, channel_state_, simple_stats_),
       refresh_(config, channel_state_),
@@ -30,6 +33,7 @@ Controller::Controller(int channel, const Config &config, const Timing &timing)
       thermal_calc_(thermal_calc),
 #endif  // THERMAL
       is_unified_queue_(config.unified_queue),
+      next_group_(1),
       row_buf_policy_(config.row_buf_policy == "CLOSE_PAGE"
                           ? RowBufPolicy::CLOSE_PAGE
                           : RowBufPolicy::OPEN_PAGE),
@@ -44,7 +48,7 @@ Controller::Controller(int channel, const Config &config, const Timing &timing)
     }
 
 #ifdef CMD_TRACE
-    std::string trace_file_name = config_.output_prefix + "ch_" +
+    std::string trace_file_name = outputs.output_prefix + "ch_" +
                                   std::to_string(channel_id_) + "cmd.trace";
     std::cout << "Command Trace write to " << trace_file_name << std::endl;
     cmd_trace_.open(trace_file_name, std::ofstream::out);
@@ -53,25 +57,29 @@ Controller::Controller(int channel, const Config &config, const Timing &timing)
 
 //所有已经完成的transaction都会被加入return_queue
 //每个cycle都会在return_queue里检查，是否有read或write的完成时间小于当前cycle，如果有，说明可以返回给cpu了
-//将这样的transaction都构造成pair的格式，pair.first = addr, pair.second = is_write
-std::pair<uint64_t, int> Controller::ReturnDoneTrans(uint64_t clk) {
+//找到一个就通过trans返回，complete_cycle改成实际返回的cycle
+bool Controller::ReturnDoneTrans(uint64_t clk, Transaction &trans) {
+    PROFILE_SCOPE(profiler_, ProfPhase::RETURN_TRANS);
     auto it = return_queue_.begin();
     while (it != return_queue_.end()) {
         if (clk >= it->complete_cycle) {
+            // done counts are in bursts so the bandwidth stays right for
+            // multi burst requests
             if (it->is_write) {
-                simple_stats_.Increment("num_writes_done");
+                simple_stats_.IncrementBy("num_writes_done", it->bursts);
             } else {
-                simple_stats_.Increment("num_reads_done");
+                simple_stats_.IncrementBy("num_reads_done", it->bursts);
                 simple_stats_.AddValue("read_latency", clk_ - it->added_cycle);
             }
-            auto pair = std::make_pair(it->addr, it->is_write);
-            it = return_queue_.erase(it);
-            return pair;
+            trans = *it;
+            trans.complete_cycle = clk;
+            return_queue_.erase(it);
+            return true;
         } else {
             ++it;
         }
     }
-    return std::make_pair(-1, -1);
+    return false;
 }
 
 //对于memory controller来说，每个cycle里要做的事情：
@@ -81,9 +89,13 @@ std::pair<uint64_t, int> Controller::ReturnDoneTrans(uint64_t clk) {
 //4. 调度下一个transaction
 //5. 出发command_queue的时钟更新
 void Controller::ClockTick() {
+    PROFILE_SCOPE(profiler_, ProfPhase::CLOCK_TICK);
     // update refresh counter
     //先更新refresh，如果当前cycle需要refresh，那么所有状态要被保存并停止
-    refresh_.ClockTick();
+    {
+        PROFILE_SCOPE(profiler_, ProfPhase::REFRESH);
+        refresh_.ClockTick();
+    }
 
     bool cmd_issued = false;
     //command包括 command_type，addr和hex_addr
@@ -98,6 +110,7 @@ void Controller::ClockTick() {
     //如果符合时序，这里的cmd返回的可能是read/write(所有的前置指令都执行完毕，row buffer命中，可以去执行真正的read/write了)
     //也可能是activate或precharge等其他命令
     if (!cmd.IsValid()) {
+        PROFILE_SCOPE(profiler_, ProfPhase::CMD_SELECT);
         cmd = cmd_queue_.GetCommandToIssue();
     }
 
@@ -106,7 +119,11 @@ void Controller::ClockTick() {
         cmd_issued = true;
 
         if (config_.enable_hbm_dual_cmd) {
-            auto second_cmd = cmd_queue_.GetCommandToIssue();
+            Command second_cmd;
+            {
+                PROFILE_SCOPE(profiler_, ProfPhase::CMD_SELECT);
+                second_cmd = cmd_queue_.GetCommandToIssue();
+            }
             if (second_cmd.IsValid()) {
                 if (second_cmd.IsReadWrite() != cmd.IsReadWrite()) {
                     IssueCommand(second_cmd);
@@ -173,15 +190,39 @@ void Controller::ClockTick() {
     }
 
     //MZOU
-    Calculate_stats();
+    {
+        PROFILE_SCOPE(profiler_, ProfPhase::CALC_STATS);
+        Calculate_stats();
+    }
     //MZOU
-    ScheduleTransaction();
+    {
+        PROFILE_SCOPE(profiler_, ProfPhase::SCHEDULE_TRANS);
+        // staged bursts go in before anything is picked from the queues
+        if (!staged_reads_.empty()) {
+            FeedBursts(false);
+        }
+        if (!staged_writes_.empty()) {
+            FeedBursts(true);
+        }
+        ScheduleTransaction();
+    }
     clk_++;
     cmd_queue_.ClockTick();
     simple_stats_.Increment("num_cycles");
     return;
 }
 
+bool Controller::FunctionalAccess(uint64_t hex_addr) {
+    auto addr = config_.AddressMapping(hex_addr);
+    bool row_hit = channel_state_.FunctionalAccess(
+        addr, row_buf_policy_ == RowBufPolicy::CLOSE_PAGE);
+    simple_stats_.Increment("num_warmup_accesses");
+    if (row_hit) {
+        simple_stats_.Increment("num_warmup_row_hits");
+    }
+    return row_hit;
+}
+
 //MZOU
 //统计这个cycle的状态
 void Controller::Calculate_stats()
@@ -215,30 +256,86 @@ void Controller::Calculate_stats()
 //由memory controller决定是否接受下一个来自trace_file的transaction
 //就是看queue里还有没有容量
 bool Controller::WillAcceptTransaction(uint64_t hex_addr, bool is_write) const {
+    return HasRoom(is_write, 1);
+}
+
+bool Controller::HasRoom(bool is_write, int bursts) const {
+    if (!(is_write && !is_unified_queue_ ? staged_writes_ : staged_reads_)
+             .empty()) {
+        return false;
+    }
     if (is_unified_queue_) {
-        return unified_queue_.size() < unified_queue_.capacity();
+        return unified_queue_.size() + bursts <= unified_queue_.capacity();
     } else if (!is_write) {
 //	std::cout << "This is a read request, read_queue.size = " << read_queue_.size() << ", capacity = " << read_queue_.capacity() << std::endl;
-        return read_queue_.size() < read_queue_.capacity();
+        return read_queue_.size() + bursts <= read_queue_.capacity();
     } else {
 //	std::cout << "This is a write request, write_buffer.size = " << write_buffer_.size() << ", capacity = " << write_buffer_.capacity() << std::endl;
-        return write_buffer_.size() < write_buffer_.capacity();
+        return write_buffer_.size() + bursts <= write_buffer_.capacity();
     }
 }
 
+bool Controller::AddTransaction(Transaction trans) {
+    InsertTransaction(trans);
+    return true;
+}
+
+AddResult Controller::TryAddTransaction(Transaction trans) {
+    // merged writes and reads that are forwarded or join a waiting read
+    // don't take a slot, they go in even when the queue is full
+    bool needs_slot = trans.bursts > 1 ||
+                      (pending_wr_q_.find(trans.addr) == pending_wr_q_.end() &&
+                       (trans.is_write || pending_rd_q_.find(trans.addr) ==
+                                              pending_rd_q_.end()));
+    if (needs_slot && !CanTake(trans.is_write, trans.bursts)) {
+        return trans.is_write && !is_unified_queue_
+                   ? AddResult::WRITE_BUFFER_FULL
+                   : AddResult::READ_QUEUE_FULL;
+    }
+    return InsertTransaction(trans);
+}
+
+bool Controller::CanTake(bool is_write, int bursts) const {
+    int capacity = TransQueueCapacity(is_write);
+    return HasRoom(is_write, bursts > capacity ? 1 : bursts);
+}
+
+AddResult Controller::AddPart(Transaction trans) {
+    return InsertTransaction(trans);
+}
+
+int Controller::TransQueueOccupancy(bool is_write) const {
+    if (is_unified_queue_) {
+        return unified_queue_.size();
+    }
+    return is_write ? write_buffer_.size() : read_queue_.size();
+}
+
+int Controller::TransQueueCapacity(bool is_write) const {
+    if (is_unified_queue_) {
+        return unified_queue_.capacity();
+    }
+    return is_write ? write_buffer_.capacity() : read_queue_.capacity();
+}
+
 //来自cpu的transaction会保存在read queue / write buffer里， 而pending_rd_q_和pending_wr_q_里保存的是还未被翻译成command的transaction
 //pending_rd_q_和pending_wr_q_分别缓存了未被翻译的read/write transaction
 //翻译完成后，会将pending里的相应内容删除，转而保存在cmd_queue里
-bool Controller::AddTransaction(Transaction trans) {
+AddResult Controller::InsertTransaction(Transaction trans) {
     //trans加入到queue里的时刻是当前cycle
     //last_trans_clk是上一个trans加入到queue里的时刻，interarrival_latency是相邻两个transaction加入到queue里的时间
     trans.added_cycle = clk_;
     simple_stats_.AddValue("interarrival_latency", clk_ - last_trans_clk_);
     last_trans_clk_ = clk_;
 
+    // parts always stage, the room check was for all parts together
+    if (trans.bursts > 1 || trans.split != 0) {
+        return InsertBursts(trans);
+    }
     if (trans.is_write) {
         //pending_wr_q_是一个write buffer，缓存了所有要处理但还未被翻译成command的transaction，可以给read命令提供旁路，也可以合并多个对同一地址的写入命令
         //如果count == 0，说明在pending_wr_q_里没有对这一地址的写入，需要新加进去
+        AddResult result = AddResult::MERGED;
         if (pending_wr_q_.count(trans.addr) == 0) {  // can not merge writes
             //将transaction加入dram的待翻译队列中，等待被调度翻译成command
             pending_wr_q_.insert(std::make_pair(trans.addr, trans));
@@ -247,18 +344,21 @@ bool Controller::AddTransaction(Transaction trans) {
             } else {
                 write_buffer_.push_back(trans);
             }
+            result = AddResult::ACCEPTED;
         }
         //加入queue里这个write trans就完成了，剩下的是dram完成的工作，所以设置trans的complete_cycle并加入return_queue里
         trans.complete_cycle = clk_ + 1;
+        trans.served_by = ServedBy::WRITE_POSTED;
         return_queue_.push_back(trans);
-        return true;
+        return result;
     } else {  // read
         // if in write buffer, use the write buffer value
         //如果是read transaction，先检查pending_wr_q_是否有对于同一地址的写回，如果有，这个read已经完成了，可以被加入return_queue_里
         if (pending_wr_q_.count(trans.addr) > 0) {
             trans.complete_cycle = clk_ + 1;
+            trans.served_by = ServedBy::WRITE_FORWARD;
             return_queue_.push_back(trans);
-            return true;
+            return AddResult::FORWARDED;
         }
         //如果pending_wr_q_里没有旁路，只能加入到pending_rd_q_，等待被调度解析成command
         pending_rd_q_.insert(std::make_pair(trans.addr, trans));
@@ -268,8 +368,97 @@ bool Controller::AddTransaction(Transaction trans) {
             } else {
                 read_queue_.push_back(trans);
             }
+            return AddResult::ACCEPTED;
+        }
+        return AddResult::MERGED;
+    }
+}
+
+// Burst k of a multi burst transaction is at addr + k * request_size_bytes,
+// with the column bits lowest in the address mapping these are consecutive
+// columns of one row, past a row end each burst maps to its own. Each burst
+// takes its own queue slot and merges or is forwarded just like a single
+// burst transaction to its address would be. Bursts that find no free slot
+// are staged and fed in by later cycles, they are in the pending queues
+// already so later requests merge with and forward from them as if they
+// were queued. Writes are posted as a whole right away, reads complete once
+// their last burst has been read.
+AddResult Controller::InsertBursts(Transaction trans) {
+    std::deque<Transaction> &staged =
+        trans.is_write && !is_unified_queue_ ? staged_writes_ : staged_reads_;
+    Transaction burst = trans;
+    burst.bursts = 1;
+    if (trans.is_write) {
+        bool queued = false;
+        for (int k = 0; k < trans.bursts; k++) {
+            burst.addr = trans.addr +
+                         static_cast<uint64_t>(k) * config_.request_size_bytes;
+            if (pending_wr_q_.count(burst.addr) == 0) {
+                pending_wr_q_.insert(std::make_pair(burst.addr, burst));
+                staged.push_back(burst);
+                queued = true;
+            }
+        }
+        FeedBursts(trans.is_write);
+        trans.complete_cycle = clk_ + 1;
+        trans.served_by = ServedBy::WRITE_POSTED;
+        return_queue_.push_back(trans);
+        return queued ? AddResult::ACCEPTED : AddResult::MERGED;
+    }
+
+    burst.group = next_group_++;
+    int waiting = 0;
+    bool queued = false;
+    for (int k = 0; k < trans.bursts; k++) {
+        burst.addr =
+            trans.addr + static_cast<uint64_t>(k) * config_.request_size_bytes;
+        if (pending_wr_q_.count(burst.addr) > 0) {
+            continue;  // forwarded
+        }
+        pending_rd_q_.insert(std::make_pair(burst.addr, burst));
+        waiting++;
+        if (pending_rd_q_.count(burst.addr) == 1) {
+            staged.push_back(burst);
+            queued = true;
         }
-        return true;
+    }
+    if (waiting == 0) {
+        trans.complete_cycle = clk_ + 1;
+        trans.served_by = ServedBy::WRITE_FORWARD;
+        return_queue_.push_back(trans);
+        return AddResult::FORWARDED;
+    }
+    FeedBursts(trans.is_write);
+    // a hit unless any burst misses
+    trans.served_by = ServedBy::ROW_HIT;
+    burst_groups_[burst.group] = std::make_pair(waiting, trans);
+    return queued ? AddResult::ACCEPTED : AddResult::MERGED;
+}
+
+// Moves staged bursts into their queue while it has free slots
+void Controller::FeedBursts(bool is_write) {
+    std::deque<Transaction> &staged =
+        is_write && !is_unified_queue_ ? staged_writes_ : staged_reads_;
+    std::vector<Transaction> &queue =
+        is_unified_queue_ ? unified_queue_
+                          : is_write ? write_buffer_ : read_queue_;
+    while (!staged.empty() && queue.size() < queue.capacity()) {
+        queue.push_back(staged.front());
+        staged.pop_front();
+    }
+}
+
+void Controller::FinishBurst(uint64_t group, ServedBy served_by) {
+    auto it = burst_groups_.find(group);
+    Transaction &trans = it->second.second;
+    if (served_by == ServedBy::ROW_MISS) {
+        trans.served_by = ServedBy::ROW_MISS;
+    }
+    it->second.first--;
+    if (it->second.first == 0) {
+        trans.complete_cycle = clk_ + config_.read_delay;
+        return_queue_.push_back(trans);
+        burst_groups_.erase(it);
     }
 }
 
@@ -291,6 +480,17 @@ void Controller::ScheduleTransaction() {
     //所以当转换到write模式以后，只有两个转机会回到read：在pending_rd_q_里找到相应的命令，也就是旁路上去；或者所有在触发时刻的write_buffer_都处理完了
     //所以write_buffer和read_queue是对于cpu的，当将这个transaction翻译完成就可以在write_queue或read_queue里删除了，但是pending_rd_q和pending_wr_q里的内容则是针对dram的，只有当真正处理完才能够删除
     std::vector<Transaction> &queue = is_unified_queue_ ? unified_queue_ : write_draining_ > 0 ? write_buffer_ : read_queue_;
+    if (!IssueFrom(queue)) {
+        // the reads the write waits for go instead, a write buffer full of
+        // such writes would otherwise keep them out forever
+        IssueFrom(read_queue_);
+    }
+}
+
+// Moves the first transaction of queue whose bank takes a command into the
+// command queue, false if that is a write that has to wait for a read to its
+// address first
+bool Controller::IssueFrom(std::vector<Transaction> &queue) {
     for (auto it = queue.begin(); it != queue.end(); it++) {
         auto cmd = TransToCommand(*it);
         if (cmd_queue_.WillAcceptCommand(cmd.Rank(), cmd.Bankgroup(), cmd.Bank())) {
@@ -298,15 +498,16 @@ void Controller::ScheduleTransaction() {
                 // Enforce R->W dependency
                 if (pending_rd_q_.count(it->addr) > 0) {
                     write_draining_ = 0;
-                    break;
+                    return false;
                 }
                 write_draining_ -= 1;
             }
             cmd_queue_.AddCommand(cmd);
             queue.erase(it);
-            break;
+            return true;
         }
     }
+    return true;
 }
 
 //memory controller处理command
@@ -334,10 +535,21 @@ void Controller::IssueCommand(const Command &cmd) {
         }
         // if there are multiple reads pending return them all
         // complete_cycle是当前cycle加上read_delay，当前cycle已经被dram里的各种操作影响过
+        // same test as the row hit stats, before the bank state moves on
+        ServedBy served_by =
+            channel_state_.RowHitCount(cmd.Rank(), cmd.Bankgroup(),
+                                       cmd.Bank()) != 0
+                ? ServedBy::ROW_HIT
+                : ServedBy::ROW_MISS;
         while (num_reads > 0) {
             auto it = pending_rd_q_.find(cmd.hex_addr);
-            it->second.complete_cycle = clk_ + config_.read_delay;
-            return_queue_.push_back(it->second);
+            if (it->second.group != 0) {
+                FinishBurst(it->second.group, served_by);
+            } else {
+                it->second.complete_cycle = clk_ + config_.read_delay;
+                it->second.served_by = served_by;
+                return_queue_.push_back(it->second);
+            }
             pending_rd_q_.erase(it);
             num_reads -= 1;
         }
@@ -424,6 +636,7 @@ Command Controller::TransToCommand(const Transaction &trans) {
 int Controller::QueueUsage() const { return cmd_queue_.QueueUsage(); }
 
 void Controller::PrintEpochStats() {
+    PROFILE_SCOPE(profiler_, ProfPhase::EPOCH_STATS);
     simple_stats_.Increment("epoch_num");
     simple_stats_.PrintEpochStats();
 #ifdef THERMAL
@@ -493,4 +706,56 @@ void Controller::UpdateCommandStats(const Command &cmd, int count) {
     }
 }
 
+void Controller::SaveState(CheckpointWriter &ckpt) const {
+    Save(ckpt, clk_);
+    simple_stats_.SaveState(ckpt);
+    channel_state_.SaveState(ckpt);
+    cmd_queue_.SaveState(ckpt);
+    refresh_.SaveState(ckpt);
+    Save(ckpt, concurrent_serve);
+    Save(ckpt, is_active_cycles);
+    Save(ckpt, read_cmds);
+    Save(ckpt, write_cmds);
+    Save(ckpt, read_row_hits);
+    Save(ckpt, write_row_hits);
+    Save(ckpt, unified_queue_);
+    Save(ckpt, read_queue_);
+    Save(ckpt, write_buffer_);
+    Save(ckpt, pending_rd_q_);
+    Save(ckpt, pending_wr_q_);
+    Save(ckpt, burst_groups_);
+    Save(ckpt, next_group_);
+    Save(ckpt, staged_reads_);
+    Save(ckpt, staged_writes_);
+    Save(ckpt, return_queue_);
+    Save(ckpt, last_trans_clk_);
+    Save(ckpt, write_draining_);
+}
+
+void Controller::LoadState(CheckpointReader &ckpt) {
+    Load(ckpt, clk_);
+    simple_stats_.LoadState(ckpt);
+    channel_state_.LoadState(ckpt);
+    cmd_queue_.LoadState(ckpt);
+    refresh_.LoadState(ckpt);
+    Load(ckpt, concurrent_serve);
+    Load(ckpt, is_active_cycles);
+    Load(ckpt, read_cmds);
+    Load(ckpt, write_cmds);
+    Load(ckpt, read_row_hits);
+    Load(ckpt, write_row_hits);
+    Load(ckpt, unified_queue_);
+    Load(ckpt, read_queue_);
+    Load(ckpt, write_buffer_);
+    Load(ckpt, pending_rd_q_);
+    Load(ckpt, pending_wr_q_);
+    Load(ckpt, burst_groups_);
+    Load(ckpt, next_group_);
+    Load(ckpt, staged_reads_);
+    Load(ckpt, staged_writes_);
+    Load(ckpt, return_queue_);
+    Load(ckpt, last_trans_clk_);
+    Load(ckpt, write_draining_);
+}
+
 }  // namespace dramsim3
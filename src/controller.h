@@ -1,6 +1,7 @@
 #ifndef __CONTROLLER_H
 #define __CONTROLLER_H
 
+#include <deque>
 #include <fstream>
 #include <map>
 #include <unordered_set>
@@ -8,6 +9,7 @@
 #include "channel_state.h"
 #include "command_queue.h"
 #include "common.h"
+#include "profiler.h"
 #include "refresh.h"
 #include "simple_stats.h"
 
@@ -23,13 +25,34 @@ class Controller {
    public:
 #ifdef THERMAL
     Controller(int channel, const Config &config, const Timing &timing,
-               ThermalCalculator &thermalcalc);
+               const OutputNames &outputs, ThermalCalculator &thermalcalc);
 #else
-    Controller(int channel, const Config &config, const Timing &timing);
+    Controller(int channel, const Config &config, const Timing &timing,
+               const OutputNames &outputs);
 #endif  // THERMAL
     void ClockTick();
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const;
     bool AddTransaction(Transaction trans);
+    // capacity check and add in one, see AddResult. Transactions of more
+    // than one burst are split into one queue entry per burst, see
+    // InsertBursts, and need a free slot for each. One with more bursts
+    // than the queue has slots only needs one free slot, the rest of it
+    // goes in as slots free up.
+    AddResult TryAddTransaction(Transaction trans);
+    // whether a transaction of this many bursts, or parts adding up to it,
+    // would find room, by the same rule as TryAddTransaction
+    bool CanTake(bool is_write, int bursts) const;
+    // adds a part of a split request without a capacity check, the caller
+    // made sure with CanTake. Its bursts are staged like those of a multi
+    // burst transaction and it comes back from ReturnDoneTrans on its own
+    AddResult AddPart(Transaction trans);
+    // bursts holding a slot of the read (or unified) queue or of the write
+    // buffer, and how many slots there are
+    int TransQueueOccupancy(bool is_write) const;
+    int TransQueueCapacity(bool is_write) const;
+    // functional warmup, only the row buffer state and stats are touched,
+    // true on a row hit
+    bool FunctionalAccess(uint64_t hex_addr);
     //MZOU
     // 统计parallelism相关
     void Calculate_stats();
@@ -48,7 +71,16 @@ class Controller {
     void PrintEpochStats();
     void PrintFinalStats();
     void ResetStats() { simple_stats_.Reset(); }
-    std::pair<uint64_t, int> ReturnDoneTrans(uint64_t clock);
+    uint64_t GetStatCounter(const std::string &name) const {
+        return simple_stats_.GetCounter(name);
+    }
+    // one transaction done by clock, if any, with complete_cycle set to it
+    bool ReturnDoneTrans(uint64_t clock, Transaction &trans);
+    void SaveState(CheckpointWriter &ckpt) const;
+    void LoadState(CheckpointReader &ckpt);
+#ifdef SELF_PROFILE
+    const PhaseProfiler &GetProfiler() const { return profiler_; }
+#endif  // SELF_PROFILE
 
     int channel_id_;
 
@@ -82,6 +114,17 @@ class Controller {
     std::multimap<uint64_t, Transaction> pending_rd_q_;
     std::multimap<uint64_t, Transaction> pending_wr_q_;
 
+    // multi burst reads by group id, bursts still to be read and the
+    // transaction as the host added it
+    std::map<uint64_t, std::pair<int, Transaction>> burst_groups_;
+    uint64_t next_group_;
+    // bursts still waiting for a slot of the read (or unified) queue and of
+    // the write buffer, in order. They are in the pending queues already,
+    // only their slot is missing. A queue takes nothing new until its
+    // staged bursts are all in.
+    std::deque<Transaction> staged_reads_;
+    std::deque<Transaction> staged_writes_;
+
     // completed transactions
     std::vector<Transaction> return_queue_;
 
@@ -92,11 +135,21 @@ class Controller {
     std::ofstream cmd_trace_;
 #endif  // CMD_TRACE
 
+#ifdef SELF_PROFILE
+    PhaseProfiler profiler_;
+#endif  // SELF_PROFILE
+
     // used to calculate inter-arrival latency
     uint64_t last_trans_clk_;
 
     // transaction queueing
     int write_draining_;
+    bool HasRoom(bool is_write, int bursts) const;
+    AddResult InsertTransaction(Transaction trans);
+    AddResult InsertBursts(Transaction trans);
+    void FeedBursts(bool is_write);
+    bool IssueFrom(std::vector<Transaction> &queue);
+    void FinishBurst(uint64_t group, ServedBy served_by);
     void ScheduleTransaction();
     void IssueCommand(const Command &tmp_cmd);
     Command TransToCommand(const Transaction &trans);
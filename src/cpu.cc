@@ -1,12 +1,14 @@
 #include "cpu.h"
 
+#include <thread>
+
 namespace dramsim3 {
 
 void RandomCPU::ClockTick() {
     // Create random CPU requests at full speed
     // this is useful to exploit the parallelism of a DRAM protocol
     // and is also immune to address mapping and scheduling policies
-    memory_system_.ClockTick();
+    memory_system_.HostClockTick();
     if (get_next_) {
         last_addr_ = gen();
         last_write_ = (gen() % 3 == 0);
@@ -25,7 +27,7 @@ void StreamCPU::ClockTick() {
     // enough buffer hits
 
     // moving on to next set of arrays
-    memory_system_.ClockTick();
+    memory_system_.HostClockTick();
     if (offset_ >= array_size_ || clk_ == 0) {
         addr_a_ = gen();
         addr_b_ = gen();
@@ -70,9 +72,19 @@ TraceBasedCPU::TraceBasedCPU(const std::string& config_file,
     }
 }
 
+TraceBasedCPU::TraceBasedCPU(std::shared_ptr<const Config> config,
+                             const std::string& trace_file)
+    : CPU(config) {
+    trace_file_.open(trace_file);
+    if (trace_file_.fail()) {
+        std::cerr << "Trace file does not exist" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+}
+
 void TraceBasedCPU::ClockTick() {
     //先调用memory system的时钟，处理一个cycle的内容，是处理目前transaction queue里的内容
-    memory_system_.ClockTick();
+    memory_system_.HostClockTick();
     //然后看trace_file是否读取完毕，如果没有，并且要get next
     if (!trace_file_.eof()) {
         if (get_next_) {
@@ -97,4 +109,88 @@ void TraceBasedCPU::ClockTick() {
     return;
 }
 
+namespace {
+// requests in flight each way between the threads
+const size_t kPipelineRing = 4096;
+}  // namespace
+
+PipelinedCPU::PipelinedCPU(const std::string& config_file,
+                           const std::string& output_dir,
+                           const std::string& trace_file, uint64_t slack)
+    : pipeline_(config_file, output_dir, slack, kPipelineRing),
+      use_trace_(!trace_file.empty()),
+      completions_(kPipelineRing),
+      num_sent_(0),
+      num_done_(0),
+      num_reads_done_(0),
+      read_latency_sum_(0) {
+    if (use_trace_) {
+        trace_file_.open(trace_file);
+        if (trace_file_.fail()) {
+            std::cerr << "Trace file does not exist" << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+    }
+}
+
+bool PipelinedCPU::NextRequest(Transaction& trans) {
+    if (use_trace_) {
+        return static_cast<bool>(trace_file_ >> trans);
+    }
+    // same sequence as RandomCPU, as fast as the memory system takes it
+    trans.addr = gen();
+    trans.is_write = (gen() % 3 == 0);
+    trans.added_cycle = 0;
+    return true;
+}
+
+void PipelinedCPU::Drain() {
+    size_t n = pipeline_.Poll(completions_.data(), completions_.size());
+    for (size_t i = 0; i < n; i++) {
+        const Completion& done = completions_[i];
+        num_done_++;
+        if (!done.is_write) {
+            num_reads_done_++;
+            read_latency_sum_ += done.complete_cycle - done.arrival_cycle;
+        }
+    }
+}
+
+void PipelinedCPU::Run(uint64_t cycles) {
+    pipeline_.Start(cycles);
+    Transaction trans;
+    while (!pipeline_.Done() && NextRequest(trans)) {
+        bool sent;
+        while (!(sent = pipeline_.TrySend(trans.addr, trans.is_write,
+                                          num_sent_, trans.added_cycle)) &&
+               !pipeline_.Done()) {
+            Drain();
+            std::this_thread::yield();
+        }
+        if (!sent) {
+            break;
+        }
+        num_sent_++;
+        Drain();
+    }
+    pipeline_.Finish();
+    while (!pipeline_.Done()) {
+        Drain();
+        std::this_thread::yield();
+    }
+    pipeline_.Join();
+    Drain();
+}
+
+void PipelinedCPU::PrintStats() const {
+    pipeline_.PrintStats();
+    std::cout << "Host sent " << num_sent_ << " requests, " << num_done_
+              << " completed";
+    if (num_reads_done_ > 0) {
+        std::cout << ", average read latency "
+                  << read_latency_sum_ / num_reads_done_ << " cycles";
+    }
+    std::cout << std::endl;
+}
+
 }  // namespace dramsim3
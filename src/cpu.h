@@ -6,6 +6,7 @@
 #include <random>
 #include <string>
 #include "memory_system.h"
+#include "pipeline.h"
 
 namespace dramsim3 {
 
@@ -17,10 +18,29 @@ class CPU {
               std::bind(&CPU::ReadCallBack, this, std::placeholders::_1),
               std::bind(&CPU::WriteCallBack, this, std::placeholders::_1)),
           clk_(0) {}
+    explicit CPU(std::shared_ptr<const Config> config)
+        : memory_system_(
+              config,
+              std::bind(&CPU::ReadCallBack, this, std::placeholders::_1),
+              std::bind(&CPU::WriteCallBack, this, std::placeholders::_1)),
+          clk_(0) {}
     virtual void ClockTick() = 0;
     void ReadCallBack(uint64_t addr) { return; }
     void WriteCallBack(uint64_t addr) { return; }
     void PrintStats() { memory_system_.PrintStats(); }
+    uint64_t GetStatCounter(const std::string& name) const {
+        return memory_system_.GetStatCounter(name);
+    }
+    std::string GetJsonStatsName() const {
+        return memory_system_.GetJsonStatsName();
+    }
+    void SetFunctionalMode(bool functional) {
+        memory_system_.SetFunctionalMode(functional);
+    }
+    // ticks and trace timestamps are CPU cycles at host_mhz from now on
+    void SetHostFrequency(double host_mhz) {
+        memory_system_.SetHostFrequency(host_mhz);
+    }
     virtual ~CPU(){std::cout << "delete CPU from base" << std::endl;}
 
    protected:
@@ -61,6 +81,8 @@ class TraceBasedCPU : public CPU {
    public:
     TraceBasedCPU(const std::string& config_file, const std::string& output_dir,
                   const std::string& trace_file);
+    TraceBasedCPU(std::shared_ptr<const Config> config,
+                  const std::string& trace_file);
     ~TraceBasedCPU() { trace_file_.close(); }
     void ClockTick() override;
 
@@ -70,5 +92,31 @@ class TraceBasedCPU : public CPU {
     bool get_next_ = true;
 };
 
+// The trace, or the random stream of RandomCPU if there is no trace, fed to
+// a MemoryPipeline: this thread decodes or generates the requests while the
+// memory system runs on its own, with the same results as TraceBasedCPU and
+// RandomCPU
+class PipelinedCPU {
+   public:
+    PipelinedCPU(const std::string& config_file, const std::string& output_dir,
+                 const std::string& trace_file, uint64_t slack);
+    void Run(uint64_t cycles);
+    void PrintStats() const;
+
+   private:
+    bool NextRequest(Transaction& trans);
+    void Drain();
+
+    MemoryPipeline pipeline_;
+    std::ifstream trace_file_;
+    bool use_trace_;
+    std::mt19937_64 gen;
+    std::vector<Completion> completions_;
+    uint64_t num_sent_;
+    uint64_t num_done_;
+    uint64_t num_reads_done_;
+    uint64_t read_latency_sum_;
+};
+
 }  // namespace dramsim3
 #endif
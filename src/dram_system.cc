@@ -1,21 +1,24 @@
 #include "dram_system.h"
 
 #include <assert.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
 
 namespace dramsim3 {
 
-// alternative way is to assign the id in constructor but this is less
-// destructive
-int BaseDRAMSystem::total_channels_ = 0;
-
-BaseDRAMSystem::BaseDRAMSystem(Config &config, const std::string &output_dir,
+BaseDRAMSystem::BaseDRAMSystem(const Config &config,
+                               const OutputNames &outputs,
                                std::function<void(uint64_t)> read_callback,
                                std::function<void(uint64_t)> write_callback)
     : read_callback_(read_callback),
       write_callback_(write_callback),
+      functional_mode_(false),
       last_req_clk_(0),
       config_(config),
-      timing_(config_),
+      outputs_(outputs),
+      timing_(config_.GetTiming()),
       //MZOU
       concurrent_serve(0),
       active_cycles(0),
@@ -27,32 +30,130 @@ BaseDRAMSystem::BaseDRAMSystem(Config &config, const std::string &output_dir,
       last_write_hits(0),
       //MZOU
 #ifdef THERMAL
-      thermal_calc_(config_),
+      thermal_calc_(config_, outputs_),
 #endif  // THERMAL
-      clk_(0) {
-    total_channels_ += config_.channels;
-    file = fopen("./dramsim3_output", "w");
+      clk_(0),
+      next_split_(1) {
+    file = fopen((outputs_.output_prefix + "_output").c_str(), "w");
 
 #ifdef ADDR_TRACE
-    std::string addr_trace_name = config_.output_prefix + "addr.trace";
+    std::string addr_trace_name = outputs_.output_prefix + "addr.trace";
     address_trace_.open(addr_trace_name);
 #endif
 }
 
+BaseDRAMSystem::~BaseDRAMSystem() {
+    if (file) {
+        fclose(file);
+    }
+}
+
 int BaseDRAMSystem::GetChannel(uint64_t hex_addr) const {
-    hex_addr >>= config_.shift_bits;
-    return (hex_addr >> config_.ch_pos) & config_.ch_mask;
+    return config_.GetChannel(hex_addr);
+}
+
+AddResult BaseDRAMSystem::Rejected(bool is_write) const {
+    return is_write && !config_.unified_queue ? AddResult::WRITE_BUFFER_FULL
+                                              : AddResult::READ_QUEUE_FULL;
+}
+
+void BaseDRAMSystem::TryAddTransactions(const Request *requests, size_t count,
+                                        AddResult *results) {
+    for (size_t i = 0; i < count; i++) {
+        results[i] =
+            TryAddTransaction(requests[i].addr, requests[i].is_write,
+                              requests[i].req_id, BurstsOf(requests[i].size));
+    }
+}
+
+int BaseDRAMSystem::BurstsOf(uint32_t size) const {
+    uint64_t bursts = (static_cast<uint64_t>(size) +
+                       config_.request_size_bytes - 1) /
+                      config_.request_size_bytes;
+    return std::max(static_cast<int>(bursts), 1);
+}
+
+int BaseDRAMSystem::QueueOccupancy(int channel, bool is_write) const {
+    return ctrls_[channel]->TransQueueOccupancy(is_write);
+}
+
+int BaseDRAMSystem::QueueCapacity(int channel, bool is_write) const {
+    return ctrls_[channel]->TransQueueCapacity(is_write);
+}
+
+// a hit if every burst is
+void BaseDRAMSystem::FunctionalAccess(uint64_t hex_addr, bool is_write,
+                                      uint64_t req_id, int bursts) {
+    bool row_hit = true;
+    for (int k = 0; k < bursts && !ctrls_.empty(); k++) {
+        uint64_t burst_addr =
+            hex_addr + static_cast<uint64_t>(k) * config_.request_size_bytes;
+        row_hit = ctrls_[GetChannel(burst_addr)]->FunctionalAccess(
+                      burst_addr) && row_hit;
+    }
+    FunctionalDone(Transaction(hex_addr, is_write, req_id, bursts), row_hit);
+}
+
+void BaseDRAMSystem::FunctionalDone(Transaction trans, bool row_hit) {
+    trans.added_cycle = clk_;
+    trans.complete_cycle = clk_;
+    trans.served_by = trans.is_write ? ServedBy::WRITE_POSTED
+                                     : row_hit ? ServedBy::ROW_HIT
+                                               : ServedBy::ROW_MISS;
+    Complete(trans);
+}
+
+void BaseDRAMSystem::Complete(const Transaction &trans) {
+    if (trans.is_write) {
+        write_callback_(trans.addr);
+    } else {
+        read_callback_(trans.addr);
+    }
+    if (completion_callback_) {
+        Completion done = {trans.req_id,         trans.addr,
+                           trans.is_write,       trans.added_cycle,
+                           trans.complete_cycle, trans.served_by};
+        completion_callback_(done);
+    }
+}
+
+uint64_t BaseDRAMSystem::NewSplit(Transaction trans, int parts) {
+    uint64_t split = next_split_++;
+    trans.added_cycle = clk_;
+    trans.split = split;
+    // reads are forwarded unless a part is read, a miss unless all hit
+    trans.served_by =
+        trans.is_write ? ServedBy::WRITE_POSTED : ServedBy::WRITE_FORWARD;
+    splits_[split] = std::make_pair(parts, trans);
+    return split;
+}
+
+void BaseDRAMSystem::FinishPart(const Transaction &part) {
+    auto it = splits_.find(part.split);
+    Transaction &trans = it->second.second;
+    if (!trans.is_write &&
+        (part.served_by == ServedBy::ROW_MISS ||
+         (part.served_by == ServedBy::ROW_HIT &&
+          trans.served_by == ServedBy::WRITE_FORWARD))) {
+        trans.served_by = part.served_by;
+    }
+    it->second.first--;
+    if (it->second.first == 0) {
+        trans.complete_cycle = part.complete_cycle;
+        Complete(trans);
+        splits_.erase(it);
+    }
 }
 
 void BaseDRAMSystem::PrintEpochStats() {
     // first epoch, print bracket
     if (clk_ - config_.epoch_period == 0) {
-        std::ofstream epoch_out(config_.json_epoch_name, std::ofstream::out);
+        std::ofstream epoch_out(outputs_.json_epoch_name, std::ofstream::out);
         epoch_out << "[";
     }
     for (size_t i = 0; i < ctrls_.size(); i++) {
         ctrls_[i]->PrintEpochStats();
-        std::ofstream epoch_out(config_.json_epoch_name, std::ofstream::app);
+        std::ofstream epoch_out(outputs_.json_epoch_name, std::ofstream::app);
         epoch_out << "," << std::endl;
     }
 #ifdef THERMAL
@@ -93,14 +194,14 @@ void BaseDRAMSystem::stats_mo(uint64_t cycle)
 
 void BaseDRAMSystem::PrintStats() {
     // Finish epoch output, remove last comma and append ]
-    std::ofstream epoch_out(config_.json_epoch_name, std::ios_base::in |
+    std::ofstream epoch_out(outputs_.json_epoch_name, std::ios_base::in |
                                                          std::ios_base::out |
                                                          std::ios_base::ate);
     epoch_out.seekp(-2, std::ios_base::cur);
     epoch_out.write("]", 1);
     epoch_out.close();
 
-    std::ofstream json_out(config_.json_stats_name, std::ofstream::out);
+    std::ofstream json_out(outputs_.json_stats_name, std::ofstream::out);
     json_out << "{";
 
     // close it now so that each channel can handle it
@@ -108,7 +209,7 @@ void BaseDRAMSystem::PrintStats() {
     for (size_t i = 0; i < ctrls_.size(); i++) {
         ctrls_[i]->PrintFinalStats();
         if (i != ctrls_.size() - 1) {
-            std::ofstream chan_out(config_.json_stats_name, std::ofstream::app);
+            std::ofstream chan_out(outputs_.json_stats_name, std::ofstream::app);
             chan_out << "," << std::endl;
         }
     }
@@ -129,14 +230,75 @@ void BaseDRAMSystem::PrintStats() {
     fprintf(file, "Row buffer hit rate: %f\n", (float)(read_row_hit + write_row_hit) / (read_cmds + write_cmds));
     fprintf(file, "Bank level parallelism: %f\n", (float)(concurrent_serve) / active_cycles);
 */
-    json_out.open(config_.json_stats_name, std::ofstream::app);
+    json_out.open(outputs_.json_stats_name, std::ofstream::app);
     json_out << "}";
 
+#ifdef SELF_PROFILE
+    // wall-clock breakdown of the controller hot paths, rdtsc ticks on x86
+    PhaseProfiler all_channels;
+    for (size_t i = 0; i < ctrls_.size(); i++) {
+        const auto &profiler = ctrls_[i]->GetProfiler();
+        profiler.Print(std::cout, "channel " + std::to_string(i));
+        all_channels.Merge(profiler);
+    }
+    all_channels.Print(std::cout, "all channels");
+#endif  // SELF_PROFILE
+
 #ifdef THERMAL
     thermal_calc_.PrintFinalPT(clk_);
 #endif  // THERMAL
 }
 
+void BaseDRAMSystem::SaveState(CheckpointWriter &ckpt) const {
+    Save(ckpt, clk_);
+    Save(ckpt, last_req_clk_);
+    Save(ckpt, concurrent_serve);
+    Save(ckpt, active_cycles);
+    Save(ckpt, last_concurrent_serve);
+    Save(ckpt, last_active_cycles);
+    Save(ckpt, last_read_cmds);
+    Save(ckpt, last_write_cmds);
+    Save(ckpt, last_read_hits);
+    Save(ckpt, last_write_hits);
+    for (auto ctrl : ctrls_) {
+        ctrl->SaveState(ckpt);
+    }
+    Save(ckpt, splits_);
+    Save(ckpt, next_split_);
+}
+
+void BaseDRAMSystem::LoadState(CheckpointReader &ckpt) {
+    Load(ckpt, clk_);
+    Load(ckpt, last_req_clk_);
+    Load(ckpt, concurrent_serve);
+    Load(ckpt, active_cycles);
+    Load(ckpt, last_concurrent_serve);
+    Load(ckpt, last_active_cycles);
+    Load(ckpt, last_read_cmds);
+    Load(ckpt, last_write_cmds);
+    Load(ckpt, last_read_hits);
+    Load(ckpt, last_write_hits);
+    for (auto ctrl : ctrls_) {
+        ctrl->LoadState(ckpt);
+    }
+    Load(ckpt, splits_);
+    Load(ckpt, next_split_);
+    // the epoch file is only opened on the first epoch, past that point it
+    // has to be started here or PrintStats can't close it properly
+    if (clk_ >= static_cast<uint64_t>(config_.epoch_period)) {
+        std::ofstream epoch_out(outputs_.json_epoch_name, std::ofstream::out);
+        epoch_out << "[";
+    }
+}
+
+uint64_t BaseDRAMSystem::GetStatCounter(const std::string &name) const {
+    uint64_t count = 0;
+    for (auto ctrl : ctrls_) {
+        count += ctrl->GetStatCounter(name);
+    }
+    return count;
+}
+
 void BaseDRAMSystem::ResetStats() {
     for (size_t i = 0; i < ctrls_.size(); i++) {
         ctrls_[i]->ResetStats();
@@ -151,10 +313,16 @@ void BaseDRAMSystem::RegisterCallbacks(
     write_callback_ = write_callback;
 }
 
-JedecDRAMSystem::JedecDRAMSystem(Config &config, const std::string &output_dir,
+void BaseDRAMSystem::RegisterCompletionCallback(
+    std::function<void(const Completion &)> completion_callback) {
+    completion_callback_ = completion_callback;
+}
+
+JedecDRAMSystem::JedecDRAMSystem(const Config &config,
+                                 const OutputNames &outputs,
                                  std::function<void(uint64_t)> read_callback,
                                  std::function<void(uint64_t)> write_callback)
-    : BaseDRAMSystem(config, output_dir, read_callback, write_callback) {
+    : BaseDRAMSystem(config, outputs, read_callback, write_callback) {
     if (config_.IsHMC()) {
         std::cerr << "Initialized a memory system with an HMC config file!"
                   << std::endl;
@@ -164,9 +332,9 @@ JedecDRAMSystem::JedecDRAMSystem(Config &config, const std::string &output_dir,
     ctrls_.reserve(config_.channels);
     for (auto i = 0; i < config_.channels; i++) {
 #ifdef THERMAL
-        ctrls_.push_back(new Controller(i, config_, timing_, thermal_calc_));
+        ctrls_.push_back(new Controller(i, config_, timing_, outputs_, thermal_calc_));
 #else
-        ctrls_.push_back(new Controller(i, config_, timing_));
+        ctrls_.push_back(new Controller(i, config_, timing_, outputs_));
 #endif  // THERMAL
     }
 }
@@ -175,7 +343,6 @@ JedecDRAMSystem::~JedecDRAMSystem() {
     for (auto it = ctrls_.begin(); it != ctrls_.end(); it++) {
         delete (*it);
     }
-    fclose(file);
 }
 
 /*void JedecDRAMSystem::stats_mo()
@@ -214,7 +381,8 @@ bool JedecDRAMSystem::WillAcceptTransaction(uint64_t hex_addr,
     return ctrls_[channel]->WillAcceptTransaction(hex_addr, is_write);
 }
 
-bool JedecDRAMSystem::AddTransaction(uint64_t hex_addr, bool is_write) {
+bool JedecDRAMSystem::AddTransaction(uint64_t hex_addr, bool is_write,
+                                     uint64_t req_id) {
 // Record trace - Record address trace for debugging or other purposes
 #ifdef ADDR_TRACE
     address_trace_ << std::hex << hex_addr << std::dec << " "
@@ -226,32 +394,150 @@ bool JedecDRAMSystem::AddTransaction(uint64_t hex_addr, bool is_write) {
 
     assert(ok);
     if (ok) {
-        Transaction trans = Transaction(hex_addr, is_write);
+        Transaction trans = Transaction(hex_addr, is_write, req_id);
         ctrls_[channel]->AddTransaction(trans);
     }
     last_req_clk_ = clk_;
     return ok;
 }
 
+// decodes the channel once and lets its controller do the capacity check
+AddResult JedecDRAMSystem::TryAddTransaction(uint64_t hex_addr, bool is_write,
+                                             uint64_t req_id, int bursts) {
+    if (bursts > 1 && SplitRuns(hex_addr, bursts) > 1) {
+        return TrySplit(hex_addr, is_write, req_id, bursts);
+    }
+    int channel = GetChannel(hex_addr);
+    AddResult result = ctrls_[channel]->TryAddTransaction(
+        Transaction(hex_addr, is_write, req_id, bursts));
+    if (IsAccepted(result)) {
+        Accepted(hex_addr, is_write);
+    }
+    return result;
+}
+
+// Channels are decoded in one loop and the requests are counting sorted by
+// channel, stable, so each controller still gets its requests in arrival
+// order and merging/forwarding work out the same as one call each. A batch
+// with a request over several channels goes one by one instead, its parts
+// have to go in with the requests around it.
+void JedecDRAMSystem::TryAddTransactions(const Request *requests,
+                                         size_t count, AddResult *results) {
+    for (size_t i = 0; i < count; i++) {
+        int bursts = BurstsOf(requests[i].size);
+        if (bursts > 1 && SplitRuns(requests[i].addr, bursts) > 1) {
+            BaseDRAMSystem::TryAddTransactions(requests, count, results);
+            return;
+        }
+    }
+
+    batch_addrs_.resize(count);
+    batch_channels_.resize(count);
+    batch_order_.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        batch_addrs_[i] = requests[i].addr;
+    }
+    config_.GetChannels(batch_addrs_.data(), count, batch_channels_.data());
+
+    batch_starts_.assign(ctrls_.size() + 1, 0);
+    for (size_t i = 0; i < count; i++) {
+        batch_starts_[batch_channels_[i] + 1]++;
+    }
+    for (size_t channel = 0; channel < ctrls_.size(); channel++) {
+        batch_starts_[channel + 1] += batch_starts_[channel];
+    }
+    for (size_t i = 0; i < count; i++) {
+        batch_order_[batch_starts_[batch_channels_[i]]++] = i;
+    }
+
+    // the fill moved every start to where the next channel begins
+    size_t begin = 0;
+    for (size_t channel = 0; channel < ctrls_.size(); channel++) {
+        auto ctrl = ctrls_[channel];
+        for (size_t k = begin; k < batch_starts_[channel]; k++) {
+            const Request &req = requests[batch_order_[k]];
+            AddResult result = ctrl->TryAddTransaction(Transaction(
+                req.addr, req.is_write, req.req_id, BurstsOf(req.size)));
+            if (IsAccepted(result)) {
+                Accepted(req.addr, req.is_write);
+            }
+            results[batch_order_[k]] = result;
+        }
+        begin = batch_starts_[channel];
+    }
+}
+
+void JedecDRAMSystem::Accepted(uint64_t hex_addr, bool is_write) {
+#ifdef ADDR_TRACE
+    address_trace_ << std::hex << hex_addr << std::dec << " "
+                   << (is_write ? "WRITE " : "READ ") << clk_ << std::endl;
+#endif
+    last_req_clk_ = clk_;
+}
+
+size_t JedecDRAMSystem::SplitRuns(uint64_t hex_addr, int bursts) {
+    split_runs_.clear();
+    for (int k = 0; k < bursts; k++) {
+        uint64_t burst_addr =
+            hex_addr + static_cast<uint64_t>(k) * config_.request_size_bytes;
+        int channel = GetChannel(burst_addr);
+        if (split_runs_.empty() || split_runs_.back().first != channel) {
+            split_runs_.push_back(std::make_pair(channel, k));
+        }
+    }
+    return split_runs_.size();
+}
+
+// The request goes in only if every controller it touches has room for all
+// of its bursts there, so it is never left half added. Each run of split_runs_
+// is one part, bursts within a part that cross a row are queued per burst by
+// the controller like any other multi burst transaction.
+AddResult JedecDRAMSystem::TrySplit(uint64_t hex_addr, bool is_write,
+                                    uint64_t req_id, int bursts) {
+    split_bursts_.assign(ctrls_.size(), 0);
+    for (size_t i = 0; i < split_runs_.size(); i++) {
+        int end = i + 1 < split_runs_.size() ? split_runs_[i + 1].second
+                                             : bursts;
+        split_bursts_[split_runs_[i].first] += end - split_runs_[i].second;
+    }
+    for (size_t channel = 0; channel < ctrls_.size(); channel++) {
+        if (split_bursts_[channel] > 0 &&
+            !ctrls_[channel]->CanTake(is_write, split_bursts_[channel])) {
+            return Rejected(is_write);
+        }
+    }
+
+    Transaction part(hex_addr, is_write, req_id, bursts);
+    part.split = NewSplit(part, split_runs_.size());
+    bool accepted = false, merged = false;
+    for (size_t i = 0; i < split_runs_.size(); i++) {
+        int end = i + 1 < split_runs_.size() ? split_runs_[i + 1].second
+                                             : bursts;
+        part.addr = hex_addr + static_cast<uint64_t>(split_runs_[i].second) *
+                                   config_.request_size_bytes;
+        part.bursts = end - split_runs_[i].second;
+        AddResult result = ctrls_[split_runs_[i].first]->AddPart(part);
+        accepted = accepted || result == AddResult::ACCEPTED;
+        merged = merged || result == AddResult::MERGED;
+    }
+    Accepted(hex_addr, is_write);
+    return accepted ? AddResult::ACCEPTED
+                    : merged ? AddResult::MERGED : AddResult::FORWARDED;
+}
+
 void JedecDRAMSystem::ClockTick() {
     //真正的时钟进行
     //依次对每一个memory controller进行操作
     for (size_t i = 0; i < ctrls_.size(); i++) {
         // look ahead and return earlier
-        while (true) {
-            //对每一个memory controller的read queue和write queue检查是否有在当前cycle（clk_）之前完成的transaction
-            //也就是某个transaction.complete_cycle <= clk_
-            //如果有，赋给pair
-            auto pair = ctrls_[i]->ReturnDoneTrans(clk_);
-            //pair.second代表is_write
-            //pair.first代表addr
-            //给回调函数write_callback或read_callback_
-            if (pair.second == 1) {
-                write_callback_(pair.first);
-            } else if (pair.second == 0) {
-		read_callback_(pair.first);
+        //对每一个memory controller的read queue和write queue检查是否有在当前cycle（clk_）之前完成的transaction
+        //也就是某个transaction.complete_cycle <= clk_，有的话交给回调函数
+        Transaction trans;
+        while (ctrls_[i]->ReturnDoneTrans(clk_, trans)) {
+            if (trans.split != 0) {
+                FinishPart(trans);
             } else {
-                break;
+                Complete(trans);
             }
         }
     }
@@ -285,11 +571,15 @@ void JedecDRAMSystem::ClockTick() {
     return;
 }
 
-IdealDRAMSystem::IdealDRAMSystem(Config &config, const std::string &output_dir,
+IdealDRAMSystem::IdealDRAMSystem(const Config &config,
+                                 const OutputNames &outputs,
                                  std::function<void(uint64_t)> read_callback,
                                  std::function<void(uint64_t)> write_callback)
-    : BaseDRAMSystem(config, output_dir, read_callback, write_callback),
-      latency_(config_.ideal_memory_latency) {}
+    : BaseDRAMSystem(config, outputs, read_callback, write_callback),
+      latency_(config_.ideal_memory_latency),
+      channel_q_(config_.channels),
+      queued_bursts_(config_.channels, 0),
+      bus_free_(config_.channels, 0) {}
 
 IdealDRAMSystem::~IdealDRAMSystem(){}
 
@@ -324,31 +614,1040 @@ IdealDRAMSystem::~IdealDRAMSystem(){}
 */
 
 
-bool IdealDRAMSystem::AddTransaction(uint64_t hex_addr, bool is_write) {
-    auto trans = Transaction(hex_addr, is_write);
-    trans.added_cycle = clk_;
-    infinite_buffer_q_.push_back(trans);
+bool IdealDRAMSystem::WillAcceptTransaction(uint64_t hex_addr,
+                                            bool is_write) const {
+    return HasRoom(GetChannel(hex_addr), 1);
+}
+
+// the queue holds ideal_queue_size bursts, a request of more than that
+// goes in once its queue is empty
+bool IdealDRAMSystem::HasRoom(int channel, int bursts) const {
+    if (config_.ideal_queue_size <= 0) {
+        return true;
+    }
+    return queued_bursts_[channel] == 0 ||
+           queued_bursts_[channel] + bursts <= config_.ideal_queue_size;
+}
+
+bool IdealDRAMSystem::AddTransaction(uint64_t hex_addr, bool is_write,
+                                     uint64_t req_id) {
+    Enqueue(Transaction(hex_addr, is_write, req_id));
     return true;
 }
 
+AddResult IdealDRAMSystem::TryAddTransaction(uint64_t hex_addr, bool is_write,
+                                             uint64_t req_id, int bursts) {
+    if (!HasRoom(GetChannel(hex_addr), bursts)) {
+        return Rejected(is_write);
+    }
+    Enqueue(Transaction(hex_addr, is_write, req_id, bursts));
+    return AddResult::ACCEPTED;
+}
+
+void IdealDRAMSystem::Enqueue(Transaction trans) {
+    int channel = GetChannel(trans.addr);
+    trans.added_cycle = clk_;
+    // no rows to miss in an ideal memory
+    trans.served_by = ServedBy::ROW_HIT;
+    trans.complete_cycle = clk_ + latency_;
+    if (config_.ideal_bandwidth_limit) {
+        // data goes out in the first free burst slots, latency stays the
+        // unloaded one after the last of them
+        uint64_t start = std::max(clk_, bus_free_[channel]);
+        bus_free_[channel] = start + config_.burst_cycle * trans.bursts;
+        trans.complete_cycle =
+            start + config_.burst_cycle * (trans.bursts - 1) + latency_;
+    }
+    queued_bursts_[channel] += trans.bursts;
+    channel_q_[channel].push_back(trans);
+}
+
+// a request bigger than the whole queue just fills it
+int IdealDRAMSystem::QueueOccupancy(int channel, bool is_write) const {
+    return std::min(queued_bursts_[channel],
+                    QueueCapacity(channel, is_write));
+}
+
+int IdealDRAMSystem::QueueCapacity(int channel, bool is_write) const {
+    if (config_.ideal_queue_size <= 0) {
+        return std::numeric_limits<int>::max();
+    }
+    return config_.ideal_queue_size;
+}
+
+void IdealDRAMSystem::SaveState(CheckpointWriter &ckpt) const {
+    BaseDRAMSystem::SaveState(ckpt);
+    Save(ckpt, channel_q_);
+    Save(ckpt, bus_free_);
+}
+
+void IdealDRAMSystem::LoadState(CheckpointReader &ckpt) {
+    BaseDRAMSystem::LoadState(ckpt);
+    Load(ckpt, channel_q_);
+    Load(ckpt, bus_free_);
+    for (size_t i = 0; i < channel_q_.size(); i++) {
+        queued_bursts_[i] = 0;
+        for (const auto &trans : channel_q_[i]) {
+            queued_bursts_[i] += trans.bursts;
+        }
+    }
+}
+
 void IdealDRAMSystem::ClockTick() {
-    for (auto trans_it = infinite_buffer_q_.begin();
-         trans_it != infinite_buffer_q_.end();) {
-        if (clk_ - trans_it->added_cycle >= static_cast<uint64_t>(latency_)) {
-            if (trans_it->is_write) {
-                write_callback_(trans_it->addr);
-            } else {
-                read_callback_(trans_it->addr);
+    for (size_t i = 0; i < channel_q_.size(); i++) {
+        auto &queue = channel_q_[i];
+        while (!queue.empty() && queue.front().complete_cycle <= clk_) {
+            Transaction trans = queue.front();
+            queue.pop_front();
+            queued_bursts_[i] -= trans.bursts;
+            trans.complete_cycle = clk_;
+            Complete(trans);
+        }
+    }
+
+    clk_++;
+    return;
+}
+
+AnalyticalDRAMSystem::AnalyticalDRAMSystem(
+    const Config &config, const OutputNames &outputs,
+    std::function<void(uint64_t)> read_callback,
+    std::function<void(uint64_t)> write_callback)
+    : BaseDRAMSystem(config, outputs, read_callback, write_callback),
+      event_seq_(0),
+      close_page_(config_.row_buf_policy == "CLOSE_PAGE"),
+      replaying_(false),
+      reorder_hit_prob_(1.0),
+      latency_offset_(0.0),
+      latency_scale_(1.0),
+      shadow_(nullptr),
+      calibrating_(false),
+      shadow_outstanding_(0),
+      calib_cmds_(0),
+      calib_hits_(0),
+      calib_reorders_(0) {
+    if (config_.IsHMC()) {
+        std::cerr << "The analytical backend does not model HMC" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    SetTurnaround(1.0);
+    ResetModel();
+    AnalyticalStats stats = {0, 0, 0, 0, 0, 0, 0, 0};
+    stats_.resize(config_.channels, stats);
+
+    if (config_.analytical_calibration > 0) {
+        shadow_outputs_.reset(new OutputNames(config_, "_calib"));
+        shadow_ = new JedecDRAMSystem(config_, *shadow_outputs_,
+                                      [](uint64_t) {}, [](uint64_t) {});
+        shadow_->RegisterCompletionCallback(
+            std::bind(&AnalyticalDRAMSystem::ShadowDone, this,
+                      std::placeholders::_1));
+        calibrating_ = true;
+    }
+}
+
+AnalyticalDRAMSystem::~AnalyticalDRAMSystem() { delete shadow_; }
+
+// Idle banks and buses, as at cycle 0
+void AnalyticalDRAMSystem::ResetModel() {
+    // same refresh schedule as Refresh, each bank is blocked for
+    // ref_duration_ every ref_period_ starting at its ref_offset
+    uint64_t interval;
+    switch (config_.refresh_policy) {
+        case RefreshPolicy::RANK_LEVEL_SIMULTANEOUS:
+            interval = config_.tREFI;
+            ref_period_ = interval;
+            ref_duration_ = config_.tRFC;
+            break;
+        case RefreshPolicy::BANK_LEVEL_STAGGERED:
+            interval = config_.tREFIb;
+            ref_period_ = interval * config_.ranks * config_.banks;
+            ref_duration_ = config_.tRFCb;
+            break;
+        default:
+            interval = config_.tREFI / config_.ranks;
+            ref_period_ = interval * config_.ranks;
+            ref_duration_ = config_.tRFC;
+            break;
+    }
+
+    AnalyticalBank bank;
+    bank.open_row = -1;
+    bank.next_col = 0;
+    bank.next_act = 0;
+    bank.next_pre = 0;
+    bank.last_act = 0;
+    bank.ref_offset = 0;
+    bank.refreshes = 0;
+    bank.slots.assign(config_.cmd_queue_size, 0);
+    bank.slot_head = 0;
+    bank.recent_rows.assign(config_.cmd_queue_size, std::make_pair(-1, 0));
+    bank.recent_head = 0;
+    banks_.assign(config_.channels * config_.ranks * config_.banks, bank);
+    for (int ch = 0; ch < config_.channels; ch++) {
+        for (int r = 0; r < config_.ranks; r++) {
+            for (int bg = 0; bg < config_.bankgroups; bg++) {
+                for (int ba = 0; ba < config_.banks_per_group; ba++) {
+                    // position in the order Refresh walks the banks
+                    uint64_t order = r;
+                    if (config_.refresh_policy ==
+                        RefreshPolicy::RANK_LEVEL_SIMULTANEOUS) {
+                        order = 0;
+                    } else if (config_.refresh_policy ==
+                               RefreshPolicy::BANK_LEVEL_STAGGERED) {
+                        order = (r * config_.banks_per_group + ba) *
+                                    config_.bankgroups +
+                                bg;
+                    }
+                    BankOf(Address(ch, r, bg, ba, -1, -1)).ref_offset =
+                        (order + 1) * interval;
+                }
+            }
+        }
+    }
+
+    AnalyticalChannel channel;
+    channel.bus_free = 0;
+    channel.bus_slots.assign(kBusWindow, kBusFree);
+    channel.act_slots.assign(config_.ranks * kBusWindow, 0);
+    channels_.assign(config_.channels, channel);
+    reorder_credit_ = 0.0;
+}
+
+// scale of the spec bus turnaround gaps, a write to read gap is tWTR_L from
+// the end of the write data to the read command plus RL to its data
+void AnalyticalDRAMSystem::SetTurnaround(double scale) {
+    turnaround_scale_ = scale;
+    write_to_read_ =
+        static_cast<int>(std::round(scale * (config_.tWTR_L + config_.RL)));
+    read_to_write_ = static_cast<int>(std::round(scale * config_.tRTRS));
+}
+
+AnalyticalBank &AnalyticalDRAMSystem::BankOf(const Address &addr) {
+    int idx = ((addr.channel * config_.ranks + addr.rank) * config_.bankgroups +
+               addr.bankgroup) *
+                  config_.banks_per_group +
+              addr.bank;
+    return banks_[idx];
+}
+
+// Pushes cycle past the refresh window it falls in, a refresh also leaves
+// the bank precharged
+uint64_t AnalyticalDRAMSystem::AfterRefresh(AnalyticalBank &bank,
+                                            uint64_t cycle) {
+    if (cycle < bank.ref_offset) {
+        return cycle;
+    }
+    uint64_t window = (cycle - bank.ref_offset) / ref_period_;
+    if (window + 1 > bank.refreshes) {
+        bank.refreshes = window + 1;
+        bank.open_row = -1;
+    }
+    return std::max(cycle, bank.ref_offset + window * ref_period_ +
+                               ref_duration_);
+}
+
+// First ACT slot of the rank at or after earliest that keeps tRRD_S/tRRD_L
+// to the ACTs around it and no more than four of them in any tFAW
+uint64_t AnalyticalDRAMSystem::BookAct(AnalyticalChannel &channel, int rank,
+                                       int bankgroup, uint64_t earliest) {
+    const uint64_t mask = kBusWindow - 1;
+    uint8_t *slots = &channel.act_slots[rank * kBusWindow];
+    const int reach = std::max(config_.tFAW, config_.tRRD_L);
+    const uint64_t horizon = clk_ + kBusWindow - kBusHistory - reach;
+    uint64_t act = earliest;
+    auto &acts = acts_;
+    bool moved = true;
+    while (moved && act < horizon) {
+        moved = false;
+        acts.clear();
+        for (int d = -reach + 1; d < reach; d++) {
+            uint8_t slot = slots[(act + d) & mask];
+            if (slot == 0) {
+                continue;
+            }
+            int rrd = slot - 1 == bankgroup ? config_.tRRD_L : config_.tRRD_S;
+            if (d > -rrd && d < rrd) {
+                act += d + rrd;
+                moved = true;
+                break;
+            }
+            acts.push_back(act + d);
+        }
+        if (moved) {
+            continue;
+        }
+        // no five ACTs in a row closer than tFAW, acts is sorted
+        size_t pos = std::lower_bound(acts.begin(), acts.end(), act) -
+                     acts.begin();
+        acts.insert(acts.begin() + pos, act);
+        for (size_t i = pos >= 4 ? pos - 4 : 0; i <= pos && i + 4 < acts.size();
+             i++) {
+            if (acts[i + 4] - acts[i] < static_cast<uint64_t>(config_.tFAW)) {
+                act = i < pos ? acts[i] + config_.tFAW : act + 1;
+                moved = true;
+                break;
             }
-            trans_it = infinite_buffer_q_.erase(trans_it++);
         }
-        if (trans_it != infinite_buffer_q_.end()) {
-            ++trans_it;
+    }
+    slots[act & mask] = bankgroup + 1;
+    return act;
+}
+
+// First slot on the data bus at or after earliest that is free for a burst
+// and far enough from bursts of the other direction. Unlike a single next
+// free cycle this lets a request to an idle bank go ahead of one that waits
+// on a row conflict, as the scheduler would
+uint64_t AnalyticalDRAMSystem::BookBus(AnalyticalChannel &channel,
+                                       uint64_t earliest, bool is_write) {
+    const uint64_t mask = kBusWindow - 1;
+    const uint8_t own = is_write ? kBusWrite : kBusRead;
+    const int before = is_write ? read_to_write_ : write_to_read_;
+    const int after = is_write ? write_to_read_ : read_to_write_;
+    const int end = config_.burst_cycle + after;
+    // past the ring every slot aliases one that is in use, give up looking
+    const uint64_t horizon = clk_ + kBusWindow - kBusHistory - end;
+    uint64_t data = earliest;
+    int i = -before;
+    while (i < end && data < horizon) {
+        uint8_t slot = channel.bus_slots[(data + i) & mask];
+        if (slot != kBusFree && slot != own) {
+            data += i + before + 1;
+            i = -before;
+        } else if (slot == own && i >= 0 && i < config_.burst_cycle) {
+            data += i + 1;
+            i = -before;
+        } else {
+            i++;
+        }
+    }
+    for (i = 0; i < config_.burst_cycle; i++) {
+        channel.bus_slots[(data + i) & mask] = own;
+    }
+    return data;
+}
+
+// Books the bank and the data bus for one request and returns the cycle its
+// data is done, enter is set to when it leaves the transaction queue
+uint64_t AnalyticalDRAMSystem::Serve(const Address &addr, bool is_write,
+                                     uint64_t &enter, bool &row_hit) {
+    auto &channel = channels_[addr.channel];
+    auto &bank = BankOf(addr);
+    enter = std::max(clk_ + 1, bank.slots[bank.slot_head]);
+    uint64_t start = AfterRefresh(bank, std::max(enter, bank.next_col));
+
+    bool hit = bank.open_row == addr.row;
+    bool reordered = false;
+    if (!hit && bank.open_row != -1) {
+        for (const auto &recent : bank.recent_rows) {
+            if (recent.first == addr.row && recent.second > clk_) {
+                reorder_credit_ += reorder_hit_prob_;
+                if (reorder_credit_ >= 1.0) {
+                    reorder_credit_ -= 1.0;
+                    hit = true;
+                    reordered = true;
+                }
+                break;
+            }
+        }
+    }
+
+    uint64_t col = start;
+    if (!hit) {
+        uint64_t act = std::max(start, bank.next_act);
+        if (bank.open_row != -1) {
+            uint64_t pre = std::max(
+                act, std::max(bank.next_pre,
+                              bank.last_act +
+                                  static_cast<uint64_t>(config_.tRAS)));
+            act = std::max(pre + config_.tRP, bank.next_act);
+        }
+        act = AfterRefresh(bank, act);
+        act = BookAct(channel, addr.rank, addr.bankgroup, act);
+        bank.last_act = act;
+        bank.next_act = act + config_.tRC;
+        col = act + config_.tRCD;
+    }
+
+    int latency = is_write ? config_.WL : config_.RL;
+    uint64_t data = BookBus(channel, col + latency, is_write);
+    col = data - latency;
+    uint64_t done = data + config_.burst_cycle;
+    channel.bus_free = std::max(channel.bus_free, done);
+    row_hit = hit;
+
+    bank.next_col = col + config_.tCCD_L;
+    bank.next_pre = is_write ? done + config_.tWR : col + config_.tRTP;
+    if (close_page_) {
+        bank.open_row = -1;
+        bank.next_act = std::max(bank.next_act, bank.next_pre + config_.tRP);
+    } else {
+        bank.open_row = addr.row;
+    }
+    bank.slots[bank.slot_head] = col;
+    bank.slot_head = (bank.slot_head + 1) % bank.slots.size();
+    bank.recent_rows[bank.recent_head] = std::make_pair(addr.row, col);
+    bank.recent_head = (bank.recent_head + 1) % bank.recent_rows.size();
+
+    if (replaying_) {
+        return done;
+    }
+    auto &stats = stats_[addr.channel];
+    if (is_write) {
+        stats.num_write_cmds++;
+        stats.num_write_row_hits += hit;
+    } else {
+        stats.num_read_cmds++;
+        stats.num_read_row_hits += hit;
+    }
+    if (calibrating_) {
+        calib_cmds_++;
+        calib_hits_ += hit;
+        calib_reorders_ += reordered;
+    }
+    return done;
+}
+
+// The controller drains the write buffer in one go, row hits first
+void AnalyticalDRAMSystem::ServeWrites(AnalyticalChannel &channel) {
+    auto &writes = writes_;
+    auto &misses = write_misses_;
+    writes.clear();
+    misses.clear();
+    for (auto hex_addr : channel.write_batch) {
+        Address addr = config_.AddressMapping(hex_addr);
+        if (BankOf(addr).open_row == addr.row) {
+            writes.push_back(addr);
+        } else {
+            misses.push_back(addr);
+        }
+    }
+    writes.insert(writes.end(), misses.begin(), misses.end());
+    for (const auto &addr : writes) {
+        uint64_t enter;
+        bool row_hit;
+        Serve(addr, true, enter, row_hit);
+        channel.write_q.push_back(enter);
+        std::push_heap(channel.write_q.begin(), channel.write_q.end(),
+                       std::greater<uint64_t>());
+    }
+    channel.write_batch.clear();
+    channel.batched_addrs.clear();
+}
+
+// Times one request, returns when its data is done or, for writes, when
+// the write is posted, and how it was served
+uint64_t AnalyticalDRAMSystem::ModelAdd(uint64_t hex_addr, bool is_write,
+                                        ServedBy &served_by) {
+    Address addr = config_.AddressMapping(hex_addr);
+    auto &channel = channels_[addr.channel];
+    if (is_write && !config_.unified_queue) {
+        channel.write_batch.push_back(hex_addr);
+        channel.batched_addrs[hex_addr]++;
+        // drained once full, the controller's write buffer has
+        // trans_queue_size slots just like its read queue
+        if (channel.write_batch.size() >=
+            static_cast<size_t>(config_.trans_queue_size)) {
+            ServeWrites(channel);
+        }
+        served_by = ServedBy::WRITE_POSTED;
+        return clk_ + 1;
+    }
+    if (!is_write && channel.batched_addrs.count(hex_addr) > 0) {
+        if (!replaying_) {
+            stats_[addr.channel].num_write_forwards++;
+        }
+        served_by = ServedBy::WRITE_FORWARD;
+        return clk_ + 1;
+    }
+    uint64_t enter;
+    bool row_hit;
+    uint64_t done = Serve(addr, is_write, enter, row_hit);
+    served_by = is_write ? ServedBy::WRITE_POSTED
+                         : row_hit ? ServedBy::ROW_HIT : ServedBy::ROW_MISS;
+    channel.read_q.push_back(enter);
+    std::push_heap(channel.read_q.begin(), channel.read_q.end(),
+                   std::greater<uint64_t>());
+    return is_write ? clk_ + 1 : done;
+}
+
+// Times each burst of a request like a request of its own, the request is
+// done with its last burst and served as the worst of them
+uint64_t AnalyticalDRAMSystem::ModelBursts(const Transaction &trans,
+                                           ServedBy &served_by) {
+    uint64_t done = ModelAdd(trans.addr, trans.is_write, served_by);
+    for (int k = 1; k < trans.bursts; k++) {
+        ServedBy burst_served_by;
+        uint64_t burst_done = ModelAdd(
+            trans.addr + static_cast<uint64_t>(k) * config_.request_size_bytes,
+            trans.is_write, burst_served_by);
+        done = std::max(done, burst_done);
+        if (burst_served_by == ServedBy::ROW_MISS ||
+            (burst_served_by == ServedBy::ROW_HIT &&
+             served_by == ServedBy::WRITE_FORWARD)) {
+            served_by = burst_served_by;
+        }
+    }
+    return done;
+}
+
+void AnalyticalDRAMSystem::ModelTick() {
+    for (auto &channel : channels_) {
+        while (!channel.read_q.empty() && channel.read_q.front() <= clk_) {
+            std::pop_heap(channel.read_q.begin(), channel.read_q.end(),
+                          std::greater<uint64_t>());
+            channel.read_q.pop_back();
+        }
+        while (!channel.write_q.empty() && channel.write_q.front() <= clk_) {
+            std::pop_heap(channel.write_q.begin(), channel.write_q.end(),
+                          std::greater<uint64_t>());
+            channel.write_q.pop_back();
+        }
+        // slots are only looked at a turnaround or a tFAW back from the
+        // present, older ones are free for cycles kBusWindow ahead
+        if (clk_ >= kBusHistory) {
+            uint64_t old = (clk_ - kBusHistory) & (kBusWindow - 1);
+            channel.bus_slots[old] = kBusFree;
+            for (int r = 0; r < config_.ranks; r++) {
+                channel.act_slots[r * kBusWindow + old] = 0;
+            }
+        }
+        // the controller also drains a partly full buffer when idle
+        if (channel.write_batch.size() > 8 && channel.read_q.empty() &&
+            channel.bus_free <= clk_) {
+            ServeWrites(channel);
+        }
+    }
+}
+
+void AnalyticalDRAMSystem::Schedule(uint64_t cycle,
+                                    const Transaction &trans) {
+    AnalyticalEvent event = {cycle,           event_seq_++, trans.added_cycle,
+                             trans.addr,      trans.is_write, trans.req_id,
+                             trans.served_by, trans.bursts};
+    events_.push_back(event);
+    std::push_heap(events_.begin(), events_.end(),
+                   std::greater<AnalyticalEvent>());
+}
+
+void AnalyticalDRAMSystem::ReadDone(const Transaction &trans) {
+    auto &stats = stats_[GetChannel(trans.addr)];
+    // in bursts like the controller, latency weighted the same
+    stats.num_reads_done += trans.bursts;
+    stats.read_latency_sum += trans.bursts * (clk_ - trans.added_cycle);
+    Complete(trans);
+}
+
+void AnalyticalDRAMSystem::WriteDone(const Transaction &trans) {
+    stats_[GetChannel(trans.addr)].num_writes_done += trans.bursts;
+    Complete(trans);
+}
+
+// opens (or with close page closes again) the rows the model times the
+// next requests against, as the controller does with its banks
+void AnalyticalDRAMSystem::FunctionalAccess(uint64_t hex_addr, bool is_write,
+                                            uint64_t req_id, int bursts) {
+    bool row_hit = true;
+    for (int k = 0; k < bursts; k++) {
+        Address addr = config_.AddressMapping(
+            hex_addr + static_cast<uint64_t>(k) * config_.request_size_bytes);
+        AnalyticalBank &bank = BankOf(addr);
+        row_hit = bank.open_row == addr.row && row_hit;
+        bank.open_row = close_page_ ? -1 : addr.row;
+    }
+    FunctionalDone(Transaction(hex_addr, is_write, req_id, bursts), row_hit);
+}
+
+bool AnalyticalDRAMSystem::WillAcceptTransaction(uint64_t hex_addr,
+                                                 bool is_write) const {
+    if (calibrating_) {
+        return shadow_->WillAcceptTransaction(hex_addr, is_write);
+    }
+    const auto &channel = channels_[GetChannel(hex_addr)];
+    if (config_.unified_queue || !is_write) {
+        return channel.read_q.size() <
+               static_cast<size_t>(config_.trans_queue_size);
+    } else {
+        return channel.write_batch.size() + channel.write_q.size() <
+               static_cast<size_t>(config_.trans_queue_size);
+    }
+}
+
+int AnalyticalDRAMSystem::QueueOccupancy(int channel, bool is_write) const {
+    if (calibrating_) {
+        return shadow_->QueueOccupancy(channel, is_write);
+    }
+    // a request of more bursts than there are slots can overfill them
+    size_t occupancy = config_.unified_queue || !is_write
+                           ? channels_[channel].read_q.size()
+                           : channels_[channel].write_batch.size() +
+                                 channels_[channel].write_q.size();
+    return std::min(static_cast<int>(occupancy),
+                    QueueCapacity(channel, is_write));
+}
+
+int AnalyticalDRAMSystem::QueueCapacity(int channel, bool is_write) const {
+    if (calibrating_) {
+        return shadow_->QueueCapacity(channel, is_write);
+    }
+    // read queue and write buffer alike, as in the controller
+    return config_.trans_queue_size;
+}
+
+bool AnalyticalDRAMSystem::AddTransaction(uint64_t hex_addr, bool is_write,
+                                          uint64_t req_id) {
+    if (calibrating_) {
+        shadow_->AddTransaction(hex_addr, is_write, calib_trace_.size());
+    }
+    Add(Transaction(hex_addr, is_write, req_id));
+    return true;
+}
+
+AddResult AnalyticalDRAMSystem::TryAddTransaction(uint64_t hex_addr,
+                                                  bool is_write,
+                                                  uint64_t req_id,
+                                                  int bursts) {
+    if (calibrating_) {
+        AddResult result = shadow_->TryAddTransaction(
+            hex_addr, is_write, calib_trace_.size(), bursts);
+        if (!IsAccepted(result)) {
+            return result;
+        }
+    } else if (!HasRoom(hex_addr, is_write, bursts)) {
+        return Rejected(is_write);
+    }
+    Add(Transaction(hex_addr, is_write, req_id, bursts));
+    return AddResult::ACCEPTED;
+}
+
+// Each channel a request has bursts in needs a free slot for each of them,
+// or one free slot if they are more than the channel has, as for the
+// controller
+bool AnalyticalDRAMSystem::HasRoom(uint64_t hex_addr, bool is_write,
+                                   int bursts) {
+    if (bursts == 1) {
+        return WillAcceptTransaction(hex_addr, is_write);
+    }
+    room_bursts_.assign(channels_.size(), 0);
+    for (int k = 0; k < bursts; k++) {
+        room_bursts_[GetChannel(
+            hex_addr + static_cast<uint64_t>(k) * config_.request_size_bytes)]++;
+    }
+    for (size_t channel = 0; channel < channels_.size(); channel++) {
+        int needed = room_bursts_[channel];
+        int capacity = QueueCapacity(channel, is_write);
+        if (needed > 0 && QueueOccupancy(channel, is_write) +
+                                  (needed > capacity ? 1 : needed) >
+                              capacity) {
+            return false;
         }
     }
+    return true;
+}
 
+// Times trans and schedules its completion, during calibration the shadow
+// system already has it
+void AnalyticalDRAMSystem::Add(Transaction trans) {
+#ifdef ADDR_TRACE
+    address_trace_ << std::hex << trans.addr << std::dec << " "
+                   << (trans.is_write ? "WRITE " : "READ ") << clk_
+                   << std::endl;
+#endif
+    last_req_clk_ = clk_;
+    trans.added_cycle = clk_;
+    // the model is timed the same either way, during calibration the shadow
+    // system serves the request and is what the model gets fitted to
+    if (calibrating_) {
+        shadow_outstanding_++;
+        ModelBursts(trans, trans.served_by);
+        if (!trans.is_write) {
+            shadow_pending_[calib_trace_.size()] = calib_latency_.size();
+            calib_latency_.push_back(-1.0);
+            if (calib_latency_.size() >=
+                static_cast<size_t>(config_.analytical_calibration)) {
+                calibrating_ = false;
+            }
+        }
+        calib_trace_.push_back(trans);
+        return;
+    }
+
+    uint64_t done = ModelBursts(trans, trans.served_by);
+    if (trans.is_write) {
+        // posted, same as the controller
+        Schedule(done, trans);
+    } else {
+        double latency = latency_offset_ + latency_scale_ * (done - clk_);
+        latency = std::max(1.0, std::round(latency));
+        Schedule(clk_ + static_cast<uint64_t>(latency), trans);
+    }
+}
+
+void AnalyticalDRAMSystem::ClockTick() {
+    if (shadow_ != nullptr) {
+        shadow_->ClockTick();
+        if (!calibrating_ && shadow_outstanding_ == 0) {
+            FinishCalibration();
+        }
+    }
+
+    while (!events_.empty() && events_.front().cycle <= clk_) {
+        std::pop_heap(events_.begin(), events_.end(),
+                      std::greater<AnalyticalEvent>());
+        AnalyticalEvent event = events_.back();
+        events_.pop_back();
+        Transaction trans(event.hex_addr, event.is_write, event.req_id,
+                          event.bursts);
+        trans.added_cycle = event.added_cycle;
+        trans.complete_cycle = clk_;
+        trans.served_by = event.served_by;
+        if (event.is_write) {
+            WriteDone(trans);
+        } else {
+            ReadDone(trans);
+        }
+    }
+    ModelTick();
     clk_++;
-    return;
+}
+
+// the shadow serves calibration requests under their calib_trace_ index,
+// the host gets them back with its own ids and how the shadow served them
+void AnalyticalDRAMSystem::ShadowDone(const Completion &done) {
+    Transaction trans = calib_trace_[done.req_id];
+    trans.complete_cycle = clk_;
+    trans.served_by = done.served_by;
+    shadow_outstanding_--;
+    if (trans.is_write) {
+        WriteDone(trans);
+        return;
+    }
+    auto it = shadow_pending_.find(done.req_id);
+    calib_latency_[it->second] =
+        static_cast<double>(clk_ - trans.added_cycle);
+    shadow_pending_.erase(it);
+    ReadDone(trans);
+}
+
+// Runs the calibration requests through a fresh model with the current
+// parameters, at the cycles they were added, and returns the modeled latency
+// of each read. The live model is left as it was
+std::vector<double> AnalyticalDRAMSystem::Replay() {
+    std::vector<AnalyticalBank> live_banks;
+    std::vector<AnalyticalChannel> live_channels;
+    live_banks.swap(banks_);
+    live_channels.swap(channels_);
+    uint64_t live_clk = clk_;
+    double live_credit = reorder_credit_;
+
+    replaying_ = true;
+    ResetModel();
+    clk_ = 0;
+    std::vector<double> latencies;
+    latencies.reserve(calib_latency_.size());
+    for (const auto &trans : calib_trace_) {
+        while (clk_ < trans.added_cycle) {
+            ModelTick();
+            clk_++;
+        }
+        ServedBy served_by;
+        uint64_t done = ModelBursts(trans, served_by);
+        if (!trans.is_write) {
+            latencies.push_back(static_cast<double>(done - clk_));
+        }
+    }
+    replaying_ = false;
+
+    banks_.swap(live_banks);
+    channels_.swap(live_channels);
+    clk_ = live_clk;
+    reorder_credit_ = live_credit;
+    return latencies;
+}
+
+namespace {
+const int kTurnaroundSteps = 7;
+// the scheduler can lose more than the spec gaps around a turnaround
+const double kMaxTurnaroundScale = 2.0;
+}  // namespace
+
+// Fits the model to what the shadow system measured. The share of
+// reorderable misses that become hits follows from the row hit rates (all of
+// them counted as hits while calibrating), the turnaround scale is the one
+// whose replay comes closest to the measured mean read latency and what is
+// left is taken out by a least squares fit of measured on modeled latency
+void AnalyticalDRAMSystem::FinishCalibration() {
+    uint64_t cmds = shadow_->GetStatCounter("num_read_cmds") +
+                    shadow_->GetStatCounter("num_write_cmds");
+    uint64_t hits = shadow_->GetStatCounter("num_read_row_hits") +
+                    shadow_->GetStatCounter("num_write_row_hits");
+    if (cmds > 0 && calib_reorders_ > 0) {
+        double target = static_cast<double>(hits) / cmds * calib_cmds_;
+        double plain_hits = static_cast<double>(calib_hits_ - calib_reorders_);
+        reorder_hit_prob_ = (target - plain_hits) / calib_reorders_;
+        reorder_hit_prob_ = std::min(1.0, std::max(0.0, reorder_hit_prob_));
+    }
+
+    double measured = 0.0;
+    for (auto latency : calib_latency_) {
+        measured += latency;
+    }
+    measured /= calib_latency_.size();
+    // modeled latency only grows with the turnaround scale, bisect for the
+    // one that matches
+    auto modeled_mean = [this](std::vector<double> &modeled) {
+        modeled = Replay();
+        double mean = 0.0;
+        for (auto latency : modeled) {
+            mean += latency;
+        }
+        return mean / modeled.size();
+    };
+    std::vector<double> best_modeled;
+    double lo = 0.0, hi = kMaxTurnaroundScale;
+    SetTurnaround(hi);
+    if (modeled_mean(best_modeled) > measured) {
+        SetTurnaround(lo);
+        if (modeled_mean(best_modeled) < measured) {
+            for (int i = 0; i < kTurnaroundSteps; i++) {
+                std::vector<double> modeled;
+                SetTurnaround((lo + hi) / 2);
+                if (modeled_mean(modeled) < measured) {
+                    lo = turnaround_scale_;
+                } else {
+                    hi = turnaround_scale_;
+                }
+            }
+            SetTurnaround((lo + hi) / 2);
+            modeled_mean(best_modeled);
+        }
+    }
+
+    double mean_x = 0.0;
+    for (auto latency : best_modeled) {
+        mean_x += latency;
+    }
+    mean_x /= best_modeled.size();
+    double cov = 0.0, var = 0.0;
+    for (size_t i = 0; i < best_modeled.size(); i++) {
+        double dx = best_modeled[i] - mean_x;
+        cov += dx * (calib_latency_[i] - measured);
+        var += dx * dx;
+    }
+    latency_scale_ = var > 0.0 ? cov / var : 1.0;
+    if (latency_scale_ < 0.1 || latency_scale_ > 10.0) {
+        latency_scale_ = 1.0;
+    }
+    latency_offset_ = measured - latency_scale_ * mean_x;
+
+    delete shadow_;
+    shadow_ = nullptr;
+    shadow_outputs_.reset();
+    calib_trace_.clear();
+    calib_latency_.clear();
+    shadow_pending_.clear();
+}
+
+void AnalyticalDRAMSystem::PrintStats() {
+    if (config_.output_level < 0) {
+        return;
+    }
+    std::ofstream json_out(outputs_.json_stats_name, std::ofstream::out);
+    json_out << "{";
+    for (size_t i = 0; i < stats_.size(); i++) {
+        const auto &stats = stats_[i];
+        uint64_t requests = stats.num_reads_done + stats.num_writes_done;
+        uint64_t cmds = stats.num_read_cmds + stats.num_write_cmds;
+        uint64_t hits = stats.num_read_row_hits + stats.num_write_row_hits;
+        double row_hit_rate =
+            cmds == 0 ? 0.0 : static_cast<double>(hits) / cmds;
+        double read_latency =
+            stats.num_reads_done == 0
+                ? 0.0
+                : static_cast<double>(stats.read_latency_sum) /
+                      stats.num_reads_done;
+        double bandwidth = clk_ == 0 ? 0.0
+                                     : static_cast<double>(requests) *
+                                           config_.request_size_bytes /
+                                           (clk_ * config_.tCK);
+        json_out << "\"" << i << "\":{";
+        json_out << "\"num_cycles\":" << clk_ << ",";
+        json_out << "\"num_reads_done\":" << stats.num_reads_done << ",";
+        json_out << "\"num_writes_done\":" << stats.num_writes_done << ",";
+        json_out << "\"num_read_cmds\":" << stats.num_read_cmds << ",";
+        json_out << "\"num_write_cmds\":" << stats.num_write_cmds << ",";
+        json_out << "\"num_read_row_hits\":" << stats.num_read_row_hits << ",";
+        json_out << "\"num_write_row_hits\":" << stats.num_write_row_hits
+                 << ",";
+        json_out << "\"num_write_forwards\":" << stats.num_write_forwards
+                 << ",";
+        json_out << "\"row_hit_rate\":" << row_hit_rate << ",";
+        json_out << "\"average_read_latency\":" << read_latency << ",";
+        json_out << "\"average_bandwidth\":" << bandwidth << ",";
+        json_out << "\"calibration_turnaround_scale\":" << turnaround_scale_
+                 << ",";
+        json_out << "\"calibration_reorder_hit_prob\":" << reorder_hit_prob_
+                 << ",";
+        json_out << "\"calibration_latency_offset\":" << latency_offset_
+                 << ",";
+        json_out << "\"calibration_latency_scale\":" << latency_scale_;
+        json_out << "}";
+        if (i != stats_.size() - 1) {
+            json_out << "," << std::endl;
+        }
+    }
+    json_out << "}";
+}
+
+void AnalyticalDRAMSystem::ResetStats() {
+    AnalyticalStats stats = {0, 0, 0, 0, 0, 0, 0, 0};
+    std::fill(stats_.begin(), stats_.end(), stats);
+}
+
+uint64_t AnalyticalDRAMSystem::GetStatCounter(const std::string &name) const {
+    if (name == "num_cycles") {
+        return clk_;
+    }
+    uint64_t count = 0;
+    for (const auto &stats : stats_) {
+        if (name == "num_reads_done") {
+            count += stats.num_reads_done;
+        } else if (name == "num_writes_done") {
+            count += stats.num_writes_done;
+        } else if (name == "num_read_cmds") {
+            count += stats.num_read_cmds;
+        } else if (name == "num_write_cmds") {
+            count += stats.num_write_cmds;
+        } else if (name == "num_read_row_hits") {
+            count += stats.num_read_row_hits;
+        } else if (name == "num_write_row_hits") {
+            count += stats.num_write_row_hits;
+        }
+    }
+    return count;
+}
+
+void AnalyticalDRAMSystem::SaveState(CheckpointWriter &ckpt) const {
+    if (shadow_ != nullptr) {
+        std::cerr << "Cannot checkpoint the analytical backend while it is "
+                     "still calibrating"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    BaseDRAMSystem::SaveState(ckpt);
+    for (const auto &bank : banks_) {
+        Save(ckpt, bank.open_row);
+        Save(ckpt, bank.next_col);
+        Save(ckpt, bank.next_act);
+        Save(ckpt, bank.next_pre);
+        Save(ckpt, bank.last_act);
+        Save(ckpt, bank.refreshes);
+        Save(ckpt, bank.slots);
+        Save(ckpt, bank.slot_head);
+        Save(ckpt, bank.recent_rows);
+        Save(ckpt, bank.recent_head);
+    }
+    for (const auto &channel : channels_) {
+        Save(ckpt, channel.bus_free);
+        Save(ckpt, channel.bus_slots);
+        Save(ckpt, channel.act_slots);
+        Save(ckpt, channel.read_q);
+        Save(ckpt, channel.write_q);
+        Save(ckpt, channel.write_batch);
+        Save(ckpt, channel.batched_addrs);
+    }
+    for (const auto &stats : stats_) {
+        Save(ckpt, stats.num_reads_done);
+        Save(ckpt, stats.num_writes_done);
+        Save(ckpt, stats.num_read_cmds);
+        Save(ckpt, stats.num_write_cmds);
+        Save(ckpt, stats.num_read_row_hits);
+        Save(ckpt, stats.num_write_row_hits);
+        Save(ckpt, stats.num_write_forwards);
+        Save(ckpt, stats.read_latency_sum);
+    }
+    Save(ckpt, static_cast<uint64_t>(events_.size()));
+    for (const auto &event : events_) {
+        Save(ckpt, event.cycle);
+        Save(ckpt, event.seq);
+        Save(ckpt, event.added_cycle);
+        Save(ckpt, event.hex_addr);
+        Save(ckpt, event.is_write);
+        Save(ckpt, event.req_id);
+        Save(ckpt, event.served_by);
+        Save(ckpt, event.bursts);
+    }
+    Save(ckpt, event_seq_);
+    Save(ckpt, turnaround_scale_);
+    Save(ckpt, reorder_hit_prob_);
+    Save(ckpt, reorder_credit_);
+    Save(ckpt, latency_offset_);
+    Save(ckpt, latency_scale_);
+}
+
+// a restored system is always past calibration, the fitted parameters come
+// with the checkpoint
+void AnalyticalDRAMSystem::LoadState(CheckpointReader &ckpt) {
+    delete shadow_;
+    shadow_ = nullptr;
+    shadow_outputs_.reset();
+    calibrating_ = false;
+    calib_trace_.clear();
+    calib_latency_.clear();
+    shadow_pending_.clear();
+    BaseDRAMSystem::LoadState(ckpt);
+    for (auto &bank : banks_) {
+        Load(ckpt, bank.open_row);
+        Load(ckpt, bank.next_col);
+        Load(ckpt, bank.next_act);
+        Load(ckpt, bank.next_pre);
+        Load(ckpt, bank.last_act);
+        Load(ckpt, bank.refreshes);
+        Load(ckpt, bank.slots);
+        Load(ckpt, bank.slot_head);
+        Load(ckpt, bank.recent_rows);
+        Load(ckpt, bank.recent_head);
+    }
+    for (auto &channel : channels_) {
+        Load(ckpt, channel.bus_free);
+        Load(ckpt, channel.bus_slots);
+        Load(ckpt, channel.act_slots);
+        Load(ckpt, channel.read_q);
+        Load(ckpt, channel.write_q);
+        Load(ckpt, channel.write_batch);
+        Load(ckpt, channel.batched_addrs);
+    }
+    for (auto &stats : stats_) {
+        Load(ckpt, stats.num_reads_done);
+        Load(ckpt, stats.num_writes_done);
+        Load(ckpt, stats.num_read_cmds);
+        Load(ckpt, stats.num_write_cmds);
+        Load(ckpt, stats.num_read_row_hits);
+        Load(ckpt, stats.num_write_row_hits);
+        Load(ckpt, stats.num_write_forwards);
+        Load(ckpt, stats.read_latency_sum);
+    }
+    uint64_t num_events;
+    Load(ckpt, num_events);
+    events_.resize(num_events);
+    for (auto &event : events_) {
+        Load(ckpt, event.cycle);
+        Load(ckpt, event.seq);
+        Load(ckpt, event.added_cycle);
+        Load(ckpt, event.hex_addr);
+        Load(ckpt, event.is_write);
+        Load(ckpt, event.req_id);
+        Load(ckpt, event.served_by);
+        Load(ckpt, event.bursts);
+    }
+    Load(ckpt, event_seq_);
+    double turnaround_scale;
+    Load(ckpt, turnaround_scale);
+    SetTurnaround(turnaround_scale);
+    Load(ckpt, reorder_hit_prob_);
+    Load(ckpt, reorder_credit_);
+    Load(ckpt, latency_offset_);
+    Load(ckpt, latency_scale_);
 }
 
 }  // namespace dramsim3
@@ -1,8 +1,12 @@
 #ifndef __DRAM_SYSTEM_H
 #define __DRAM_SYSTEM_H
 
+#include <deque>
 #include <fstream>
+#include <map>
+#include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "common.h"
@@ -18,35 +22,85 @@ namespace dramsim3 {
 
 class BaseDRAMSystem {
    public:
-    BaseDRAMSystem(Config &config, const std::string &output_dir,
+    BaseDRAMSystem(const Config &config, const OutputNames &outputs,
                    std::function<void(uint64_t)> read_callback,
                    std::function<void(uint64_t)> write_callback);
-    virtual ~BaseDRAMSystem() {}
+    virtual ~BaseDRAMSystem();
     void RegisterCallbacks(std::function<void(uint64_t)> read_callback,
                            std::function<void(uint64_t)> write_callback);
+    void RegisterCompletionCallback(
+        std::function<void(const Completion &)> completion_callback);
     void PrintEpochStats();
-    void PrintStats();
-    void ResetStats();
+    virtual void PrintStats();
+    virtual void ResetStats();
+    virtual uint64_t GetStatCounter(const std::string &name) const;
     void stats_mo(uint64_t cycle);
 
     virtual bool WillAcceptTransaction(uint64_t hex_addr,
                                        bool is_write) const = 0;
-    virtual bool AddTransaction(uint64_t hex_addr, bool is_write) = 0;
+    virtual bool AddTransaction(uint64_t hex_addr, bool is_write,
+                                uint64_t req_id) = 0;
+    // WillAcceptTransaction and AddTransaction in one for a request of
+    // bursts bursts, see BurstsOf. A request that does not fit is turned
+    // away with the full queue's AddResult, never cut short.
+    virtual AddResult TryAddTransaction(uint64_t hex_addr, bool is_write,
+                                        uint64_t req_id, int bursts) = 0;
+    // TryAddTransaction of each request, results[i] for requests[i]. The
+    // outcome is the same as adding them one by one in order.
+    virtual void TryAddTransactions(const Request *requests, size_t count,
+                                    AddResult *results);
+    // requests holding a slot of a channel's read (or unified) queue or of
+    // its write buffer, and how many slots there are, by default those of
+    // the channel's controller
+    virtual int QueueOccupancy(int channel, bool is_write) const;
+    virtual int QueueCapacity(int channel, bool is_write) const;
     virtual void ClockTick() = 0;
+    // DRAM cycles ticked so far
+    uint64_t GetClockCycle() const { return clk_; }
     int GetChannel(uint64_t hex_addr) const;
+    // bursts of a request of size bytes, at least one
+    int BurstsOf(uint32_t size) const;
+
+    // In functional mode requests complete as soon as they are added and
+    // only update the open rows, no time passes inside the memory system
+    void SetFunctionalMode(bool functional) { functional_mode_ = functional; }
+    bool IsFunctionalMode() const { return functional_mode_; }
+    virtual void FunctionalAccess(uint64_t hex_addr, bool is_write,
+                                  uint64_t req_id, int bursts);
+
+    // dynamic state for checkpoints, derived systems append their own
+    virtual void SaveState(CheckpointWriter &ckpt) const;
+    virtual void LoadState(CheckpointReader &ckpt);
 
     std::function<void(uint64_t req_id)> read_callback_, write_callback_;
-    static int total_channels_;
+    // optional, called after the address callbacks with the full record
+    std::function<void(const Completion &)> completion_callback_;
 
     //MZOU
     FILE *file;
     //MZOU
 
    protected:
+    // hands a finished request back to the host, trans.complete_cycle is
+    // when it finished
+    void Complete(const Transaction &trans);
+    // completes a functional access right away
+    void FunctionalDone(Transaction trans, bool row_hit);
+    // starts tracking trans, added as parts parts that finish separately,
+    // and returns the split id the parts carry
+    uint64_t NewSplit(Transaction trans, int parts);
+    // one part of a split request done, the request completes with its
+    // last part
+    void FinishPart(const Transaction &part);
+    // full queue result for a request that can't go in
+    AddResult Rejected(bool is_write) const;
+
+    bool functional_mode_;
     uint64_t id_;
     uint64_t last_req_clk_;
-    Config &config_;
-    Timing timing_;
+    const Config &config_;
+    const OutputNames &outputs_;
+    const Timing &timing_;
     uint64_t parallel_cycles_;
     uint64_t serial_cycles_;
     //MZOU
@@ -66,6 +120,9 @@ class BaseDRAMSystem {
 
     uint64_t clk_;
     std::vector<Controller*> ctrls_;
+    // split id -> (parts still out, the request as the host added it)
+    std::map<uint64_t, std::pair<int, Transaction>> splits_;
+    uint64_t next_split_;
 
 #ifdef ADDR_TRACE
     std::ofstream address_trace_;
@@ -75,34 +132,240 @@ class BaseDRAMSystem {
 // hmmm not sure this is the best naming...
 class JedecDRAMSystem : public BaseDRAMSystem {
    public:
-    JedecDRAMSystem(Config &config, const std::string &output_dir,
+    JedecDRAMSystem(const Config &config, const OutputNames &outputs,
                     std::function<void(uint64_t)> read_callback,
                     std::function<void(uint64_t)> write_callback);
     ~JedecDRAMSystem();
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const override;
-    bool AddTransaction(uint64_t hex_addr, bool is_write) override;
+    bool AddTransaction(uint64_t hex_addr, bool is_write,
+                        uint64_t req_id) override;
+    AddResult TryAddTransaction(uint64_t hex_addr, bool is_write,
+                                uint64_t req_id, int bursts) override;
+    void TryAddTransactions(const Request *requests, size_t count,
+                            AddResult *results) override;
     void ClockTick() override;
+
+   private:
+    // splits the bursts of a request into runs in the same channel, in
+    // split_runs_, and returns how many there are
+    size_t SplitRuns(uint64_t hex_addr, int bursts);
+    // adds a request over several channels as one part per run
+    AddResult TrySplit(uint64_t hex_addr, bool is_write, uint64_t req_id,
+                       int bursts);
+    void Accepted(uint64_t hex_addr, bool is_write);
+
+    // (channel, first burst) of each run, and bursts per channel of a split
+    // request, kept to not allocate per request
+    std::vector<std::pair<int, int>> split_runs_;
+    std::vector<int> split_bursts_;
+
+    // batch scratch space, kept to not allocate per batch
+    std::vector<uint64_t> batch_addrs_;
+    std::vector<int> batch_channels_;
+    std::vector<size_t> batch_starts_;
+    std::vector<size_t> batch_order_;
 };
 
 // Model a memorysystem with an infinite bandwidth and a fixed latency (possibly
 // zero) To establish a baseline for what a 'good' memory standard can and
-// cannot do for a given application
+// cannot do for a given application. With ideal_bandwidth_limit each channel
+// moves at most one burst every burst_cycle, i.e. perfect scheduling at pin
+// bandwidth, and ideal_queue_size bounds the bursts in flight per channel.
 class IdealDRAMSystem : public BaseDRAMSystem {
    public:
-    IdealDRAMSystem(Config &config, const std::string &output_dir,
+    IdealDRAMSystem(const Config &config, const OutputNames &outputs,
                     std::function<void(uint64_t)> read_callback,
                     std::function<void(uint64_t)> write_callback);
     ~IdealDRAMSystem();
     bool WillAcceptTransaction(uint64_t hex_addr,
-                               bool is_write) const override {
-        return true;
-    };
-    bool AddTransaction(uint64_t hex_addr, bool is_write) override;
+                               bool is_write) const override;
+    bool AddTransaction(uint64_t hex_addr, bool is_write,
+                        uint64_t req_id) override;
+    AddResult TryAddTransaction(uint64_t hex_addr, bool is_write,
+                                uint64_t req_id, int bursts) override;
+    int QueueOccupancy(int channel, bool is_write) const override;
+    int QueueCapacity(int channel, bool is_write) const override;
     void ClockTick() override;
+    void SaveState(CheckpointWriter &ckpt) const override;
+    void LoadState(CheckpointReader &ckpt) override;
 
    private:
+    bool HasRoom(int channel, int bursts) const;
+    void Enqueue(Transaction trans);
     int latency_;
-    std::vector<Transaction> infinite_buffer_q_;
+    // complete_cycle only grows along each queue, so completions just pop
+    // the fronts
+    std::vector<std::deque<Transaction>> channel_q_;
+    // bursts of the requests in each channel_q_, what ideal_queue_size
+    // limits
+    std::vector<int> queued_bursts_;
+    std::vector<uint64_t> bus_free_;
+};
+
+// cycles the analytical model keeps booked on the data bus, power of two,
+// kBusHistory of them in the past
+const int kBusWindow = 1 << 14;
+const uint64_t kBusHistory = 256;
+const uint8_t kBusFree = 0;
+const uint8_t kBusRead = 1;
+const uint8_t kBusWrite = 2;
+
+// Per bank state of the analytical model
+struct AnalyticalBank {
+    int open_row;
+    uint64_t next_col;  // earliest next column command, tCCD_L after the last
+    uint64_t next_act;  // earliest next ACT, tRC after the last one
+    uint64_t next_pre;  // earliest PRE after the last column command
+    uint64_t last_act;
+    uint64_t ref_offset;  // cycle of the first refresh of this bank
+    uint64_t refreshes;   // refresh windows already accounted for
+    // column cycles of the last cmd_queue_size requests, a request only gets
+    // into the command queue once the one that many ahead of it has issued
+    std::vector<uint64_t> slots;
+    int slot_head;
+    // (row, column cycle) of recent requests, a miss on a row that an
+    // earlier, still waiting request also goes to is what FR-FCFS reorders
+    // into a hit
+    std::vector<std::pair<int, uint64_t>> recent_rows;
+    int recent_head;
+};
+
+struct AnalyticalChannel {
+    uint64_t bus_free;  // end of the last booked burst
+    // ring of booked data bus cycles, indexed by cycle % kBusWindow
+    std::vector<uint8_t> bus_slots;
+    // same for ACTs of each rank, bankgroup + 1 of the ACT or 0
+    std::vector<uint8_t> act_slots;
+    // min-heaps of the cycles requests leave the transaction queues
+    std::vector<uint64_t> read_q;
+    std::vector<uint64_t> write_q;
+    // writes are buffered and drained in batches like the controller does
+    std::vector<uint64_t> write_batch;
+    std::unordered_map<uint64_t, int> batched_addrs;
+};
+
+struct AnalyticalStats {
+    uint64_t num_reads_done;
+    uint64_t num_writes_done;
+    uint64_t num_read_cmds;
+    uint64_t num_write_cmds;
+    uint64_t num_read_row_hits;
+    uint64_t num_write_row_hits;
+    uint64_t num_write_forwards;
+    uint64_t read_latency_sum;
+};
+
+struct AnalyticalEvent {
+    uint64_t cycle;
+    uint64_t seq;  // keeps equal cycles in issue order
+    uint64_t added_cycle;
+    uint64_t hex_addr;
+    bool is_write;
+    uint64_t req_id;
+    ServedBy served_by;
+    int bursts;
+    bool operator>(const AnalyticalEvent &other) const {
+        return cycle != other.cycle ? cycle > other.cycle : seq > other.seq;
+    }
+};
+
+// Fast analytical model of a JEDEC system. Instead of stepping every
+// controller each cycle, a request is timed once when it is added: it waits
+// for a command queue slot of its bank, for the bank (row hit, or tRP/tRCD
+// after a conflict, bounded by tRAS, tRC, tRRD and tFAW), for refresh windows
+// of tRFC every tREFI and for a slot on the data bus of its channel clear of
+// read/write turnarounds. Queueing delay follows from how far ahead banks and
+// buses are booked, and the transaction queues apply the same back pressure
+// as the controller.
+// The first analytical_calibration reads are also run through a
+// JedecDRAMSystem, which serves them, and the model is fitted to it: the
+// share of reorderable misses that FR-FCFS turns into hits, how much of the
+// turnaround gaps the scheduler really pays and a linear correction of the
+// modeled read latency.
+class AnalyticalDRAMSystem : public BaseDRAMSystem {
+   public:
+    AnalyticalDRAMSystem(const Config &config, const OutputNames &outputs,
+                         std::function<void(uint64_t)> read_callback,
+                         std::function<void(uint64_t)> write_callback);
+    ~AnalyticalDRAMSystem();
+    bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const override;
+    bool AddTransaction(uint64_t hex_addr, bool is_write,
+                        uint64_t req_id) override;
+    AddResult TryAddTransaction(uint64_t hex_addr, bool is_write,
+                                uint64_t req_id, int bursts) override;
+    void FunctionalAccess(uint64_t hex_addr, bool is_write, uint64_t req_id,
+                          int bursts) override;
+    int QueueOccupancy(int channel, bool is_write) const override;
+    int QueueCapacity(int channel, bool is_write) const override;
+    void ClockTick() override;
+    void PrintStats() override;
+    void ResetStats() override;
+    uint64_t GetStatCounter(const std::string &name) const override;
+    void SaveState(CheckpointWriter &ckpt) const override;
+    void LoadState(CheckpointReader &ckpt) override;
+
+   private:
+    void ResetModel();
+    void SetTurnaround(double scale);
+    AnalyticalBank &BankOf(const Address &addr);
+    uint64_t AfterRefresh(AnalyticalBank &bank, uint64_t cycle);
+    uint64_t BookAct(AnalyticalChannel &channel, int rank, int bankgroup,
+                     uint64_t earliest);
+    uint64_t BookBus(AnalyticalChannel &channel, uint64_t earliest,
+                     bool is_write);
+    uint64_t Serve(const Address &addr, bool is_write, uint64_t &enter,
+                   bool &row_hit);
+    void ServeWrites(AnalyticalChannel &channel);
+    uint64_t ModelAdd(uint64_t hex_addr, bool is_write, ServedBy &served_by);
+    uint64_t ModelBursts(const Transaction &trans, ServedBy &served_by);
+    bool HasRoom(uint64_t hex_addr, bool is_write, int bursts);
+    void Add(Transaction trans);
+    void ModelTick();
+    void Schedule(uint64_t cycle, const Transaction &trans);
+    void ReadDone(const Transaction &trans);
+    void WriteDone(const Transaction &trans);
+    void ShadowDone(const Completion &done);
+    std::vector<double> Replay();
+    void FinishCalibration();
+
+    std::vector<AnalyticalBank> banks_;
+    std::vector<AnalyticalChannel> channels_;
+    std::vector<AnalyticalStats> stats_;
+    std::vector<AnalyticalEvent> events_;  // min-heap of completions
+    uint64_t event_seq_;
+    uint64_t ref_period_;
+    uint64_t ref_duration_;
+    int write_to_read_;
+    int read_to_write_;
+    bool close_page_;
+    bool replaying_;
+    // scratch of BookAct and ServeWrites, kept to not allocate per request
+    std::vector<uint64_t> acts_;
+    std::vector<Address> writes_;
+    std::vector<Address> write_misses_;
+    std::vector<int> room_bursts_;
+
+    // calibrated parameters, spec timing and no correction until fitted
+    double turnaround_scale_;
+    double reorder_hit_prob_;
+    double reorder_credit_;
+    double latency_offset_;
+    double latency_scale_;
+
+    // calibration against a cycle accurate run, the shadow writes its
+    // files under a prefix of its own
+    std::unique_ptr<OutputNames> shadow_outputs_;
+    JedecDRAMSystem *shadow_;
+    bool calibrating_;
+    uint64_t shadow_outstanding_;
+    std::vector<Transaction> calib_trace_;
+    std::vector<double> calib_latency_;  // measured, per read of calib_trace_
+    // calib_trace_ index -> calib_latency_ index of the reads in flight in
+    // the shadow system, which gets calib_trace_ indices as request ids
+    std::unordered_map<uint64_t, size_t> shadow_pending_;
+    uint64_t calib_cmds_;
+    uint64_t calib_hits_;
+    uint64_t calib_reorders_;
 };
 
 }  // namespace dramsim3
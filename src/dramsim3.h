@@ -1,40 +1,160 @@
-#ifndef __MEMORY_SYSTEM__H
-#define __MEMORY_SYSTEM__H
+#ifndef __DRAMSIM3_H
+#define __DRAMSIM3_H
 
 #include <functional>
+#include <map>
+#include <memory>
 #include <string>
+#include "request_types.h"
 
 namespace dramsim3 {
 
+using ConfigOverrides = std::map<std::string, std::string>;
+
+class BaseDRAMSystem;
+class Config;
+class OutputNames;
+
 // This should be the interface class that deals with CPU
+// The one declaration of it, the library's memory_system.h includes this.
+// Its state is only held through pointers to library types, so hosts need
+// nothing but this header to build one directly or with GetMemorySystem.
+// Hosts that don't share the library's C++ ABI should use the C interface in
+// dramsim3_c.h instead.
 class MemorySystem {
    public:
     MemorySystem(const std::string &config_file, const std::string &output_dir,
                  std::function<void(uint64_t)> read_callback,
                  std::function<void(uint64_t)> write_callback);
+    // config from "section.key" -> value pairs, no ini file needed
+    MemorySystem(const ConfigOverrides &config_values,
+                 const std::string &output_dir,
+                 std::function<void(uint64_t)> read_callback,
+                 std::function<void(uint64_t)> write_callback);
+    // Shares an already built config, which is never modified, so any number
+    // of memory systems on any threads can use the same one and its tables
+    // are only computed once. Outputs go to config->output_dir, each memory
+    // system with its own prefix.
+    MemorySystem(std::shared_ptr<const Config> config,
+                 std::function<void(uint64_t)> read_callback,
+                 std::function<void(uint64_t)> write_callback);
     ~MemorySystem();
+    MemorySystem(const MemorySystem &) = delete;
+    MemorySystem &operator=(const MemorySystem &) = delete;
     void ClockTick();
+    // Host clock domain: once the host frequency is set the host ticks with
+    // HostClockTick or AdvanceToHostCycle and the DRAM clock follows at the
+    // ratio of the two frequencies, kept as a fixed point accumulator so no
+    // drift builds up. Completion records then carry host cycles. Without
+    // a host frequency (or with 0) host cycles are DRAM cycles.
+    void SetHostFrequency(double host_mhz);
+    void HostClockTick();
+    // ticks the host clock forward to host_cycle, nothing if it is there
+    void AdvanceToHostCycle(uint64_t host_cycle);
+    uint64_t GetHostCycle() const;
     void RegisterCallbacks(std::function<void(uint64_t)> read_callback,
                            std::function<void(uint64_t)> write_callback);
     double GetTCK() const;
     uint64_t GetChannelMask() const;
     uint64_t GetRankMask() const;
     uint64_t GetBankMask() const;
-    uint64_t GetRowMask() const;    
+    uint64_t GetRowMask() const;
     int GetBusBits() const;
     int GetBurstLength() const;
+    int GetBurstCycle() const;
+    int GetChannels() const;
     int GetQueueSize() const;
+    // bytes moved by one burst
+    int GetRequestSize() const;
     void PrintStats() const;
-    void ResetStats();
     void stats_mo(uint64_t cycle);
+    void ResetStats();
+    // live value of a per-channel counter stat (e.g. num_read_row_hits)
+    // summed over all channels
+    uint64_t GetStatCounter(const std::string &name) const;
+    // where PrintStats writes the json stats
+    std::string GetJsonStatsName() const;
+
+    // Dump/restore all dynamic state of the memory system so a warmed up
+    // state can be resumed many times. Restoring requires a memory system
+    // built from a compatible config (same organization, address mapping
+    // and queue sizes). Both return false if the file can't be opened,
+    // saving also if it couldn't be written completely.
+    bool SaveCheckpoint(const std::string &path) const;
+    bool RestoreCheckpoint(const std::string &path);
 
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const;
     bool AddTransaction(uint64_t hex_addr, bool is_write);
+    // same, with an id of the caller's that comes back in the Completion
+    bool AddTransaction(uint64_t hex_addr, bool is_write, uint64_t req_id);
+    // Checks capacity and adds in one call, the address is decoded once.
+    // Nothing is added unless IsAccepted(result).
+    AddResult TryAddTransaction(uint64_t hex_addr, bool is_write);
+    AddResult TryAddTransaction(uint64_t hex_addr, bool is_write,
+                                uint64_t req_id);
+    // A request of size bytes, GetRequestSize() per burst, rounded up.
+    // Burst k is at hex_addr + k * GetRequestSize() and goes to the channel
+    // (HMC: vault) and row its address maps to, the request completes once,
+    // when its last burst is done. It takes a queue slot per burst in each
+    // channel it touches. Where it has more bursts than the queue has slots
+    // it is taken once the queue has a free slot (IDEAL, which queues it
+    // all in the channel of its first burst: is empty) and the rest of its
+    // bursts follow as slots free up, the queue takes nothing else until
+    // then. A request that doesn't fit is turned away as a whole.
+    AddResult TryAddTransaction(uint64_t hex_addr, bool is_write,
+                                uint64_t req_id, uint32_t size);
+    // A batch of TryAddTransaction, results[i] is what happened to
+    // requests[i], same as adding them one by one in order. Decodes the
+    // whole batch at once and fills each channel in one go. Returns how
+    // many were accepted.
+    size_t AddTransactions(const Request *requests, size_t count,
+                           AddResult *results);
+    // Per channel back pressure: the channel an address goes to, and how
+    // many requests hold a slot of its read (or unified) queue or write
+    // buffer out of how many
+    int GetChannel(uint64_t hex_addr) const;
+    int GetQueueOccupancy(int channel, bool is_write) const;
+    int GetQueueCapacity(int channel, bool is_write) const;
+    // Completion records of every finished request, after the address
+    // callbacks. Empty to turn them off again.
+    void RegisterCompletionCallback(
+        std::function<void(const Completion &)> completion_callback);
+
+    // Functional warmup: while set, AddTransaction only updates the open
+    // rows and calls back right away, ClockTick does nothing. Queued requests
+    // stay where they are and resume once detailed mode is back on
+    void SetFunctionalMode(bool functional);
+    bool IsFunctionalMode() const;
+
+   private:
+    void Init(std::function<void(uint64_t)> read_callback,
+              std::function<void(uint64_t)> write_callback);
+    // completion_callback_ with the cycles of done in host cycles
+    void HostCompletion(const Completion &done) const;
+
+    // only pointers to library types here, so this header needs none of
+    // their definitions
+    std::shared_ptr<const Config> config_;
+    OutputNames *outputs_;
+    BaseDRAMSystem *dram_system_;
+
+    // DRAM cycles per host cycle in 32.32 fixed point, 0 without a host
+    // frequency
+    uint64_t host_ratio_;
+    uint64_t host_acc_;
+    uint64_t host_clk_;
+    std::function<void(const Completion &)> completion_callback_;
 };
 
 MemorySystem* GetMemorySystem(const std::string &config_file, const std::string &output_dir,
                  std::function<void(uint64_t)> read_callback,
                  std::function<void(uint64_t)> write_callback);
+// config from "section.key" -> value pairs, no ini file needed
+MemorySystem *GetMemorySystem(const ConfigOverrides &config_values,
+                              const std::string &output_dir,
+                              std::function<void(uint64_t)> read_callback,
+                              std::function<void(uint64_t)> write_callback);
+void DeleteMemorySystem(MemorySystem *memory_system);
 }  // namespace dramsim3
 
 #endif
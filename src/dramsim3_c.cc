@@ -0,0 +1,204 @@
+#include "dramsim3_c.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include "memory_system.h"
+
+using dramsim3::AddResult;
+using dramsim3::Completion;
+using dramsim3::MemorySystem;
+using dramsim3::Request;
+
+// Completions are queued here until polled, in a ring that only grows when
+// the host lets more pile up than ever before
+struct dramsim3_system {
+    explicit dramsim3_system(MemorySystem *memory_system)
+        : memory_system(memory_system),
+          cycles(0),
+          ring(1024),
+          head(0),
+          pending(0) {
+        memory_system->RegisterCompletionCallback(
+            [this](const Completion &done) { Push(done); });
+    }
+
+    void Push(const Completion &done) {
+        if (pending == ring.size()) {
+            std::vector<Completion> bigger(ring.size() * 2);
+            for (size_t i = 0; i < pending; i++) {
+                bigger[i] = ring[(head + i) % ring.size()];
+            }
+            ring.swap(bigger);
+            head = 0;
+        }
+        ring[(head + pending) % ring.size()] = done;
+        pending++;
+    }
+
+    std::unique_ptr<MemorySystem> memory_system;
+    uint64_t cycles;
+    std::vector<Completion> ring;
+    size_t head;
+    size_t pending;
+    // batch scratch space, grows to the largest batch seen
+    std::vector<Request> requests;
+    std::vector<AddResult> results;
+};
+
+namespace {
+void NoCallback(uint64_t) {}
+}  // namespace
+
+extern "C" {
+
+uint32_t dramsim3_abi_version(void) { return DRAMSIM3_C_ABI_VERSION; }
+
+dramsim3_system *dramsim3_create(const char *config_file,
+                                 const char *output_dir) {
+    return new dramsim3_system(
+        new MemorySystem(config_file, output_dir, NoCallback, NoCallback));
+}
+
+dramsim3_system *dramsim3_create_from_values(
+    const dramsim3_config_value *values, size_t count,
+    const char *output_dir) {
+    dramsim3::ConfigOverrides config_values;
+    for (size_t i = 0; i < count; i++) {
+        config_values[values[i].key] = values[i].value;
+    }
+    return new dramsim3_system(new MemorySystem(config_values, output_dir,
+                                                NoCallback, NoCallback));
+}
+
+void dramsim3_destroy(dramsim3_system *sys) { delete sys; }
+
+void dramsim3_tick(dramsim3_system *sys, uint64_t cycles) {
+    for (uint64_t i = 0; i < cycles; i++) {
+        sys->memory_system->ClockTick();
+    }
+    sys->cycles += cycles;
+}
+
+void dramsim3_set_host_frequency(dramsim3_system *sys, double host_mhz) {
+    sys->memory_system->SetHostFrequency(host_mhz);
+}
+
+void dramsim3_advance_to_host_cycle(dramsim3_system *sys,
+                                    uint64_t host_cycle) {
+    sys->memory_system->AdvanceToHostCycle(host_cycle);
+}
+
+int dramsim3_try_add(dramsim3_system *sys, uint64_t addr, int is_write,
+                     uint64_t req_id) {
+    return static_cast<int>(
+        sys->memory_system->TryAddTransaction(addr, is_write != 0, req_id));
+}
+
+int dramsim3_try_add_sized(dramsim3_system *sys, uint64_t addr, int is_write,
+                           uint64_t req_id, uint32_t size) {
+    return static_cast<int>(sys->memory_system->TryAddTransaction(
+        addr, is_write != 0, req_id, size));
+}
+
+size_t dramsim3_try_add_batch(dramsim3_system *sys,
+                              const dramsim3_request *requests, size_t count,
+                              int *results) {
+    if (sys->requests.size() < count) {
+        sys->requests.resize(count);
+        sys->results.resize(count);
+    }
+    for (size_t i = 0; i < count; i++) {
+        sys->requests[i] = {requests[i].addr, requests[i].is_write != 0,
+                            requests[i].req_id, requests[i].size};
+    }
+    size_t accepted = sys->memory_system->AddTransactions(
+        sys->requests.data(), count, sys->results.data());
+    for (size_t i = 0; i < count; i++) {
+        results[i] = static_cast<int>(sys->results[i]);
+    }
+    return accepted;
+}
+
+size_t dramsim3_poll_completions(dramsim3_system *sys,
+                                 dramsim3_completion *out, size_t capacity) {
+    size_t n = std::min(capacity, sys->pending);
+    for (size_t i = 0; i < n; i++) {
+        const Completion &done = sys->ring[sys->head];
+        out[i].req_id = done.req_id;
+        out[i].addr = done.addr;
+        out[i].arrival_cycle = done.arrival_cycle;
+        out[i].complete_cycle = done.complete_cycle;
+        out[i].is_write = done.is_write;
+        out[i].served_by = static_cast<uint32_t>(done.served_by);
+        sys->head = (sys->head + 1) % sys->ring.size();
+    }
+    sys->pending -= n;
+    return n;
+}
+
+int dramsim3_channels(const dramsim3_system *sys) {
+    return sys->memory_system->GetChannels();
+}
+
+int dramsim3_request_size(const dramsim3_system *sys) {
+    return sys->memory_system->GetRequestSize();
+}
+
+int dramsim3_channel_of(const dramsim3_system *sys, uint64_t addr) {
+    return sys->memory_system->GetChannel(addr);
+}
+
+int dramsim3_queue_occupancy(const dramsim3_system *sys, int channel,
+                             int is_write) {
+    return sys->memory_system->GetQueueOccupancy(channel, is_write != 0);
+}
+
+int dramsim3_queue_capacity(const dramsim3_system *sys, int channel,
+                            int is_write) {
+    return sys->memory_system->GetQueueCapacity(channel, is_write != 0);
+}
+
+double dramsim3_tck(const dramsim3_system *sys) {
+    return sys->memory_system->GetTCK();
+}
+
+void dramsim3_get_stats(const dramsim3_system *sys, dramsim3_stats *stats) {
+    // built once, so the lookups don't allocate
+    static const std::string kNames[] = {
+        "num_reads_done",    "num_writes_done",   "num_read_cmds",
+        "num_write_cmds",    "num_read_row_hits", "num_write_row_hits"};
+    const MemorySystem &memory_system = *sys->memory_system;
+    stats->cycles = sys->cycles;
+    stats->num_reads_done = memory_system.GetStatCounter(kNames[0]);
+    stats->num_writes_done = memory_system.GetStatCounter(kNames[1]);
+    stats->num_read_cmds = memory_system.GetStatCounter(kNames[2]);
+    stats->num_write_cmds = memory_system.GetStatCounter(kNames[3]);
+    stats->num_read_row_hits = memory_system.GetStatCounter(kNames[4]);
+    stats->num_write_row_hits = memory_system.GetStatCounter(kNames[5]);
+    stats->completions_pending = sys->pending;
+}
+
+void dramsim3_reset_stats(dramsim3_system *sys) {
+    sys->memory_system->ResetStats();
+    sys->cycles = 0;
+}
+
+void dramsim3_print_stats(const dramsim3_system *sys) {
+    sys->memory_system->PrintStats();
+}
+
+void dramsim3_set_functional_mode(dramsim3_system *sys, int functional) {
+    sys->memory_system->SetFunctionalMode(functional != 0);
+}
+
+int dramsim3_save_checkpoint(const dramsim3_system *sys, const char *path) {
+    return sys->memory_system->SaveCheckpoint(path);
+}
+
+int dramsim3_restore_checkpoint(dramsim3_system *sys, const char *path) {
+    return sys->memory_system->RestoreCheckpoint(path);
+}
+
+}  // extern "C"
@@ -0,0 +1,134 @@
+#ifndef __DRAMSIM3_C_H
+#define __DRAMSIM3_C_H
+
+// C interface to the simulator for hosts that can't share the C++ ABI of
+// MemorySystem (std::function, std::string) with the library. Everything
+// goes through an opaque handle and plain structs of fixed width fields.
+// This layer adds no allocation of its own to ticking, adding requests,
+// polling completions or stats snapshots, completions are copied into caller
+// owned buffers. The simulator underneath still allocates, e.g. a node per
+// request waiting in a controller.
+// A handle must only be used from one thread at a time, different handles
+// are independent.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// bumped whenever a struct or signature in here changes
+#define DRAMSIM3_C_ABI_VERSION 2
+
+typedef struct dramsim3_system dramsim3_system;
+
+// "section.key" = value, e.g. {"system.channels", "2"}
+typedef struct {
+    const char *key;
+    const char *value;
+} dramsim3_config_value;
+
+// same values as dramsim3::AddResult
+enum {
+    DRAMSIM3_ACCEPTED = 0,
+    DRAMSIM3_MERGED = 1,
+    DRAMSIM3_FORWARDED = 2,
+    DRAMSIM3_READ_QUEUE_FULL = 3,
+    DRAMSIM3_WRITE_BUFFER_FULL = 4
+};
+
+// same values as dramsim3::ServedBy
+enum {
+    DRAMSIM3_ROW_HIT = 0,
+    DRAMSIM3_ROW_MISS = 1,
+    DRAMSIM3_WRITE_FORWARD = 2,
+    DRAMSIM3_WRITE_POSTED = 3
+};
+
+typedef struct {
+    uint64_t addr;
+    uint64_t req_id;
+    uint32_t is_write;
+    uint32_t size;  // bytes, 0 for one burst
+} dramsim3_request;
+
+typedef struct {
+    uint64_t req_id;
+    uint64_t addr;
+    uint64_t arrival_cycle;
+    uint64_t complete_cycle;
+    uint32_t is_write;
+    uint32_t served_by;
+} dramsim3_completion;
+
+// totals over all channels since creation or the last reset
+typedef struct {
+    uint64_t cycles;  // ticked with dramsim3_tick
+    uint64_t num_reads_done;
+    uint64_t num_writes_done;
+    uint64_t num_read_cmds;
+    uint64_t num_write_cmds;
+    uint64_t num_read_row_hits;
+    uint64_t num_write_row_hits;
+    uint64_t completions_pending;  // done but not polled yet
+} dramsim3_stats;
+
+uint32_t dramsim3_abi_version(void);
+
+// Stats files go to output_dir. Configuration errors end the process the
+// same way they do for the C++ interface.
+dramsim3_system *dramsim3_create(const char *config_file,
+                                 const char *output_dir);
+dramsim3_system *dramsim3_create_from_values(
+    const dramsim3_config_value *values, size_t count,
+    const char *output_dir);
+void dramsim3_destroy(dramsim3_system *sys);
+
+void dramsim3_tick(dramsim3_system *sys, uint64_t cycles);
+// Host clock domain, see MemorySystem::SetHostFrequency. Completions polled
+// afterwards carry host cycles, 0 MHz goes back to DRAM cycles.
+void dramsim3_set_host_frequency(dramsim3_system *sys, double host_mhz);
+// runs the DRAM clock along until the host clock is at host_cycle
+void dramsim3_advance_to_host_cycle(dramsim3_system *sys,
+                                    uint64_t host_cycle);
+// one of the DRAMSIM3_ add results
+int dramsim3_try_add(dramsim3_system *sys, uint64_t addr, int is_write,
+                     uint64_t req_id);
+// a request of size bytes, see MemorySystem::TryAddTransaction
+int dramsim3_try_add_sized(dramsim3_system *sys, uint64_t addr, int is_write,
+                           uint64_t req_id, uint32_t size);
+// results[i] for requests[i], returns how many were accepted
+size_t dramsim3_try_add_batch(dramsim3_system *sys,
+                              const dramsim3_request *requests, size_t count,
+                              int *results);
+// moves up to capacity finished requests into out, oldest first, returns
+// how many
+size_t dramsim3_poll_completions(dramsim3_system *sys,
+                                 dramsim3_completion *out, size_t capacity);
+
+int dramsim3_channels(const dramsim3_system *sys);
+// bytes moved by one burst
+int dramsim3_request_size(const dramsim3_system *sys);
+int dramsim3_channel_of(const dramsim3_system *sys, uint64_t addr);
+int dramsim3_queue_occupancy(const dramsim3_system *sys, int channel,
+                             int is_write);
+int dramsim3_queue_capacity(const dramsim3_system *sys, int channel,
+                            int is_write);
+double dramsim3_tck(const dramsim3_system *sys);
+
+void dramsim3_get_stats(const dramsim3_system *sys, dramsim3_stats *stats);
+void dramsim3_reset_stats(dramsim3_system *sys);
+// writes the stats files, same as MemorySystem::PrintStats
+void dramsim3_print_stats(const dramsim3_system *sys);
+
+void dramsim3_set_functional_mode(dramsim3_system *sys, int functional);
+// 0 if the file can't be opened (or written)
+int dramsim3_save_checkpoint(const dramsim3_system *sys, const char *path);
+int dramsim3_restore_checkpoint(dramsim3_system *sys, const char *path);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // __DRAMSIM3_C_H
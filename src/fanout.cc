@@ -0,0 +1,167 @@
+#include "fanout.h"
+
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+namespace dramsim3 {
+
+namespace {
+// transactions per chunk and how many chunks the parser may run ahead of the
+// slowest worker, about 25MB of decoded trace at most
+const size_t kChunkSize = 1 << 14;
+const uint64_t kMaxChunksAhead = 64;
+const uint64_t kReaderLeft = std::numeric_limits<uint64_t>::max();
+
+// configs/DDR4_8Gb_x8_3200.ini -> DDR4_8Gb_x8_3200
+std::string ConfigName(const std::string& config_file) {
+    auto slash = config_file.find_last_of('/');
+    std::string name = slash == std::string::npos
+                           ? config_file
+                           : config_file.substr(slash + 1);
+    auto dot = name.find_last_of('.');
+    return dot == std::string::npos ? name : name.substr(0, dot);
+}
+}  // namespace
+
+TraceChunks::TraceChunks(int num_readers)
+    : first_(0), next_(num_readers, 0), finished_(false) {}
+
+uint64_t TraceChunks::SlowestReader() const {
+    return *std::min_element(next_.begin(), next_.end());
+}
+
+void TraceChunks::DropConsumed() {
+    uint64_t slowest = SlowestReader();
+    while (!chunks_.empty() && first_ < slowest) {
+        chunks_.pop_front();
+        first_++;
+    }
+}
+
+bool TraceChunks::Push(TraceChunk&& chunk) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] {
+        uint64_t slowest = SlowestReader();
+        return slowest == kReaderLeft ||
+               first_ + chunks_.size() < slowest + kMaxChunksAhead;
+    });
+    if (SlowestReader() == kReaderLeft) {
+        return false;
+    }
+    chunks_.push_back(std::make_shared<const TraceChunk>(std::move(chunk)));
+    cv_.notify_all();
+    return true;
+}
+
+void TraceChunks::Finish() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+    cv_.notify_all();
+}
+
+std::shared_ptr<const TraceChunk> TraceChunks::Get(int reader,
+                                                   uint64_t index) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    next_[reader] = index;
+    DropConsumed();
+    cv_.notify_all();
+    cv_.wait(lock, [this, index] {
+        return finished_ || index < first_ + chunks_.size();
+    });
+    if (index >= first_ + chunks_.size()) {
+        return nullptr;
+    }
+    return chunks_[index - first_];
+}
+
+void TraceChunks::Leave(int reader) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    next_[reader] = kReaderLeft;
+    DropConsumed();
+    cv_.notify_all();
+}
+
+TraceFanout::TraceFanout(const std::vector<std::string>& config_files,
+                         const std::string& output_dir,
+                         const std::string& trace_file)
+    : config_files_(config_files),
+      chunks_(static_cast<int>(config_files.size())) {
+    trace_.open(trace_file);
+    if (trace_.fail()) {
+        std::cerr << "Trace file does not exist" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    // stats of each config go to their own directory, named after the config
+    for (size_t i = 0; i < config_files_.size(); i++) {
+        std::string name = ConfigName(config_files_[i]);
+        std::string dir = output_dir + "/" + name;
+        for (int n = 1; std::find(output_dirs_.begin(), output_dirs_.end(),
+                                  dir) != output_dirs_.end();
+             n++) {
+            dir = output_dir + "/" + name + "_" + std::to_string(n);
+        }
+        if (!MakeDir(dir)) {
+            std::cerr << "Can't create output directory " << dir << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+        output_dirs_.push_back(dir);
+    }
+}
+
+void TraceFanout::Worker(int id, uint64_t cycles) {
+    MemorySystem memory_system(config_files_[id], output_dirs_[id],
+                               [](uint64_t) {}, [](uint64_t) {});
+    uint64_t chunk_index = 0;
+    auto chunk = chunks_.Get(id, chunk_index);
+    size_t pos = 0;
+    for (uint64_t clk = 0; clk < cycles; clk++) {
+        memory_system.ClockTick();
+        if (chunk && pos == chunk->size()) {
+            chunk = chunks_.Get(id, ++chunk_index);
+            pos = 0;
+        }
+        if (chunk) {
+            const Transaction& trans = (*chunk)[pos];
+            if (trans.added_cycle <= clk &&
+                memory_system.WillAcceptTransaction(trans.addr,
+                                                    trans.is_write)) {
+                memory_system.AddTransaction(trans.addr, trans.is_write);
+                pos++;
+            }
+        }
+    }
+    chunks_.Leave(id);
+    memory_system.PrintStats();
+}
+
+void TraceFanout::Run(uint64_t cycles) {
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < config_files_.size(); i++) {
+        workers.emplace_back(&TraceFanout::Worker, this, static_cast<int>(i),
+                             cycles);
+    }
+
+    TraceChunk chunk;
+    chunk.reserve(kChunkSize);
+    Transaction trans;
+    bool wanted = true;
+    while (wanted && trace_ >> trans) {
+        chunk.push_back(trans);
+        if (chunk.size() == kChunkSize) {
+            wanted = chunks_.Push(std::move(chunk));
+            chunk = TraceChunk();
+            chunk.reserve(kChunkSize);
+        }
+    }
+    if (wanted && !chunk.empty()) {
+        chunks_.Push(std::move(chunk));
+    }
+    chunks_.Finish();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+}  // namespace dramsim3
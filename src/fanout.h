@@ -0,0 +1,65 @@
+#ifndef __FANOUT_H
+#define __FANOUT_H
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "memory_system.h"
+
+namespace dramsim3 {
+
+using TraceChunk = std::vector<Transaction>;
+
+// Decoded trace shared read-only between the readers. The producer stays at
+// most a fixed number of chunks ahead of the slowest reader and chunks are
+// dropped once every reader has moved past them, so memory is bounded no
+// matter how long the trace is.
+class TraceChunks {
+   public:
+    explicit TraceChunks(int num_readers);
+    // false once every reader has left, nothing more needs to be decoded
+    bool Push(TraceChunk&& chunk);
+    void Finish();
+    // chunk number index for reader, nullptr past the end of the trace
+    std::shared_ptr<const TraceChunk> Get(int reader, uint64_t index);
+    // reader is done and no longer holds the producer back
+    void Leave(int reader);
+
+   private:
+    uint64_t SlowestReader() const;
+    void DropConsumed();
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::shared_ptr<const TraceChunk>> chunks_;
+    uint64_t first_;  // chunk number of chunks_.front()
+    std::vector<uint64_t> next_;  // next chunk number of each reader
+    bool finished_;
+};
+
+// Simulates one trace on several configs at once. The trace is parsed once
+// on the calling thread and every config gets its own MemorySystem on its
+// own worker thread, fed the same way TraceBasedCPU does, i.e. never ahead
+// of the trace time and only when WillAcceptTransaction says so. Each config
+// writes its stats to output_dir/<config name>/.
+class TraceFanout {
+   public:
+    TraceFanout(const std::vector<std::string>& config_files,
+                const std::string& output_dir, const std::string& trace_file);
+    void Run(uint64_t cycles);
+
+   private:
+    void Worker(int id, uint64_t cycles);
+
+    std::vector<std::string> config_files_;
+    std::vector<std::string> output_dirs_;
+    std::ifstream trace_;
+    TraceChunks chunks_;
+};
+
+}  // namespace dramsim3
+#endif
@@ -3,7 +3,12 @@
 namespace dramsim3 {
 
 HMCRequest::HMCRequest(HMCReqType req_type, uint64_t hex_addr, int vault)
-    : type(req_type), mem_operand(hex_addr), vault(vault) {
+    : type(req_type),
+      mem_operand(hex_addr),
+      vault(vault),
+      req_id(hex_addr),
+      slot(0),
+      split(0) {
     is_write = type >= HMCReqType::WR0 && type <= HMCReqType::P_WR256;
     // given that vaults could be 16 (Gen1) or 32(Gen2), using % 4
     // to partition vaults to quads
@@ -111,7 +116,13 @@ HMCRequest::HMCRequest(HMCReqType req_type, uint64_t hex_addr, int vault)
 
 HMCResponse::HMCResponse(uint64_t id, HMCReqType req_type, int dest_link,
                          int src_quad)
-    : resp_id(id), link(dest_link), quad(src_quad) {
+    : resp_id(id),
+      req_id(id),
+      added_cycle(0),
+      served_by(ServedBy::ROW_MISS),
+      split(0),
+      link(dest_link),
+      quad(src_quad) {
     switch (req_type) {
         case HMCReqType::RD0:
             type = HMCRespType::RD_RS;
@@ -240,10 +251,11 @@ HMCResponse::HMCResponse(uint64_t id, HMCReqType req_type, int dest_link,
     return;
 }
 
-HMCMemorySystem::HMCMemorySystem(Config &config, const std::string &output_dir,
+HMCMemorySystem::HMCMemorySystem(const Config &config,
+                                 const OutputNames &outputs,
                                  std::function<void(uint64_t)> read_callback,
                                  std::function<void(uint64_t)> write_callback)
-    : BaseDRAMSystem(config, output_dir, read_callback, write_callback),
+    : BaseDRAMSystem(config, outputs, read_callback, write_callback),
       logic_clk_(0),
       logic_ps_(0),
       dram_ps_(0),
@@ -261,9 +273,9 @@ HMCMemorySystem::HMCMemorySystem(Config &config, const std::string &output_dir,
     ctrls_.reserve(config_.channels);
     for (int i = 0; i < config_.channels; i++) {
 #ifdef THERMAL
-        ctrls_.push_back(new Controller(i, config_, timing_, thermal_calc_));
+        ctrls_.push_back(new Controller(i, config_, timing_, outputs_, thermal_calc_));
 #else
-        ctrls_.push_back(new Controller(i, config_, timing_));
+        ctrls_.push_back(new Controller(i, config_, timing_, outputs_));
 #endif  // THERMAL
     }
     // initialize vaults and crossbar
@@ -276,17 +288,18 @@ HMCMemorySystem::HMCMemorySystem(Config &config, const std::string &output_dir,
     link_req_queues_.reserve(links_);
     link_resp_queues_.reserve(links_);
     for (int i = 0; i < links_; i++) {
-        link_req_queues_.push_back(std::vector<HMCRequest *>());
-        link_resp_queues_.push_back(std::vector<HMCResponse *>());
+        link_req_queues_.push_back(RingQueue<HMCRequest *>(queue_depth_));
+        link_resp_queues_.push_back(RingQueue<HMCResponse *>(queue_depth_));
     }
 
     // don't want to hard coding it but there are 4 quads so it's kind of fixed
     quad_req_queues_.reserve(4);
     quad_resp_queues_.reserve(4);
     for (int i = 0; i < 4; i++) {
-        quad_req_queues_.push_back(std::vector<HMCRequest *>());
-        quad_resp_queues_.push_back(std::vector<HMCResponse *>());
+        quad_req_queues_.push_back(RingQueue<HMCRequest *>(queue_depth_));
+        quad_resp_queues_.push_back(RingQueue<HMCResponse *>(queue_depth_));
     }
+    age_queue_.reserve(std::max(links_, 4));
 
     link_busy_.reserve(links_);
     link_age_counter_.reserve(links_);
@@ -302,6 +315,166 @@ HMCMemorySystem::~HMCMemorySystem() {
     }
 }
 
+namespace {
+// requests and responses in flight are in the xbar queues (and the slot
+// table for responses still waiting on the vaults), every pointer lives in
+// exactly one of them so they are saved by value and taken from the pools
+// again on load
+void SaveHMCRequest(CheckpointWriter &ckpt, const HMCRequest *req) {
+    Save(ckpt, req->type);
+    Save(ckpt, req->mem_operand);
+    Save(ckpt, req->link);
+    Save(ckpt, req->quad);
+    Save(ckpt, req->vault);
+    Save(ckpt, req->flits);
+    Save(ckpt, req->is_write);
+    Save(ckpt, req->req_id);
+    Save(ckpt, req->slot);
+    Save(ckpt, req->split);
+    Save(ckpt, req->exit_time);
+}
+
+HMCRequest LoadHMCRequest(CheckpointReader &ckpt) {
+    HMCReqType type;
+    uint64_t mem_operand;
+    Load(ckpt, type);
+    Load(ckpt, mem_operand);
+    HMCRequest req(type, mem_operand, 0);
+    Load(ckpt, req.link);
+    Load(ckpt, req.quad);
+    Load(ckpt, req.vault);
+    Load(ckpt, req.flits);
+    Load(ckpt, req.is_write);
+    Load(ckpt, req.req_id);
+    Load(ckpt, req.slot);
+    Load(ckpt, req.split);
+    Load(ckpt, req.exit_time);
+    return req;
+}
+
+void SaveHMCResponse(CheckpointWriter &ckpt, const HMCResponse *resp) {
+    Save(ckpt, resp->resp_id);
+    Save(ckpt, resp->type);
+    Save(ckpt, resp->req_id);
+    Save(ckpt, resp->added_cycle);
+    Save(ckpt, resp->served_by);
+    Save(ckpt, resp->split);
+    Save(ckpt, resp->link);
+    Save(ckpt, resp->quad);
+    Save(ckpt, resp->flits);
+    Save(ckpt, resp->exit_time);
+}
+
+HMCResponse LoadHMCResponse(CheckpointReader &ckpt) {
+    uint64_t resp_id;
+    Load(ckpt, resp_id);
+    HMCResponse resp(resp_id, HMCReqType::RD0, 0, 0);
+    Load(ckpt, resp.type);
+    Load(ckpt, resp.req_id);
+    Load(ckpt, resp.added_cycle);
+    Load(ckpt, resp.served_by);
+    Load(ckpt, resp.split);
+    Load(ckpt, resp.link);
+    Load(ckpt, resp.quad);
+    Load(ckpt, resp.flits);
+    Load(ckpt, resp.exit_time);
+    return resp;
+}
+
+template <typename T>
+void SaveQueues(CheckpointWriter &ckpt,
+                const std::vector<RingQueue<T *>> &queues,
+                void (*save)(CheckpointWriter &, const T *)) {
+    for (const auto &queue : queues) {
+        Save(ckpt, static_cast<uint64_t>(queue.size()));
+        for (size_t i = 0; i < queue.size(); i++) {
+            save(ckpt, queue[i]);
+        }
+    }
+}
+
+template <typename T>
+void LoadQueues(CheckpointReader &ckpt, std::vector<RingQueue<T *>> &queues,
+                ObjectPool<T> &pool, T (*load)(CheckpointReader &)) {
+    for (auto &queue : queues) {
+        while (!queue.empty()) {
+            pool.Delete(queue.front());
+            queue.pop_front();
+        }
+        uint64_t size;
+        Load(ckpt, size);
+        for (uint64_t i = 0; i < size; i++) {
+            queue.push_back(pool.New(load(ckpt)));
+        }
+    }
+}
+}  // namespace
+
+void HMCMemorySystem::SaveState(CheckpointWriter &ckpt) const {
+    BaseDRAMSystem::SaveState(ckpt);
+    Save(ckpt, logic_clk_);
+    Save(ckpt, logic_ps_);
+    Save(ckpt, dram_ps_);
+    Save(ckpt, next_link_);
+    Save(ckpt, static_cast<uint64_t>(resp_slots_.size()));
+    for (const auto resp : resp_slots_) {
+        Save(ckpt, resp != nullptr);
+        if (resp) {
+            SaveHMCResponse(ckpt, resp);
+        }
+    }
+    Save(ckpt, free_slots_);
+    SaveQueues(ckpt, link_req_queues_, SaveHMCRequest);
+    SaveQueues(ckpt, quad_req_queues_, SaveHMCRequest);
+    SaveQueues(ckpt, link_resp_queues_, SaveHMCResponse);
+    SaveQueues(ckpt, quad_resp_queues_, SaveHMCResponse);
+    Save(ckpt, link_busy_);
+    Save(ckpt, quad_busy_);
+    Save(ckpt, link_age_counter_);
+    Save(ckpt, quad_age_counter_);
+    Save(ckpt, static_cast<uint64_t>(staged_reqs_.size()));
+    for (const auto &req : staged_reqs_) {
+        SaveHMCRequest(ckpt, &req);
+    }
+}
+
+void HMCMemorySystem::LoadState(CheckpointReader &ckpt) {
+    BaseDRAMSystem::LoadState(ckpt);
+    Load(ckpt, logic_clk_);
+    Load(ckpt, logic_ps_);
+    Load(ckpt, dram_ps_);
+    Load(ckpt, next_link_);
+    for (auto resp : resp_slots_) {
+        if (resp) {
+            resp_pool_.Delete(resp);
+        }
+    }
+    uint64_t size;
+    Load(ckpt, size);
+    resp_slots_.assign(size, nullptr);
+    for (uint64_t i = 0; i < size; i++) {
+        bool used;
+        Load(ckpt, used);
+        if (used) {
+            resp_slots_[i] = resp_pool_.New(LoadHMCResponse(ckpt));
+        }
+    }
+    Load(ckpt, free_slots_);
+    LoadQueues(ckpt, link_req_queues_, req_pool_, LoadHMCRequest);
+    LoadQueues(ckpt, quad_req_queues_, req_pool_, LoadHMCRequest);
+    LoadQueues(ckpt, link_resp_queues_, resp_pool_, LoadHMCResponse);
+    LoadQueues(ckpt, quad_resp_queues_, resp_pool_, LoadHMCResponse);
+    Load(ckpt, link_busy_);
+    Load(ckpt, quad_busy_);
+    Load(ckpt, link_age_counter_);
+    Load(ckpt, quad_age_counter_);
+    Load(ckpt, size);
+    staged_reqs_.clear();
+    for (uint64_t i = 0; i < size; i++) {
+        staged_reqs_.push_back(LoadHMCRequest(ckpt));
+    }
+}
+
 void HMCMemorySystem::SetClockRatio() {
     // There are 3 clock domains here, Link (super fast), logic (fast), DRAM
     // (slow) We assume the logic process 1 flit per logic cycle and since the
@@ -329,6 +502,10 @@ inline void HMCMemorySystem::IterateNextLink() {
 
 bool HMCMemorySystem::WillAcceptTransaction(uint64_t hex_addr,
                                             bool is_write) const {
+    // staged packets go first
+    if (!staged_reqs_.empty()) {
+        return false;
+    }
     bool insertable = false;
     for (auto link_queue = link_req_queues_.begin();
          link_queue != link_req_queues_.end(); link_queue++) {
@@ -340,58 +517,79 @@ bool HMCMemorySystem::WillAcceptTransaction(uint64_t hex_addr,
     return insertable;
 }
 
-bool HMCMemorySystem::AddTransaction(uint64_t hex_addr, bool is_write) {
+bool HMCMemorySystem::AddTransaction(uint64_t hex_addr, bool is_write,
+                                     uint64_t req_id) {
     // to be compatible with other protocol we have this interface
     // when using this intreface the size of each transaction will be block_size
-    HMCReqType req_type;
-    if (is_write) {
-        switch (config_.block_size) {
-            case 0:
-                req_type = HMCReqType::WR0;
-                break;
-            case 32:
-                req_type = HMCReqType::WR32;
-                break;
-            case 64:
-                req_type = HMCReqType::WR64;
-                break;
-            case 128:
-                req_type = HMCReqType::WR128;
-                break;
-            case 256:
-                req_type = HMCReqType::WR256;
-                break;
-            default:
-                req_type = HMCReqType::SIZE;
-                AbruptExit(__FILE__, __LINE__);
-                break;
+    int vault = GetChannel(hex_addr);
+    HMCRequest req(BlockReqType(is_write), hex_addr, vault);
+    req.req_id = req_id;
+    return InsertHMCReq(&req);
+}
+
+AddResult HMCMemorySystem::TryAddTransaction(uint64_t hex_addr, bool is_write,
+                                             uint64_t req_id, int bursts) {
+    if (bursts == 1) {
+        if (!WillAcceptTransaction(hex_addr, is_write)) {
+            return Rejected(is_write);
         }
-    } else {
-        switch (config_.block_size) {
-            case 0:
-                req_type = HMCReqType::RD0;
-                break;
-            case 32:
-                req_type = HMCReqType::RD32;
-                break;
-            case 64:
-                req_type = HMCReqType::RD64;
-                break;
-            case 128:
-                req_type = HMCReqType::RD128;
-                break;
-            case 256:
-                req_type = HMCReqType::RD256;
-                break;
-            default:
-                req_type = HMCReqType::SIZE;
-                AbruptExit(__FILE__, __LINE__);
-                break;
+        AddTransaction(hex_addr, is_write, req_id);
+        return AddResult::ACCEPTED;
+    }
+    size_t packets = bursts;
+    size_t free_slots = FreeLinkSlots();
+    if (!staged_reqs_.empty() ||
+        free_slots < std::min(packets, links_ * queue_depth_)) {
+        return Rejected(is_write);
+    }
+    // block_size is request_size_bytes here, so a burst is a packet
+    uint64_t split = NewSplit(Transaction(hex_addr, is_write, req_id, bursts),
+                              bursts);
+    for (int k = 0; k < bursts; k++) {
+        uint64_t addr =
+            hex_addr + static_cast<uint64_t>(k) * config_.block_size;
+        HMCRequest req(BlockReqType(is_write), addr, GetChannel(addr));
+        req.req_id = req_id;
+        req.split = split;
+        staged_reqs_.push_back(req);
+    }
+    FeedRequests();
+    return AddResult::ACCEPTED;
+}
+
+// packet type of a request of block_size bytes
+HMCReqType HMCMemorySystem::BlockReqType(bool is_write) const {
+    switch (config_.block_size) {
+        case 0:
+            return is_write ? HMCReqType::WR0 : HMCReqType::RD0;
+        case 32:
+            return is_write ? HMCReqType::WR32 : HMCReqType::RD32;
+        case 64:
+            return is_write ? HMCReqType::WR64 : HMCReqType::RD64;
+        case 128:
+            return is_write ? HMCReqType::WR128 : HMCReqType::RD128;
+        case 256:
+            return is_write ? HMCReqType::WR256 : HMCReqType::RD256;
+        default:
+            AbruptExit(__FILE__, __LINE__);
+            return HMCReqType::SIZE;
+    }
+}
+
+size_t HMCMemorySystem::FreeLinkSlots() const {
+    size_t free_slots = 0;
+    for (const auto &link_queue : link_req_queues_) {
+        if (link_queue.size() < queue_depth_) {
+            free_slots += queue_depth_ - link_queue.size();
         }
     }
-    int vault = GetChannel(hex_addr);
-    HMCRequest *req = new HMCRequest(req_type, hex_addr, vault);
-    return InsertHMCReq(req);
+    return free_slots;
+}
+
+void HMCMemorySystem::FeedRequests() {
+    while (!staged_reqs_.empty() && InsertHMCReq(&staged_reqs_.front())) {
+        staged_reqs_.pop_front();
+    }
 }
 
 bool HMCMemorySystem::InsertReqToLink(HMCRequest *req, int link) {
@@ -401,12 +599,22 @@ bool HMCMemorySystem::InsertReqToLink(HMCRequest *req, int link) {
     // 3. create corresponding response
     // 4. increment link_age_counter_ so that arbitrate logic works
     if (link_req_queues_[link].size() < queue_depth_) {
-        req->link = link;
-        link_req_queues_[link].push_back(req);
-        HMCResponse *resp =
-            new HMCResponse(req->mem_operand, req->type, link, req->quad);
-        resp_lookup_table_.insert(
-            std::pair<uint64_t, HMCResponse *>(resp->resp_id, resp));
+        HMCRequest *pooled = req_pool_.New(*req);
+        pooled->link = link;
+        link_req_queues_[link].push_back(pooled);
+        HMCResponse *resp = resp_pool_.New(
+            HMCResponse(req->mem_operand, req->type, link, req->quad));
+        resp->req_id = req->req_id;
+        resp->split = req->split;
+        resp->added_cycle = clk_;
+        if (free_slots_.empty()) {
+            pooled->slot = resp_slots_.size();
+            resp_slots_.push_back(resp);
+        } else {
+            pooled->slot = free_slots_.back();
+            free_slots_.pop_back();
+            resp_slots_[pooled->slot] = resp;
+        }
         link_age_counter_[link] = 1;
         // stats_.interarrival_latency.AddValue(clk_ - last_req_clk_);
         last_req_clk_ = clk_;
@@ -451,8 +659,8 @@ void HMCMemorySystem::DrainRequests() {
                 if (ctrls_[req->vault]->WillAcceptTransaction(req->mem_operand,
                                                               req->is_write)) {
                     InsertReqToDRAM(req);
-                    delete (req);
-                    quad_req_queues_[i].erase(quad_req_queues_[i].begin());
+                    req_pool_.Delete(req);
+                    quad_req_queues_[i].pop_front();
                 }
             }
         }
@@ -466,15 +674,13 @@ void HMCMemorySystem::DrainRequests() {
     }
 
     // drain requests from link to quad buffers
-    std::vector<int> age_queue = BuildAgeQueue(link_age_counter_);
-    while (!age_queue.empty()) {
-        int src_link = age_queue.front();
+    BuildAgeQueue(link_age_counter_);
+    for (int src_link : age_queue_) {
         int dest_quad = link_req_queues_[src_link].front()->quad;
         if (quad_req_queues_[dest_quad].size() < queue_depth_ &&
             quad_busy_[dest_quad] <= 0) {
             HMCRequest *req = link_req_queues_[src_link].front();
-            link_req_queues_[src_link].erase(
-                link_req_queues_[src_link].begin());
+            link_req_queues_[src_link].pop_front();
             quad_req_queues_[dest_quad].push_back(req);
             quad_busy_[dest_quad] = req->flits;
             req->exit_time = logic_clk_ + req->flits;
@@ -486,9 +692,7 @@ void HMCMemorySystem::DrainRequests() {
         } else {  // stalled this cycle, update age counter
             link_age_counter_[src_link]++;
         }
-        age_queue.erase(age_queue.begin());
     }
-    age_queue.clear();
 }
 
 void HMCMemorySystem::DrainResponses() {
@@ -497,13 +701,20 @@ void HMCMemorySystem::DrainResponses() {
         if (!link_resp_queues_[i].empty()) {
             HMCResponse *resp = link_resp_queues_[i].front();
             if (resp->exit_time <= logic_clk_) {
-                if (resp->type == HMCRespType::RD_RS) {
-                    read_callback_(resp->resp_id);
+                Transaction trans(resp->resp_id,
+                                  resp->type != HMCRespType::RD_RS,
+                                  resp->req_id);
+                trans.added_cycle = resp->added_cycle;
+                trans.complete_cycle = clk_;
+                trans.served_by = resp->served_by;
+                trans.split = resp->split;
+                if (trans.split != 0) {
+                    FinishPart(trans);
                 } else {
-                    write_callback_(resp->resp_id);
+                    Complete(trans);
                 }
-                delete (resp);
-                link_resp_queues_[i].erase(link_resp_queues_[i].begin());
+                resp_pool_.Delete(resp);
+                link_resp_queues_[i].pop_front();
             }
         }
     }
@@ -516,15 +727,13 @@ void HMCMemorySystem::DrainResponses() {
     }
 
     // drain responses from quad to link buffers
-    auto age_queue = BuildAgeQueue(quad_age_counter_);
-    while (!age_queue.empty()) {
-        int src_quad = age_queue.front();
+    BuildAgeQueue(quad_age_counter_);
+    for (int src_quad : age_queue_) {
         int dest_link = quad_resp_queues_[src_quad].front()->link;
         if (link_resp_queues_[dest_link].size() < queue_depth_ &&
             link_busy_[dest_link] <= 0) {
             HMCResponse *resp = quad_resp_queues_[src_quad].front();
-            quad_resp_queues_[src_quad].erase(
-                quad_resp_queues_[src_quad].begin());
+            quad_resp_queues_[src_quad].pop_front();
             link_resp_queues_[dest_link].push_back(resp);
             link_busy_[dest_link] = resp->flits;
             resp->exit_time = logic_clk_ + resp->flits;
@@ -536,23 +745,15 @@ void HMCMemorySystem::DrainResponses() {
         } else {  // stalled this cycle, update age counter
             quad_age_counter_[src_quad]++;
         }
-        age_queue.erase(age_queue.begin());
     }
-    age_queue.clear();
 }
 
 void HMCMemorySystem::DRAMClockTick() {
     for (size_t i = 0; i < ctrls_.size(); i++) {
         // look ahead and return earlier
-        while (true) {
-            auto pair = ctrls_[i]->ReturnDoneTrans(clk_);
-            if (pair.second == 1) {  // write
-                VaultCallback(pair.first);
-            } else if (pair.second == 0) {  // read
-                VaultCallback(pair.first);
-            } else {
-                break;
-            }
+        Transaction trans;
+        while (ctrls_[i]->ReturnDoneTrans(clk_, trans)) {
+            VaultCallback(trans);
         }
     }
     for (size_t i = 0; i < ctrls_.size(); i++) {
@@ -567,6 +768,7 @@ void HMCMemorySystem::DRAMClockTick() {
 }
 
 void HMCMemorySystem::ClockTick() {
+    FeedRequests();
     if (dram_ps_ == logic_ps_) {
         DrainResponses();
         DRAMClockTick();
@@ -586,12 +788,12 @@ void HMCMemorySystem::ClockTick() {
     return;
 }
 
-std::vector<int> HMCMemorySystem::BuildAgeQueue(std::vector<int> &age_counter) {
-    // return a vector of indices sorted in decending order
+void HMCMemorySystem::BuildAgeQueue(const std::vector<int> &age_counter) {
+    // fill age_queue_ with indices sorted in decending order
     // meaning that the oldest age link/quad should be processed first
-    std::vector<int> age_queue;
+    std::vector<int> &age_queue = age_queue_;
+    age_queue.clear();
     int queue_len = age_counter.size();
-    age_queue.reserve(queue_len);
     int start_pos = logic_clk_ % queue_len;  // round robin start pos
     for (int i = 0; i < queue_len; i++) {
         int pos = (i + start_pos) % queue_len;
@@ -609,25 +811,25 @@ std::vector<int> HMCMemorySystem::BuildAgeQueue(std::vector<int> &age_counter) {
             }
         }
     }
-    return age_queue;
 }
 
 void HMCMemorySystem::InsertReqToDRAM(HMCRequest *req) {
-    Transaction trans(req->mem_operand, req->is_write);
+    // the vault only hands req_id back, it carries the slot through
+    Transaction trans(req->mem_operand, req->is_write, req->slot);
     ctrls_[req->vault]->AddTransaction(trans);
     return;
 }
 
-void HMCMemorySystem::VaultCallback(uint64_t req_id) {
-    // we will use hex addr as the req_id and use a multimap to lookup the
-    // requests the vaults cannot directly talk to the CPU so this callback will
-    // be passed to the vaults and is responsible to put the responses back to
-    // response queues
-
-    auto it = resp_lookup_table_.find(req_id);
-    HMCResponse *resp = it->second;
+void HMCMemorySystem::VaultCallback(const Transaction &trans) {
+    // the vaults cannot directly talk to the CPU so this callback will be
+    // passed to the vaults and is responsible to put the responses back to
+    // response queues. trans.req_id is the slot the response waits in, so
+    // requests to the same address never get each other's response
+    HMCResponse *resp = resp_slots_[trans.req_id];
+    resp->served_by = trans.served_by;
     // all data from dram received, put packet in xbar and return
-    resp_lookup_table_.erase(it);
+    resp_slots_[trans.req_id] = nullptr;
+    free_slots_.push_back(trans.req_id);
     // put it in xbar
     quad_resp_queues_[resp->quad].push_back(resp);
     quad_age_counter_[resp->quad] = 1;
@@ -1,8 +1,9 @@
 #ifndef __HMC_H
 #define __HMC_H
 
+#include <algorithm>
+#include <deque>
 #include <functional>
-#include <map>
 #include <vector>
 
 #include "dram_system.h"
@@ -86,6 +87,12 @@ class HMCRequest {
     int vault;
     int flits;
     bool is_write;
+    uint64_t req_id;  // the host's, the address unless it gave one
+    // index of its response in the response slots, the vault gets it as
+    // the transaction's req_id and hands it back in the callback
+    uint64_t slot;
+    // split id of the sized request it is a packet of, 0 if none
+    uint64_t split;
     // this exit_time is the time to exit xbar to vaults
     uint64_t exit_time;
 };
@@ -95,6 +102,10 @@ class HMCResponse {
     HMCResponse(uint64_t id, HMCReqType reqtype, int dest_link, int src_quad);
     uint64_t resp_id;
     HMCRespType type;
+    uint64_t req_id;
+    uint64_t added_cycle;  // when the request went onto its link
+    ServedBy served_by;
+    uint64_t split;  // same as its request's
     int link;
     int quad;
     int flits;
@@ -102,9 +113,78 @@ class HMCResponse {
     uint64_t exit_time;
 };
 
+// Xbar buffer holding up to capacity packets in a fixed ring, pushes only
+// allocate if it ever has to hold more than that
+template <typename T>
+class RingQueue {
+   public:
+    explicit RingQueue(size_t capacity = 1)
+        : buffer_(std::max<size_t>(capacity, 1)), head_(0), size_(0) {}
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+    T& front() { return buffer_[head_]; }
+    const T& front() const { return buffer_[head_]; }
+    // i-th oldest
+    const T& operator[](size_t i) const { return buffer_[Wrap(head_ + i)]; }
+    void push_back(const T& value) {
+        if (size_ == buffer_.size()) {
+            Grow();
+        }
+        buffer_[Wrap(head_ + size_)] = value;
+        size_++;
+    }
+    void pop_front() {
+        head_ = Wrap(head_ + 1);
+        size_--;
+    }
+    void clear() {
+        head_ = 0;
+        size_ = 0;
+    }
+
+   private:
+    size_t Wrap(size_t pos) const {
+        return pos < buffer_.size() ? pos : pos - buffer_.size();
+    }
+    void Grow() {
+        std::vector<T> bigger(buffer_.size() * 2);
+        for (size_t i = 0; i < size_; i++) {
+            bigger[i] = buffer_[Wrap(head_ + i)];
+        }
+        buffer_.swap(bigger);
+        head_ = 0;
+    }
+
+    std::vector<T> buffer_;
+    size_t head_;
+    size_t size_;
+};
+
+// Recycles packets through a free list, storage only ever grows to the most
+// packets in flight at once and is released with the pool
+template <typename T>
+class ObjectPool {
+   public:
+    T* New(const T& value) {
+        if (free_.empty()) {
+            storage_.push_back(value);
+            return &storage_.back();
+        }
+        T* obj = free_.back();
+        free_.pop_back();
+        *obj = value;
+        return obj;
+    }
+    void Delete(T* obj) { free_.push_back(obj); }
+
+   private:
+    std::deque<T> storage_;  // never moves its elements when growing
+    std::vector<T*> free_;
+};
+
 class HMCMemorySystem : public BaseDRAMSystem {
    public:
-    HMCMemorySystem(Config& config, const std::string& output_dir,
+    HMCMemorySystem(const Config& config, const OutputNames& outputs,
                     std::function<void(uint64_t)> read_callback,
                     std::function<void(uint64_t)> write_callback);
     ~HMCMemorySystem();
@@ -115,20 +195,33 @@ class HMCMemorySystem : public BaseDRAMSystem {
 
     // had to have 3 insert interfaces cuz HMC is so different...
     bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const override;
-    bool AddTransaction(uint64_t hex_addr, bool is_write) override;
+    bool AddTransaction(uint64_t hex_addr, bool is_write,
+                        uint64_t req_id) override;
+    // a request of more than one block goes in as one block_size packet per
+    // block, each to the vault of its address, and completes with the last
+    // response. It takes a free link slot per packet, or one if there are
+    // more packets than link slots, the rest wait for room in later cycles.
+    AddResult TryAddTransaction(uint64_t hex_addr, bool is_write,
+                                uint64_t req_id, int bursts) override;
+    // req is copied into the system once it goes in, the caller keeps it
     bool InsertReqToLink(HMCRequest* req, int link);
     bool InsertHMCReq(HMCRequest* req);
+    void SaveState(CheckpointWriter& ckpt) const override;
+    void LoadState(CheckpointReader& ckpt) override;
 
    private:
     uint64_t logic_clk_, ps_per_dram_, ps_per_logic_, logic_ps_, dram_ps_;
 
     void SetClockRatio();
+    HMCReqType BlockReqType(bool is_write) const;
+    size_t FreeLinkSlots() const;
+    void FeedRequests();
     void DRAMClockTick();
     void DrainRequests();
     void DrainResponses();
     void InsertReqToDRAM(HMCRequest* req);
-    void VaultCallback(uint64_t req_id);
-    std::vector<int> BuildAgeQueue(std::vector<int>& age_counter);
+    void VaultCallback(const Transaction& trans);
+    void BuildAgeQueue(const std::vector<int>& age_counter);
     void XbarArbitrate();
     inline void IterateNextLink();
 
@@ -139,14 +232,23 @@ class HMCMemorySystem : public BaseDRAMSystem {
     // number of flits xbar can process per logic cycle
     const int xbar_bandwidth_ = 2;
 
-    // had to use a multimap because the controller callback return hex addr
-    // instead of unique id
-    std::multimap<uint64_t, HMCResponse*> resp_lookup_table_;
-    // these are essentially input/output buffers for xbars
-    std::vector<std::vector<HMCRequest*>> link_req_queues_;
-    std::vector<std::vector<HMCResponse*>> link_resp_queues_;
-    std::vector<std::vector<HMCRequest*>> quad_req_queues_;
-    std::vector<std::vector<HMCResponse*>> quad_resp_queues_;
+    // responses waiting on the vaults, by slot, nullptr for a free slot.
+    // Slots are reused, so the table only grows to the most requests in
+    // flight at once
+    std::vector<HMCResponse*> resp_slots_;
+    std::vector<uint64_t> free_slots_;
+    // every request and response in flight comes from these
+    ObjectPool<HMCRequest> req_pool_;
+    ObjectPool<HMCResponse> resp_pool_;
+    // these are essentially input/output buffers for xbars, queue_depth_
+    // each. Only the quad response queues can outgrow that, the vaults
+    // call back without checking for room
+    std::vector<RingQueue<HMCRequest*>> link_req_queues_;
+    std::vector<RingQueue<HMCResponse*>> link_resp_queues_;
+    std::vector<RingQueue<HMCRequest*>> quad_req_queues_;
+    std::vector<RingQueue<HMCResponse*>> quad_resp_queues_;
+    // packets of sized requests that found no link slot yet, in order
+    std::deque<HMCRequest> staged_reqs_;
 
     // input/output busy indicators, since each packet could be several
     // flits, as long as this != 0 then they're busy
@@ -155,6 +257,8 @@ class HMCMemorySystem : public BaseDRAMSystem {
     // used for arbitration
     std::vector<int> link_age_counter_;
     std::vector<int> quad_age_counter_ = {0, 0, 0, 0};
+    // links or quads in arbitration order, rebuilt every logic cycle
+    std::vector<int> age_queue_;
 };
 
 }  // namespace dramsim3
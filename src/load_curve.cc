@@ -0,0 +1,196 @@
+#include "load_curve.h"
+
+#include <algorithm>
+#include <cmath>
+#include "fmt/format.h"
+
+namespace dramsim3 {
+
+namespace {
+// warmup is done in windows of this many cycles, a point is considered steady
+// once two consecutive windows agree on throughput and latency within
+// kSteadyTolerance
+const uint64_t kWindowCycles = 10000;
+const int kMaxWarmupWindows = 20;
+const double kSteadyTolerance = 0.05;
+
+bool WithinTolerance(double prev, double curr) {
+    if (prev == 0.0 && curr == 0.0) {
+        return true;
+    }
+    return std::fabs(curr - prev) <= kSteadyTolerance * std::max(prev, curr);
+}
+}  // namespace
+
+LoadCurveBench::LoadCurveBench(const std::string& config_file,
+                               const std::string& output_dir,
+                               double write_ratio, double locality)
+    : memory_system_(
+          config_file, output_dir,
+          std::bind(&LoadCurveBench::ReadCallBack, this, std::placeholders::_1),
+          std::bind(&LoadCurveBench::WriteCallBack, this,
+                    std::placeholders::_1)),
+      write_ratio_(write_ratio),
+      locality_(locality),
+      dist_(0.0, 1.0),
+      rate_(0.0),
+      credit_(0.0),
+      clk_(0),
+      last_addr_(0),
+      last_write_(false),
+      has_pending_(false),
+      window_reads_(0),
+      window_writes_(0) {
+    request_size_ =
+        memory_system_.GetBusBits() / 8 * memory_system_.GetBurstLength();
+    // each channel moves one request per burst
+    int burst_cycle = std::max(memory_system_.GetBurstCycle(), 1);
+    peak_rate_ = static_cast<double>(memory_system_.GetChannels()) /
+                 static_cast<double>(burst_cycle);
+}
+
+void LoadCurveBench::ReadCallBack(uint64_t addr) {
+    auto it = inflight_reads_.find(addr);
+    if (it == inflight_reads_.end()) {
+        return;
+    }
+    latencies_.push_back(clk_ - it->second.front());
+    it->second.pop_front();
+    if (it->second.empty()) {
+        inflight_reads_.erase(it);
+    }
+    window_reads_++;
+}
+
+void LoadCurveBench::WriteCallBack(uint64_t addr) { window_writes_++; }
+
+void LoadCurveBench::ClockTick() {
+    memory_system_.ClockTick();
+    // don't bank up credits while the memory system is pushing back,
+    // otherwise a saturated point would never drain
+    if (!has_pending_) {
+        credit_ = std::min(credit_ + rate_, 1.0 + rate_);
+    }
+    while (credit_ >= 1.0 || has_pending_) {
+        if (!has_pending_) {
+            if (dist_(gen_) < locality_) {
+                last_addr_ += request_size_;
+            } else {
+                last_addr_ = gen_() / request_size_ * request_size_;
+            }
+            last_write_ = dist_(gen_) < write_ratio_;
+            has_pending_ = true;
+            credit_ -= 1.0;
+        }
+        if (!memory_system_.WillAcceptTransaction(last_addr_, last_write_)) {
+            break;
+        }
+        memory_system_.AddTransaction(last_addr_, last_write_);
+        if (!last_write_) {
+            inflight_reads_[last_addr_].push_back(clk_);
+        }
+        has_pending_ = false;
+    }
+    clk_++;
+    return;
+}
+
+void LoadCurveBench::RunWindow(uint64_t cycles) {
+    latencies_.clear();
+    window_reads_ = 0;
+    window_writes_ = 0;
+    for (uint64_t i = 0; i < cycles; i++) {
+        ClockTick();
+    }
+}
+
+LoadPoint LoadCurveBench::MeasurePoint(double load, uint64_t measure_cycles) {
+    LoadPoint point;
+    point.offered_load = load;
+    rate_ = load * peak_rate_;
+
+    // warm up until two consecutive windows agree
+    double prev_tput = -1.0, prev_lat = -1.0;
+    int stable_windows = 0;
+    int windows = 0;
+    point.steady = false;
+    while (windows < kMaxWarmupWindows) {
+        RunWindow(kWindowCycles);
+        windows++;
+        double tput = static_cast<double>(window_reads_ + window_writes_);
+        double lat = 0.0;
+        for (auto l : latencies_) {
+            lat += l;
+        }
+        lat = latencies_.empty() ? 0.0 : lat / latencies_.size();
+        if (WithinTolerance(prev_tput, tput) &&
+            WithinTolerance(prev_lat, lat)) {
+            stable_windows++;
+        } else {
+            stable_windows = 0;
+        }
+        prev_tput = tput;
+        prev_lat = lat;
+        if (stable_windows >= 2) {
+            point.steady = true;
+            break;
+        }
+    }
+    point.warmup_cycles = windows * kWindowCycles;
+
+    memory_system_.ResetStats();
+    RunWindow(measure_cycles);
+
+    point.num_reads = window_reads_;
+    point.num_writes = window_writes_;
+    double elapsed_ns = measure_cycles * memory_system_.GetTCK();
+    point.achieved_bw =
+        (window_reads_ + window_writes_) * request_size_ / elapsed_ns;
+    if (latencies_.empty()) {
+        point.avg_latency = 0.0;
+        point.p50_latency = 0;
+        point.p99_latency = 0;
+    } else {
+        double sum = 0.0;
+        for (auto l : latencies_) {
+            sum += l;
+        }
+        point.avg_latency = sum / latencies_.size();
+        size_t p50 = latencies_.size() / 2;
+        size_t p99 = latencies_.size() * 99 / 100;
+        std::nth_element(latencies_.begin(), latencies_.begin() + p50,
+                         latencies_.end());
+        point.p50_latency = latencies_[p50];
+        std::nth_element(latencies_.begin(), latencies_.begin() + p99,
+                         latencies_.end());
+        point.p99_latency = latencies_[p99];
+    }
+    return point;
+}
+
+void LoadCurveBench::Run(int num_points, uint64_t measure_cycles) {
+    points_.clear();
+    for (int i = 1; i <= num_points; i++) {
+        double load = static_cast<double>(i) / num_points;
+        points_.push_back(MeasurePoint(load, measure_cycles));
+    }
+}
+
+void LoadCurveBench::PrintTable(std::ostream& where) const {
+    double tck = memory_system_.GetTCK();
+    where << fmt::format("{:>8}{:>12}{:>10}{:>10}{:>10}{:>10}{:>10}{:>8}",
+                         "load", "bw(GB/s)", "avg_lat", "p50_lat", "p99_lat",
+                         "p50(ns)", "p99(ns)", "steady")
+          << std::endl;
+    for (const auto& p : points_) {
+        where << fmt::format(
+                     "{:>7.0f}%{:>12.2f}{:>10.1f}{:>10}{:>10}{:>10.1f}{:>10.1f}"
+                     "{:>8}",
+                     p.offered_load * 100, p.achieved_bw, p.avg_latency,
+                     p.p50_latency, p.p99_latency, p.p50_latency * tck,
+                     p.p99_latency * tck, p.steady ? "yes" : "no")
+              << std::endl;
+    }
+}
+
+}  // namespace dramsim3
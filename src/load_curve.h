@@ -0,0 +1,75 @@
+#ifndef __LOAD_CURVE_H
+#define __LOAD_CURVE_H
+
+#include <deque>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "memory_system.h"
+
+namespace dramsim3 {
+
+// One measured point of a load-latency curve
+struct LoadPoint {
+    double offered_load;    // fraction of peak request rate
+    double achieved_bw;     // GB/s
+    double avg_latency;     // read latency in DRAM cycles
+    uint64_t p50_latency;
+    uint64_t p99_latency;
+    uint64_t num_reads;
+    uint64_t num_writes;
+    uint64_t warmup_cycles;
+    bool steady;
+};
+
+// Sweeps the offered load of a synthetic request stream from idle to
+// saturation on a single memory system. Each load point is warmed up until
+// bandwidth and latency settle, then stats are reset and a fixed window is
+// measured. The generator stalls whenever the memory system pushes back, so
+// beyond saturation the offered load collapses onto the achieved bandwidth.
+class LoadCurveBench {
+   public:
+    LoadCurveBench(const std::string& config_file,
+                   const std::string& output_dir, double write_ratio,
+                   double locality);
+    // num_points evenly spaced load points in (0, 1], each measured for
+    // measure_cycles after warmup
+    void Run(int num_points, uint64_t measure_cycles);
+    void PrintTable(std::ostream& where) const;
+    void PrintStats() { memory_system_.PrintStats(); }
+
+   private:
+    void ReadCallBack(uint64_t addr);
+    void WriteCallBack(uint64_t addr);
+    void ClockTick();
+    void RunWindow(uint64_t cycles);
+    LoadPoint MeasurePoint(double load, uint64_t measure_cycles);
+
+    MemorySystem memory_system_;
+    double write_ratio_;
+    double locality_;
+    std::mt19937_64 gen_;
+    std::uniform_real_distribution<double> dist_;
+
+    int request_size_;
+    double peak_rate_;  // requests per DRAM cycle at 100% load
+    double rate_;       // current offered requests per cycle
+    double credit_;
+
+    uint64_t clk_;
+    uint64_t last_addr_;
+    bool last_write_;
+    bool has_pending_;
+
+    // read issue cycles, per address in FIFO order
+    std::unordered_map<uint64_t, std::deque<uint64_t>> inflight_reads_;
+    std::vector<uint64_t> latencies_;
+    uint64_t window_reads_;
+    uint64_t window_writes_;
+
+    std::vector<LoadPoint> points_;
+};
+
+}  // namespace dramsim3
+#endif
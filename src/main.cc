@@ -1,6 +1,12 @@
 #include <iostream>
+#include <thread>
 #include "./../ext/headers/args.hxx"
 #include "cpu.h"
+#include "fanout.h"
+#include "load_curve.h"
+#include "mapping_tuner.h"
+#include "sampling.h"
+#include "sweep.h"
 
 using namespace dramsim3;
 
@@ -21,6 +27,10 @@ int main(int argc, const char **argv) {
     args::ValueFlag<uint64_t> num_cycles_arg(parser, "num_cycles",
                                              "Number of cycles to simulate",
                                              {'c', "cycles"}, 100000);
+    args::ValueFlag<uint64_t> warmup_cycles_arg(
+        parser, "warmup_cycles",
+        "Cycles of functional warmup (row buffers only) before -c cycles",
+        {'w', "warmup"}, 0);
     args::ValueFlag<std::string> output_dir_arg(
         parser, "output_dir", "Output directory for stats files",
         {'o', "output-dir"}, ".");
@@ -31,6 +41,84 @@ int main(int argc, const char **argv) {
         parser, "trace",
         "Trace file, setting this option will ignore -s option",
         {'t', "trace"});
+    args::ValueFlag<double> cpu_freq_arg(
+        parser, "cpu_freq",
+        "CPU clock in MHz, -c, -w and the trace timestamps are then CPU "
+        "cycles and the DRAM clock follows at its own frequency",
+        {"cpu-freq"}, 0);
+    args::Flag load_curve_arg(
+        parser, "load_curve",
+        "Sweep offered load from idle to saturation and print a "
+        "load-latency table, -c sets the measured cycles per point",
+        {'l', "load-curve"});
+    args::ValueFlag<int> load_points_arg(
+        parser, "load_points", "Number of load points in the sweep",
+        {"load-points"}, 10);
+    args::ValueFlag<double> write_ratio_arg(
+        parser, "write_ratio", "Fraction of writes in the load sweep",
+        {"write-ratio"}, 0.33);
+    args::ValueFlag<double> locality_arg(
+        parser, "locality",
+        "Probability that a request in the load sweep is sequential",
+        {"locality"}, 0.0);
+    args::Flag sample_arg(
+        parser, "sample",
+        "Sampled simulation of the -t trace, alternating functional "
+        "warmup with detailed samples until the target error is met",
+        {"sample"});
+    args::ValueFlag<uint64_t> sample_unit_arg(
+        parser, "sample_unit", "Requests measured per sample",
+        {"sample-unit"}, 1000);
+    args::ValueFlag<uint64_t> sample_warm_arg(
+        parser, "sample_warm", "Detailed requests simulated before a sample",
+        {"sample-warm"}, 2000);
+    args::ValueFlag<int> samples_arg(parser, "samples",
+                                     "Number of samples in the first pass",
+                                     {"samples"}, 50);
+    args::ValueFlag<double> target_error_arg(
+        parser, "target_error", "Target relative error of the estimates",
+        {"target-error"}, 0.03);
+    args::ValueFlag<double> confidence_arg(
+        parser, "confidence", "Confidence level of the estimates",
+        {"confidence"}, 0.997);
+    args::ValueFlagList<std::string> fanout_arg(
+        parser, "fanout",
+        "Another config to simulate on the -t trace in the same run, the "
+        "trace is parsed once and every config runs on its own thread with "
+        "its stats in output_dir/<config name>/, repeatable",
+        {"fanout"});
+    args::Flag sweep_arg(
+        parser, "sweep",
+        "The config has {a, b} / {start:stop:step} values, run every "
+        "combination of them and print a summary table",
+        {"sweep"});
+    args::Flag tune_mapping_arg(
+        parser, "tune_mapping",
+        "Rank every address_mapping, plain and XOR hashed, on the -t trace "
+        "with an open-row model, then simulate the best ones for -c cycles",
+        {"tune-mapping"});
+    args::ValueFlag<uint64_t> tune_requests_arg(
+        parser, "tune_requests",
+        "Trace requests the --tune-mapping model looks at, 0 for all",
+        {"tune-requests"}, 1000000);
+    args::ValueFlag<int> tune_validate_arg(
+        parser, "tune_validate",
+        "Best --tune-mapping candidates to validate with full simulation",
+        {"tune-validate"}, 3);
+    args::Flag pipeline_arg(
+        parser, "pipeline",
+        "Run the memory system on its own thread, fed through a lock-free "
+        "queue while this thread decodes the -t trace or generates random "
+        "requests, same results as without",
+        {"pipeline"});
+    args::ValueFlag<uint64_t> slack_arg(
+        parser, "slack",
+        "Cycles the --pipeline host may run ahead of the memory system",
+        {"slack"}, 100000);
+    args::ValueFlag<int> threads_arg(
+        parser, "threads", "Worker threads for --sweep and --tune-mapping",
+        {'j', "threads"},
+        static_cast<int>(std::thread::hardware_concurrency()));
     args::Positional<std::string> config_arg(
         parser, "config", "The config file name (mandatory)");
 
@@ -66,6 +154,119 @@ int main(int argc, const char **argv) {
     //如果不是trace模式，指定stream还是random
     std::string stream_type = args::get(stream_arg);
 
+    // only the plain CPU runs have a host clock, every other mode counts -c
+    // and the trace timestamps in DRAM cycles
+    if (args::get(cpu_freq_arg) > 0) {
+        std::string mode;
+        if (args::get(load_curve_arg)) {
+            mode = "--load-curve";
+        } else if (args::get(sample_arg)) {
+            mode = "--sample";
+        } else if (args::get(sweep_arg)) {
+            mode = "--sweep";
+        } else if (args::get(tune_mapping_arg)) {
+            mode = "--tune-mapping";
+        } else if (!args::get(fanout_arg).empty()) {
+            mode = "--fanout";
+        } else if (args::get(pipeline_arg)) {
+            mode = "--pipeline";
+        }
+        if (!mode.empty()) {
+            std::cerr << mode << " runs in DRAM cycles, no --cpu-freq"
+                      << std::endl;
+            return 1;
+        }
+    }
+
+    if (args::get(load_curve_arg)) {
+        LoadCurveBench bench(config_file, output_dir,
+                             args::get(write_ratio_arg),
+                             args::get(locality_arg));
+        bench.Run(args::get(load_points_arg), cycles);
+        bench.PrintTable(std::cout);
+        bench.PrintStats();
+        return 0;
+    }
+
+    if (args::get(sample_arg)) {
+        if (trace_file.empty()) {
+            std::cerr << "--sample needs a trace file (-t)" << std::endl;
+            return 1;
+        }
+        SamplingParams params;
+        params.unit_size = args::get(sample_unit_arg);
+        params.warm_size = args::get(sample_warm_arg);
+        params.initial_samples = args::get(samples_arg);
+        params.target_error = args::get(target_error_arg);
+        params.confidence = args::get(confidence_arg);
+        params.max_passes = 3;
+        SamplingSim sampler(config_file, output_dir, trace_file, params);
+        sampler.Run();
+        sampler.PrintReport(std::cout);
+        sampler.PrintStats();
+        return 0;
+    }
+
+    if (args::get(sweep_arg)) {
+        SweepRunner sweep(config_file, output_dir);
+        std::cout << "Sweeping " << sweep.NumPoints() << " points"
+                  << std::endl;
+        sweep.Run(trace_file, stream_type, cycles,
+                  std::max(args::get(threads_arg), 1));
+        sweep.PrintTable(std::cout);
+        return 0;
+    }
+
+    if (args::get(tune_mapping_arg)) {
+        if (trace_file.empty()) {
+            std::cerr << "--tune-mapping needs a trace file (-t)" << std::endl;
+            return 1;
+        }
+        int threads = std::max(args::get(threads_arg), 1);
+        MappingTuner tuner(config_file, output_dir, trace_file,
+                           args::get(tune_requests_arg));
+        std::cout << "Estimating " << tuner.NumCandidates()
+                  << " address mappings" << std::endl;
+        tuner.Run(threads);
+        tuner.Validate(args::get(tune_validate_arg), cycles, threads);
+        tuner.PrintTable(std::cout, 10);
+        tuner.PrintBest(std::cout);
+        return 0;
+    }
+
+    if (!args::get(fanout_arg).empty()) {
+        if (trace_file.empty()) {
+            std::cerr << "--fanout needs a trace file (-t)" << std::endl;
+            return 1;
+        }
+        std::vector<std::string> config_files = {config_file};
+        for (const auto& fanout_config : args::get(fanout_arg)) {
+            config_files.push_back(fanout_config);
+        }
+        TraceFanout fanout(config_files, output_dir, trace_file);
+        fanout.Run(cycles);
+        return 0;
+    }
+
+    if (args::get(pipeline_arg)) {
+        if (trace_file.empty() && (stream_type == "stream" ||
+                                   stream_type == "s")) {
+            std::cerr << "--pipeline runs a trace (-t) or the random stream"
+                      << std::endl;
+            return 1;
+        }
+        if (args::get(warmup_cycles_arg) > 0) {
+            std::cerr << "--pipeline has no functional warmup (-w)"
+                      << std::endl;
+            return 1;
+        }
+        PipelinedCPU cpu(config_file, output_dir, trace_file,
+                         args::get(slack_arg));
+        cpu.Run(cycles);
+        cpu.PrintStats();
+        return 0;
+    }
+
     CPU *cpu;
     if (!trace_file.empty()) {
         cpu = new TraceBasedCPU(config_file, output_dir, trace_file);
@@ -77,6 +278,19 @@ int main(int argc, const char **argv) {
         }
     }
 
+    if (args::get(cpu_freq_arg) > 0) {
+        cpu->SetHostFrequency(args::get(cpu_freq_arg));
+    }
+
+    uint64_t warmup_cycles = args::get(warmup_cycles_arg);
+    if (warmup_cycles > 0) {
+        cpu->SetFunctionalMode(true);
+        for (uint64_t clk = 0; clk < warmup_cycles; clk++) {
+            cpu->ClockTick();
+        }
+        cpu->SetFunctionalMode(false);
+    }
+
     for (uint64_t clk = 0; clk < cycles; clk++) {
         cpu->ClockTick();
     }
@@ -0,0 +1,359 @@
+#include "mapping_tuner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <thread>
+#include "fmt/format.h"
+
+namespace dramsim3 {
+
+namespace {
+const char* kHashKeys[] = {"channel_hash", "rank_hash", "bankgroup_hash",
+                           "bank_hash"};
+
+// runs job(i) for i in [0, count) on up to num_threads threads
+template <typename Job>
+void ParallelFor(size_t count, int num_threads, Job job) {
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            job(i);
+        }
+    };
+    int threads = std::max(1, std::min(num_threads, static_cast<int>(count)));
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(worker);
+    }
+    for (auto& t : workers) {
+        t.join();
+    }
+}
+
+std::string HashMasks(const std::vector<uint64_t>& masks) {
+    std::string value;
+    for (auto mask : masks) {
+        value += (value.empty() ? "" : ", ") + fmt::format("{:#x}", mask);
+    }
+    return value;
+}
+}  // namespace
+
+MappingTuner::MappingTuner(const std::string& config_file,
+                           const std::string& output_dir,
+                           const std::string& trace_file,
+                           uint64_t max_requests)
+    : output_dir_(output_dir), trace_file_(trace_file), ini_(config_file) {
+    if (ini_.ParseError() < 0) {
+        std::cerr << "Can't load config file - " << config_file << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    std::ifstream trace(trace_file);
+    if (trace.fail()) {
+        std::cerr << "Trace file does not exist" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    Transaction trans;
+    while ((max_requests == 0 || addresses_.size() < max_requests) &&
+           trace >> trans) {
+        addresses_.push_back(trans.addr);
+    }
+
+    Config base(ini_, ConfigOverrides(), output_dir_);
+    bool plain = base.address_bits.empty() && base.ch_hash.empty() &&
+                 base.ra_hash.empty() && base.bg_hash.empty() &&
+                 base.ba_hash.empty();
+
+    // fields with a single value are left out of the comparison, orders
+    // that only differ in where those go are the same mapping
+    std::map<std::string, int> field_counts = {
+        {"ba", base.banks_per_group}, {"bg", base.bankgroups},
+        {"ch", base.channels},        {"co", base.columns / base.BL},
+        {"ra", base.ranks},           {"ro", base.rows}};
+    auto distinct_fields = [&field_counts](const std::string& mapping) {
+        std::string key;
+        for (size_t i = 0; i + 1 < mapping.size(); i += 2) {
+            auto it = field_counts.find(mapping.substr(i, 2));
+            if (it == field_counts.end() || it->second > 1) {
+                key += mapping.substr(i, 2);
+            }
+        }
+        return key;
+    };
+    std::string base_key = distinct_fields(base.address_mapping);
+    std::vector<std::string> fields;
+    for (const auto& field : field_counts) {
+        fields.push_back(field.first);
+    }
+    std::set<std::string> seen;
+    do {
+        std::string mapping;
+        for (const auto& field : fields) {
+            mapping += field;
+        }
+        std::string key = distinct_fields(mapping);
+        if (!seen.insert(key).second) {
+            continue;
+        }
+        // keep the config file's spelling of its own mapping
+        bool from_config = plain && key == base_key;
+        AddCandidate(from_config ? base.address_mapping : mapping, false,
+                     from_config);
+        if (!base.IsRadixMapping()) {
+            AddCandidate(mapping, true, false);
+        }
+    } while (std::next_permutation(fields.begin(), fields.end()));
+
+    // a config that already uses address_bits or hashing is compared as is
+    if (!plain) {
+        MappingCandidate candidate = MappingCandidate();
+        candidate.address_mapping =
+            base.address_bits.empty() ? base.address_mapping : base.address_bits;
+        candidate.hashed = !(base.ch_hash.empty() && base.ra_hash.empty() &&
+                             base.bg_hash.empty() && base.ba_hash.empty());
+        candidate.from_config = true;
+        candidates_.push_back(candidate);
+    }
+}
+
+void MappingTuner::AddCandidate(const std::string& address_mapping,
+                                bool hashed, bool from_config) {
+    MappingCandidate candidate = MappingCandidate();
+    candidate.address_mapping = address_mapping;
+    candidate.hashed = hashed;
+    candidate.from_config = from_config;
+    candidate.overrides["system.address_mapping"] = address_mapping;
+    candidate.overrides["system.address_bits"] = "";
+    for (const auto key : kHashKeys) {
+        candidate.overrides[std::string("system.") + key] = "";
+    }
+    if (hashed) {
+        // the lowest row bits, one per bank, bankgroup and channel bit, so
+        // strides that only differ in the row spread out
+        Config config(ini_, candidate.overrides, output_dir_);
+        uint64_t row_bits = config.ro_bits;
+        bool any_masks = false;
+        std::vector<std::pair<const char*, uint64_t>> targets = {
+            {"bank_hash", config.ba_bits},
+            {"bankgroup_hash", config.bg_bits},
+            {"channel_hash", config.ch_bits}};
+        for (const auto& target : targets) {
+            std::vector<uint64_t> masks;
+            for (uint64_t bits = target.second; bits != 0 && row_bits != 0;
+                 bits &= bits - 1) {
+                masks.push_back(row_bits & (~row_bits + 1));
+                row_bits &= row_bits - 1;
+            }
+            any_masks = any_masks || !masks.empty();
+            candidate.overrides[std::string("system.") + target.first] =
+                HashMasks(masks);
+        }
+        if (!any_masks) {
+            return;
+        }
+    }
+    candidates_.push_back(candidate);
+}
+
+// Requests are taken in windows of trans_queue_size, what one controller
+// queue can reorder over. Within a window each bank is busy for its row
+// hits, opens and conflicts, each channel bus for its bursts, and the
+// window takes as long as the busiest of them.
+void MappingTuner::Estimate(MappingCandidate& candidate) const {
+    Config config(ini_, candidate.overrides, output_dir_);
+    bool open_page = config.row_buf_policy != "CLOSE_PAGE";
+    uint64_t hit_cost = config.tCCD_L;
+    uint64_t miss_cost = config.tRCD + hit_cost;
+    uint64_t conflict_cost = config.tRP + miss_cost;
+    uint64_t burst_cost = std::max(config.burst_cycle, config.tCCD_S);
+    size_t window = std::max(config.trans_queue_size, 1);
+
+    int num_banks = config.channels * config.ranks * config.banks;
+    std::vector<int> open_row(num_banks, -1);
+    std::vector<uint64_t> bank_busy(num_banks, 0), bank_window(num_banks, 0);
+    std::vector<uint64_t> channel_busy(config.channels, 0),
+        channel_window(config.channels, 0);
+
+    uint64_t hits = 0, distinct_banks = 0, distinct_channels = 0;
+    uint64_t est_cycles = 0, window_cycles = 0, num_windows = 0;
+    for (size_t i = 0; i < addresses_.size(); i++) {
+        if (i % window == 0) {
+            est_cycles += window_cycles;
+            window_cycles = 0;
+            num_windows++;
+        }
+        Address addr = config.AddressMapping(addresses_[i]);
+        int bank = ((addr.channel * config.ranks + addr.rank) *
+                        config.bankgroups +
+                    addr.bankgroup) *
+                       config.banks_per_group +
+                   addr.bank;
+        if (bank_window[bank] != num_windows) {
+            bank_window[bank] = num_windows;
+            bank_busy[bank] = 0;
+            distinct_banks++;
+        }
+        if (channel_window[addr.channel] != num_windows) {
+            channel_window[addr.channel] = num_windows;
+            channel_busy[addr.channel] = 0;
+            distinct_channels++;
+        }
+        if (open_row[bank] == addr.row) {
+            hits++;
+            bank_busy[bank] += hit_cost;
+        } else {
+            bank_busy[bank] += open_row[bank] < 0 ? miss_cost : conflict_cost;
+            open_row[bank] = open_page ? addr.row : -1;
+        }
+        channel_busy[addr.channel] += burst_cost;
+        window_cycles = std::max(window_cycles, std::max(bank_busy[bank],
+                                 channel_busy[addr.channel]));
+    }
+    est_cycles += window_cycles;
+
+    size_t num_requests = std::max(addresses_.size(), size_t(1));
+    num_windows = std::max(num_windows, uint64_t(1));
+    candidate.row_hit_rate = static_cast<double>(hits) / num_requests;
+    candidate.bank_parallelism =
+        static_cast<double>(distinct_banks) / num_windows;
+    candidate.channel_parallelism =
+        static_cast<double>(distinct_channels) / num_windows;
+    candidate.est_cycles = est_cycles;
+}
+
+void MappingTuner::Run(int num_threads) {
+    ParallelFor(candidates_.size(), num_threads,
+                [this](size_t i) { Estimate(candidates_[i]); });
+    std::stable_sort(candidates_.begin(), candidates_.end(),
+                     [](const MappingCandidate& a, const MappingCandidate& b) {
+                         if (a.est_cycles != b.est_cycles) {
+                             return a.est_cycles < b.est_cycles;
+                         }
+                         return a.row_hit_rate > b.row_hit_rate;
+                     });
+    WriteCSV();
+}
+
+void MappingTuner::Validate(int num_candidates, uint64_t cycles,
+                            int num_threads) {
+    std::vector<size_t> picked;
+    for (size_t i = 0; i < candidates_.size(); i++) {
+        if (static_cast<int>(i) < num_candidates || candidates_[i].from_config) {
+            picked.push_back(i);
+        }
+    }
+    for (auto i : picked) {
+        std::string dir = output_dir_ + "/tune_" + std::to_string(i);
+        if (!MakeDir(dir)) {
+            std::cerr << "Can't create output directory " << dir << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+    }
+    ParallelFor(picked.size(), num_threads, [this, &picked, cycles](size_t n) {
+        size_t i = picked[n];
+        auto config = std::make_shared<const Config>(
+            ini_, candidates_[i].overrides,
+            output_dir_ + "/tune_" + std::to_string(i));
+        candidates_[i].sim = SimulatePoint(config, trace_file_, "", cycles);
+        candidates_[i].validated = true;
+    });
+    WriteCSV();
+}
+
+void MappingTuner::PrintTable(std::ostream& where, int num_rows) const {
+    where << fmt::format("{:>5} {:>12} {:>4} {:>8} {:>8} {:>8} {:>12} "
+                         "{:>10} {:>10} {:>8}",
+                         "rank", "mapping", "xor", "row_hit", "bank_par",
+                         "chan_par", "est_cycles", "bw(GB/s)", "rd_lat",
+                         "sim_hit")
+          << std::endl;
+    for (size_t i = 0; i < candidates_.size(); i++) {
+        const auto& candidate = candidates_[i];
+        if (static_cast<int>(i) >= num_rows && !candidate.from_config &&
+            !candidate.validated) {
+            continue;
+        }
+        // the config file's own mapping is marked with a *
+        std::string row = fmt::format(
+            "{:>5} {:>12} {:>4} {:>8.3f} {:>8.2f} {:>8.2f} {:>12}",
+            std::to_string(i) + (candidate.from_config ? "*" : ""),
+            candidate.address_mapping, candidate.hashed ? "yes" : "no",
+            candidate.row_hit_rate, candidate.bank_parallelism,
+            candidate.channel_parallelism, candidate.est_cycles);
+        if (candidate.validated) {
+            row += fmt::format(" {:>10.3f} {:>10.2f} {:>8.3f}",
+                               candidate.sim.bandwidth,
+                               candidate.sim.read_latency,
+                               candidate.sim.row_hit_rate);
+        }
+        where << row << std::endl;
+    }
+}
+
+void MappingTuner::PrintBest(std::ostream& where) const {
+    // validated candidates by simulated bandwidth, a trace that doesn't
+    // saturate the memory gets about the same bandwidth everywhere, so
+    // within 1% of it the read latency decides
+    const MappingCandidate* best = &candidates_.front();
+    for (const auto& candidate : candidates_) {
+        if (!candidate.validated) {
+            continue;
+        }
+        double best_bw = best->sim.bandwidth;
+        if (!best->validated || candidate.sim.bandwidth > best_bw * 1.01 ||
+            (candidate.sim.bandwidth >= best_bw * 0.99 &&
+             candidate.sim.read_latency < best->sim.read_latency)) {
+            best = &candidate;
+        }
+    }
+    if (best->from_config) {
+        where << "The address mapping of the config file is the best one"
+              << std::endl;
+        return;
+    }
+    where << "Best address mapping, for the [system] section:" << std::endl;
+    where << "address_mapping = " << best->address_mapping << std::endl;
+    for (const auto key : kHashKeys) {
+        auto it = best->overrides.find(std::string("system.") + key);
+        if (it != best->overrides.end() && !it->second.empty()) {
+            where << key << " = " << it->second << std::endl;
+        }
+    }
+}
+
+void MappingTuner::WriteCSV() const {
+    std::ofstream csv_out(output_dir_ + "/mapping_tune.csv");
+    csv_out << "rank,address_mapping,channel_hash,rank_hash,bankgroup_hash,"
+               "bank_hash,from_config,row_hit_rate,bank_parallelism,"
+               "channel_parallelism,est_cycles,bandwidth,read_latency,"
+               "sim_row_hit_rate"
+            << std::endl;
+    for (size_t i = 0; i < candidates_.size(); i++) {
+        const auto& candidate = candidates_[i];
+        csv_out << i << "," << candidate.address_mapping;
+        for (const auto key : kHashKeys) {
+            auto it = candidate.overrides.find(std::string("system.") + key);
+            csv_out << ",\""
+                    << (it == candidate.overrides.end() ? "" : it->second)
+                    << "\"";
+        }
+        csv_out << "," << candidate.from_config << ","
+                << candidate.row_hit_rate << "," << candidate.bank_parallelism
+                << "," << candidate.channel_parallelism << ","
+                << candidate.est_cycles;
+        if (candidate.validated) {
+            csv_out << "," << candidate.sim.bandwidth << ","
+                    << candidate.sim.read_latency << ","
+                    << candidate.sim.row_hit_rate;
+        } else {
+            csv_out << ",,,";
+        }
+        csv_out << std::endl;
+    }
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,67 @@
+#ifndef __MAPPING_TUNER_H
+#define __MAPPING_TUNER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "configuration.h"
+#include "sweep.h"
+
+namespace dramsim3 {
+
+// One address mapping tried by the tuner and how it did
+struct MappingCandidate {
+    std::string address_mapping;
+    bool hashed;
+    bool from_config;  // the mapping the config file already has
+    ConfigOverrides overrides;  // [system] keys that select this mapping
+
+    // open-row model estimates
+    double row_hit_rate;
+    double bank_parallelism;     // distinct banks per window
+    double channel_parallelism;  // distinct channels per window
+    uint64_t est_cycles;
+
+    // full simulation, only for the validated candidates
+    bool validated;
+    SweepResult sim;
+};
+
+// Picks an address mapping for a trace. Every order of the six address
+// fields is a candidate, and unless the organization needs the mixed radix
+// mapping each order is tried once more with the lowest row bits XOR hashed
+// into the bank, bankgroup and channel bits. The trace addresses are
+// decoded with each candidate's Config and run through a per-bank open row
+// model, the candidates are ranked by its estimated cycles and the best few
+// are then validated with full simulations, stats in output_dir/tune_<n>/.
+// All candidates and their estimates also go to output_dir/mapping_tune.csv.
+class MappingTuner {
+   public:
+    // models at most max_requests requests of the trace, 0 for all of them
+    MappingTuner(const std::string& config_file, const std::string& output_dir,
+                 const std::string& trace_file, uint64_t max_requests);
+    size_t NumCandidates() const { return candidates_.size(); }
+    void Run(int num_threads);
+    // simulates the best num_candidates for cycles each, plus the mapping
+    // of the config file to compare against
+    void Validate(int num_candidates, uint64_t cycles, int num_threads);
+    void PrintTable(std::ostream& where, int num_rows) const;
+    // the [system] lines of the best validated candidate, or of the best
+    // estimate when nothing was validated
+    void PrintBest(std::ostream& where) const;
+
+   private:
+    void AddCandidate(const std::string& address_mapping, bool hashed,
+                      bool from_config);
+    void Estimate(MappingCandidate& candidate) const;
+    void WriteCSV() const;
+
+    std::string output_dir_;
+    std::string trace_file_;
+    INIReader ini_;
+    std::vector<uint64_t> addresses_;
+    std::vector<MappingCandidate> candidates_;
+};
+
+}  // namespace dramsim3
+#endif
@@ -1,27 +1,129 @@
 #include "memory_system.h"
 
+#include <algorithm>
+#include <cmath>
+
 namespace dramsim3 {
 MemorySystem::MemorySystem(const std::string &config_file,
                            const std::string &output_dir,
                            std::function<void(uint64_t)> read_callback,
                            std::function<void(uint64_t)> write_callback)
-    : config_(new Config(config_file, output_dir)) {
-    // TODO: ideal memory type?
+    : config_(std::make_shared<const Config>(config_file, output_dir)) {
+    Init(read_callback, write_callback);
+}
+
+MemorySystem::MemorySystem(const ConfigOverrides &config_values,
+                           const std::string &output_dir,
+                           std::function<void(uint64_t)> read_callback,
+                           std::function<void(uint64_t)> write_callback)
+    : config_(std::make_shared<const Config>(config_values, output_dir)) {
+    Init(read_callback, write_callback);
+}
+
+MemorySystem::MemorySystem(std::shared_ptr<const Config> config,
+                           std::function<void(uint64_t)> read_callback,
+                           std::function<void(uint64_t)> write_callback)
+    : config_(config) {
+    Init(read_callback, write_callback);
+}
+
+void MemorySystem::Init(std::function<void(uint64_t)> read_callback,
+                        std::function<void(uint64_t)> write_callback) {
+    outputs_ = new OutputNames(*config_);
     if (config_->IsHMC()) {
-        dram_system_ = new HMCMemorySystem(*config_, output_dir, read_callback,
+        dram_system_ = new HMCMemorySystem(*config_, *outputs_, read_callback,
+                                           write_callback);
+    } else if (config_->memory_backend == "IDEAL") {
+        dram_system_ = new IdealDRAMSystem(*config_, *outputs_, read_callback,
                                            write_callback);
+    } else if (config_->memory_backend == "ANALYTICAL") {
+        dram_system_ = new AnalyticalDRAMSystem(*config_, *outputs_,
+                                                read_callback, write_callback);
     } else {
-        dram_system_ = new JedecDRAMSystem(*config_, output_dir, read_callback,
+        dram_system_ = new JedecDRAMSystem(*config_, *outputs_, read_callback,
                                            write_callback);
     }
+    host_ratio_ = 0;
+    host_acc_ = 0;
+    host_clk_ = 0;
 }
 
 MemorySystem::~MemorySystem() {
     delete (dram_system_);
-    delete (config_);
+    delete (outputs_);
+}
+
+void MemorySystem::ClockTick() {
+    if (!dram_system_->IsFunctionalMode()) {
+        dram_system_->ClockTick();
+    }
+}
+
+namespace {
+const uint64_t kHostOne = static_cast<uint64_t>(1) << 32;
+
+// host cycle of a DRAM cycle, going by where both clocks are now
+uint64_t HostCycleOf(uint64_t dram_cycle, uint64_t dram_now,
+                     uint64_t host_now, uint64_t ratio) {
+    if (dram_cycle <= dram_now) {
+        uint64_t back = static_cast<uint64_t>(
+            (static_cast<unsigned __int128>(dram_now - dram_cycle) << 32) /
+            ratio);
+        return back < host_now ? host_now - back : 0;
+    }
+    unsigned __int128 ahead =
+        static_cast<unsigned __int128>(dram_cycle - dram_now) << 32;
+    return host_now + static_cast<uint64_t>((ahead + ratio - 1) / ratio);
+}
+}  // namespace
+
+void MemorySystem::SetHostFrequency(double host_mhz) {
+    if (host_mhz > 0) {
+        double dram_mhz = 1000.0 / config_->tCK;
+        host_ratio_ = static_cast<uint64_t>(
+            std::llround(dram_mhz / host_mhz * static_cast<double>(kHostOne)));
+        if (host_ratio_ == 0) {
+            std::cerr << "Host frequency " << host_mhz << "MHz is too high "
+                      << "for a " << dram_mhz << "MHz DRAM clock" << std::endl;
+            AbruptExit(__FILE__, __LINE__);
+        }
+    } else {
+        host_ratio_ = 0;
+    }
+    RegisterCompletionCallback(completion_callback_);
 }
 
-void MemorySystem::ClockTick() { dram_system_->ClockTick(); }
+void MemorySystem::HostClockTick() {
+    host_clk_++;
+    if (host_ratio_ == 0) {
+        ClockTick();
+        return;
+    }
+    host_acc_ += host_ratio_;
+    uint64_t ticks = host_acc_ >> 32;
+    host_acc_ &= kHostOne - 1;
+    for (uint64_t i = 0; i < ticks; i++) {
+        ClockTick();
+    }
+}
+
+void MemorySystem::AdvanceToHostCycle(uint64_t host_cycle) {
+    while (host_clk_ < host_cycle) {
+        HostClockTick();
+    }
+}
+
+uint64_t MemorySystem::GetHostCycle() const { return host_clk_; }
+
+void MemorySystem::HostCompletion(const Completion &done) const {
+    uint64_t dram_now = dram_system_->GetClockCycle();
+    Completion host_done = done;
+    host_done.arrival_cycle =
+        HostCycleOf(done.arrival_cycle, dram_now, host_clk_, host_ratio_);
+    host_done.complete_cycle =
+        HostCycleOf(done.complete_cycle, dram_now, host_clk_, host_ratio_);
+    completion_callback_(host_done);
+}
 
 
 double MemorySystem::GetTCK() const { return config_->tCK; }
@@ -38,8 +140,14 @@ int MemorySystem::GetBusBits() const { return config_->bus_width; }
 
 int MemorySystem::GetBurstLength() const { return config_->BL; }
 
+int MemorySystem::GetBurstCycle() const { return config_->burst_cycle; }
+
+int MemorySystem::GetChannels() const { return config_->channels; }
+
 int MemorySystem::GetQueueSize() const { return config_->trans_queue_size; }
 
+int MemorySystem::GetRequestSize() const { return config_->request_size_bytes; }
+
 void MemorySystem::RegisterCallbacks(
     std::function<void(uint64_t)> read_callback,
     std::function<void(uint64_t)> write_callback) {
@@ -48,11 +156,92 @@ void MemorySystem::RegisterCallbacks(
 
 bool MemorySystem::WillAcceptTransaction(uint64_t hex_addr,
                                          bool is_write) const {
+    if (dram_system_->IsFunctionalMode()) {
+        return true;
+    }
     return dram_system_->WillAcceptTransaction(hex_addr, is_write);
 }
 
 bool MemorySystem::AddTransaction(uint64_t hex_addr, bool is_write) {
-    return dram_system_->AddTransaction(hex_addr, is_write);
+    return AddTransaction(hex_addr, is_write, hex_addr);
+}
+
+bool MemorySystem::AddTransaction(uint64_t hex_addr, bool is_write,
+                                  uint64_t req_id) {
+    if (dram_system_->IsFunctionalMode()) {
+        dram_system_->FunctionalAccess(hex_addr, is_write, req_id, 1);
+        return true;
+    }
+    return dram_system_->AddTransaction(hex_addr, is_write, req_id);
+}
+
+AddResult MemorySystem::TryAddTransaction(uint64_t hex_addr, bool is_write) {
+    return TryAddTransaction(hex_addr, is_write, hex_addr);
+}
+
+AddResult MemorySystem::TryAddTransaction(uint64_t hex_addr, bool is_write,
+                                          uint64_t req_id) {
+    return TryAddTransaction(hex_addr, is_write, req_id, 0);
+}
+
+AddResult MemorySystem::TryAddTransaction(uint64_t hex_addr, bool is_write,
+                                          uint64_t req_id, uint32_t size) {
+    int bursts = dram_system_->BurstsOf(size);
+    if (dram_system_->IsFunctionalMode()) {
+        dram_system_->FunctionalAccess(hex_addr, is_write, req_id, bursts);
+        return AddResult::ACCEPTED;
+    }
+    return dram_system_->TryAddTransaction(hex_addr, is_write, req_id, bursts);
+}
+
+size_t MemorySystem::AddTransactions(const Request *requests, size_t count,
+                                     AddResult *results) {
+    if (dram_system_->IsFunctionalMode()) {
+        for (size_t i = 0; i < count; i++) {
+            dram_system_->FunctionalAccess(
+                requests[i].addr, requests[i].is_write, requests[i].req_id,
+                dram_system_->BurstsOf(requests[i].size));
+            results[i] = AddResult::ACCEPTED;
+        }
+        return count;
+    }
+    dram_system_->TryAddTransactions(requests, count, results);
+    size_t accepted = 0;
+    for (size_t i = 0; i < count; i++) {
+        accepted += IsAccepted(results[i]);
+    }
+    return accepted;
+}
+
+int MemorySystem::GetChannel(uint64_t hex_addr) const {
+    return dram_system_->GetChannel(hex_addr);
+}
+
+int MemorySystem::GetQueueOccupancy(int channel, bool is_write) const {
+    return dram_system_->QueueOccupancy(channel, is_write);
+}
+
+int MemorySystem::GetQueueCapacity(int channel, bool is_write) const {
+    return dram_system_->QueueCapacity(channel, is_write);
+}
+
+void MemorySystem::RegisterCompletionCallback(
+    std::function<void(const Completion &)> completion_callback) {
+    completion_callback_ = completion_callback;
+    if (host_ratio_ != 0 && completion_callback_) {
+        dram_system_->RegisterCompletionCallback(
+            [this](const Completion &done) { HostCompletion(done); });
+    } else {
+        dram_system_->RegisterCompletionCallback(completion_callback_);
+    }
+}
+
+void MemorySystem::SetFunctionalMode(bool functional) {
+    dram_system_->SetFunctionalMode(functional);
+}
+
+bool MemorySystem::IsFunctionalMode() const {
+    return dram_system_->IsFunctionalMode();
 }
 
 void MemorySystem::PrintStats() const { dram_system_->PrintStats(); }
@@ -64,11 +253,86 @@ void MemorySystem::stats_mo(uint64_t cycle)
 
 void MemorySystem::ResetStats() { dram_system_->ResetStats(); }
 
+uint64_t MemorySystem::GetStatCounter(const std::string &name) const {
+    return dram_system_->GetStatCounter(name);
+}
+
+std::string MemorySystem::GetJsonStatsName() const {
+    return outputs_->json_stats_name;
+}
+
+namespace {
+const char kCheckpointMagic[8] = {'D', 'R', 'A', 'M', 'S', '3', 'C', 'K'};
+}  // namespace
+
+bool MemorySystem::SaveCheckpoint(const std::string &path) const {
+    CheckpointWriter ckpt(path);
+    if (!ckpt.IsOpen()) {
+        std::cerr << "Cannot open checkpoint " << path << " for writing"
+                  << std::endl;
+        return false;
+    }
+    ckpt.WriteBytes(kCheckpointMagic, sizeof(kCheckpointMagic));
+    Save(ckpt, kCheckpointVersion);
+    Save(ckpt, ConfigFingerprint(*config_));
+    dram_system_->SaveState(ckpt);
+    Save(ckpt, host_acc_);
+    Save(ckpt, host_clk_);
+    if (!ckpt.Finish()) {
+        std::cerr << "Cannot write checkpoint " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool MemorySystem::RestoreCheckpoint(const std::string &path) {
+    CheckpointReader ckpt(path);
+    if (!ckpt.IsOpen()) {
+        std::cerr << "Cannot open checkpoint " << path << std::endl;
+        return false;
+    }
+    char magic[sizeof(kCheckpointMagic)];
+    ckpt.ReadBytes(magic, sizeof(magic));
+    if (!std::equal(magic, magic + sizeof(magic), kCheckpointMagic)) {
+        std::cerr << path << " is not a DRAMSim3 checkpoint" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    uint32_t version;
+    Load(ckpt, version);
+    if (version != kCheckpointVersion) {
+        std::cerr << "Checkpoint version " << version << " of " << path
+                  << " is not supported, expected " << kCheckpointVersion
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    uint64_t fingerprint;
+    Load(ckpt, fingerprint);
+    if (fingerprint != ConfigFingerprint(*config_)) {
+        std::cerr << "Checkpoint " << path
+                  << " was taken with an incompatible config" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    dram_system_->LoadState(ckpt);
+    Load(ckpt, host_acc_);
+    Load(ckpt, host_clk_);
+    return true;
+}
+
 MemorySystem* GetMemorySystem(const std::string &config_file, const std::string &output_dir,
                  std::function<void(uint64_t)> read_callback,
                  std::function<void(uint64_t)> write_callback) {
     return new MemorySystem(config_file, output_dir, read_callback, write_callback);
 }
+
+MemorySystem *GetMemorySystem(const ConfigOverrides &config_values,
+                              const std::string &output_dir,
+                              std::function<void(uint64_t)> read_callback,
+                              std::function<void(uint64_t)> write_callback) {
+    return new MemorySystem(config_values, output_dir, read_callback,
+                            write_callback);
+}
+
+void DeleteMemorySystem(MemorySystem *memory_system) { delete memory_system; }
 }  // namespace dramsim3
 
 // This function can be used by autoconf AC_CHECK_LIB since
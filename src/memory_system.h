@@ -1,52 +1,12 @@
 #ifndef __MEMORY_SYSTEM__H
 #define __MEMORY_SYSTEM__H
 
-#include <functional>
-#include <string>
+// MemorySystem is declared in the public dramsim3.h, the library itself also
+// gets the types behind its pointers from here
 
 #include "configuration.h"
 #include "dram_system.h"
+#include "dramsim3.h"
 #include "hmc.h"
 
-namespace dramsim3 {
-
-// This should be the interface class that deals with CPU
-class MemorySystem {
-   public:
-    MemorySystem(const std::string &config_file, const std::string &output_dir,
-                 std::function<void(uint64_t)> read_callback,
-                 std::function<void(uint64_t)> write_callback);
-    ~MemorySystem();
-    void ClockTick();
-    void RegisterCallbacks(std::function<void(uint64_t)> read_callback,
-                           std::function<void(uint64_t)> write_callback);
-    double GetTCK() const;
-    uint64_t GetChannelMask() const;
-    uint64_t GetRankMask() const;
-    uint64_t GetBankMask() const;
-    uint64_t GetRowMask() const;
-    int GetBusBits() const;
-    int GetBurstLength() const;
-    int GetQueueSize() const;
-    void PrintStats() const;
-    void stats_mo(uint64_t cycle);
-    void ResetStats();
-
-    bool WillAcceptTransaction(uint64_t hex_addr, bool is_write) const;
-    bool AddTransaction(uint64_t hex_addr, bool is_write);
-
-   private:
-    // These have to be pointers because Gem5 will try to push this object
-    // into container which will invoke a copy constructor, using pointers
-    // here is safe
-    Config *config_;
-    BaseDRAMSystem *dram_system_;
-};
-
-MemorySystem* GetMemorySystem(const std::string &config_file, const std::string &output_dir,
-                 std::function<void(uint64_t)> read_callback,
-                 std::function<void(uint64_t)> write_callback);
-
-}  // namespace dramsim3
-
 #endif
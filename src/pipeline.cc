@@ -0,0 +1,120 @@
+#include "pipeline.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace dramsim3 {
+
+MemoryPipeline::MemoryPipeline(const std::string& config_file,
+                               const std::string& output_dir, uint64_t slack,
+                               size_t ring_size)
+    : memory_system_(config_file, output_dir, [](uint64_t) {},
+                     [](uint64_t) {}),
+      slack_(slack),
+      requests_(ring_size),
+      completions_(ring_size),
+      has_head_(false),
+      horizon_(0),
+      mem_clk_(0),
+      done_(false),
+      stop_(false) {
+    memory_system_.RegisterCompletionCallback(
+        [this](const Completion& done) { PushCompletion(done); });
+}
+
+MemoryPipeline::~MemoryPipeline() {
+    stop_.store(true, std::memory_order_release);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void MemoryPipeline::Start(uint64_t cycles) {
+    thread_ = std::thread(&MemoryPipeline::Run, this, cycles);
+}
+
+bool MemoryPipeline::TrySend(uint64_t addr, bool is_write, uint64_t req_id,
+                             uint64_t cycle) {
+    if (Done()) {
+        return false;
+    }
+    cycle = std::max(cycle, horizon_.load(std::memory_order_relaxed));
+    // publish before waiting on the memory thread, which may need it to get
+    // past the cycles the host is waiting for
+    AdvanceTo(cycle);
+    if (cycle > MemoryCycle() + slack_) {
+        return false;
+    }
+    return requests_.TryPush({addr, req_id, cycle, is_write});
+}
+
+void MemoryPipeline::AdvanceTo(uint64_t cycle) {
+    if (cycle > horizon_.load(std::memory_order_relaxed)) {
+        horizon_.store(cycle, std::memory_order_release);
+    }
+}
+
+void MemoryPipeline::Finish() {
+    horizon_.store(std::numeric_limits<uint64_t>::max(),
+                   std::memory_order_release);
+}
+
+size_t MemoryPipeline::Poll(Completion* out, size_t max) {
+    size_t n = 0;
+    while (n < max && completions_.TryPop(out[n])) {
+        n++;
+    }
+    return n;
+}
+
+void MemoryPipeline::Join() {
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+bool MemoryPipeline::NextDue(uint64_t clk) {
+    while (!has_head_) {
+        if (requests_.TryPop(head_)) {
+            has_head_ = true;
+        } else if (horizon_.load(std::memory_order_acquire) > clk) {
+            // whatever was sent before the horizon moved is in the ring now,
+            // anything sent after it isn't due yet
+            has_head_ = requests_.TryPop(head_);
+            if (!has_head_) {
+                return false;
+            }
+        } else if (stop_.load(std::memory_order_acquire)) {
+            return false;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    return head_.cycle <= clk;
+}
+
+void MemoryPipeline::PushCompletion(const Completion& done) {
+    while (!completions_.TryPush(done) &&
+           !stop_.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+void MemoryPipeline::Run(uint64_t cycles) {
+    for (uint64_t clk = 0; clk < cycles; clk++) {
+        if (stop_.load(std::memory_order_relaxed)) {
+            break;
+        }
+        memory_system_.ClockTick();
+        if (NextDue(clk) &&
+            memory_system_.WillAcceptTransaction(head_.addr, head_.is_write)) {
+            memory_system_.AddTransaction(head_.addr, head_.is_write,
+                                          head_.req_id);
+            has_head_ = false;
+        }
+        mem_clk_.store(clk + 1, std::memory_order_release);
+    }
+    done_.store(true, std::memory_order_release);
+}
+
+}  // namespace dramsim3
@@ -0,0 +1,101 @@
+#ifndef __PIPELINE_H
+#define __PIPELINE_H
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include "memory_system.h"
+#include "spsc_ring.h"
+
+namespace dramsim3 {
+
+// A request on its way to the memory thread, cycle is the earliest DRAM
+// cycle it may be added at
+struct PipelineRequest {
+    uint64_t addr;
+    uint64_t req_id;
+    uint64_t cycle;
+    bool is_write;
+};
+
+// Runs a MemorySystem on its own thread, decoupled from the host that feeds
+// it. Requests go in through one lock-free ring and completion records come
+// back through another, so the host (trace decoding, a request generator,
+// an external driver) and the DRAM model overlap on separate cores.
+//
+// The result is the same as feeding the memory system in lock-step the way
+// TraceBasedCPU does: requests are added in order, each one at the first
+// cycle no earlier than its own cycle where WillAcceptTransaction says yes,
+// at most one per cycle. The memory thread only moves past a cycle once it
+// knows whether a request is due in it, either from the ring or because the
+// host has promised nothing earlier than some later cycle is coming, so
+// thread timing never shows in the results. Request cycles are made non
+// decreasing, which doesn't change when any of them is added.
+//
+// The host may run at most slack cycles ahead of the memory system and at
+// most a ring full of requests. It has to keep polling completions while it
+// waits, the memory thread stalls when the completion ring is full.
+// Host side calls must all come from one thread.
+class MemoryPipeline {
+   public:
+    MemoryPipeline(const std::string& config_file,
+                   const std::string& output_dir, uint64_t slack,
+                   size_t ring_size);
+    ~MemoryPipeline();
+    // starts the memory thread, which simulates cycles cycles and stops
+    void Start(uint64_t cycles);
+
+    // false if the request can't go in yet, because the ring is full or it
+    // is more than slack cycles ahead of the memory system, or because the
+    // memory system has stopped
+    bool TrySend(uint64_t addr, bool is_write, uint64_t req_id,
+                 uint64_t cycle);
+    // nothing due before cycle is coming, lets the memory thread run up to
+    // it without waiting for the next request
+    void AdvanceTo(uint64_t cycle);
+    // no more requests at all
+    void Finish();
+    // moves up to max finished requests into out, in completion order
+    size_t Poll(Completion* out, size_t max);
+    // the memory thread has simulated all its cycles
+    bool Done() const { return done_.load(std::memory_order_acquire); }
+    // DRAM cycles simulated so far
+    uint64_t MemoryCycle() const {
+        return mem_clk_.load(std::memory_order_acquire);
+    }
+
+    // joins the memory thread once Done(), completions still in the ring
+    // stay there for Poll
+    void Join();
+    // only once joined
+    void PrintStats() const { memory_system_.PrintStats(); }
+    uint64_t GetStatCounter(const std::string& name) const {
+        return memory_system_.GetStatCounter(name);
+    }
+
+   private:
+    void Run(uint64_t cycles);
+    // the next request if one is due at clk, waits until that is known
+    bool NextDue(uint64_t clk);
+    void PushCompletion(const Completion& done);
+
+    MemorySystem memory_system_;
+    uint64_t slack_;
+    SPSCRing<PipelineRequest> requests_;
+    SPSCRing<Completion> completions_;
+    std::thread thread_;
+
+    // memory side
+    PipelineRequest head_;
+    bool has_head_;
+
+    // no request due before horizon_ is still to come
+    std::atomic<uint64_t> horizon_;
+    std::atomic<uint64_t> mem_clk_;
+    std::atomic<bool> done_;
+    std::atomic<bool> stop_;  // set by the destructor
+};
+
+}  // namespace dramsim3
+#endif
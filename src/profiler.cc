@@ -0,0 +1,41 @@
+#include "profiler.h"
+#include "fmt/format.h"
+
+namespace dramsim3 {
+
+namespace {
+const char* kPhaseNames[] = {"clock_tick",     "refresh",    "cmd_select",
+                             "schedule_trans", "calc_stats", "return_trans",
+                             "epoch_stats"};
+}  // namespace
+
+void PhaseProfiler::Merge(const PhaseProfiler& other) {
+    for (size_t i = 0; i < ticks_.size(); i++) {
+        ticks_[i] += other.ticks_[i];
+        calls_[i] += other.calls_[i];
+    }
+}
+
+// ClockTick covers refresh, command selection, scheduling and stats, the
+// transaction return and epoch printing happen outside of it, so the total is
+// ClockTick plus those two and everything is shown as a share of that
+void PhaseProfiler::Print(std::ostream& where, const std::string& title) const {
+    uint64_t total = Ticks(ProfPhase::CLOCK_TICK) +
+                     Ticks(ProfPhase::RETURN_TRANS) +
+                     Ticks(ProfPhase::EPOCH_STATS);
+    where << fmt::format("{:<16}{:>16}{:>14}{:>12}{:>9}", title, "ticks",
+                         "calls", "ticks/call", "share")
+          << std::endl;
+    for (int i = 0; i < static_cast<int>(ProfPhase::SIZE); i++) {
+        double per_call =
+            calls_[i] == 0 ? 0.0 : static_cast<double>(ticks_[i]) / calls_[i];
+        double share =
+            total == 0 ? 0.0 : 100.0 * static_cast<double>(ticks_[i]) / total;
+        where << fmt::format("  {:<14}{:>16}{:>14}{:>12.1f}{:>8.1f}%",
+                             kPhaseNames[i], ticks_[i], calls_[i], per_call,
+                             share)
+              << std::endl;
+    }
+}
+
+}  // namespace dramsim3
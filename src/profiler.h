@@ -0,0 +1,87 @@
+#ifndef __PROFILER_H
+#define __PROFILER_H
+
+#include <stdint.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace dramsim3 {
+
+// Hot path phases that the self-profiler keeps apart
+enum class ProfPhase {
+    CLOCK_TICK,  // whole Controller::ClockTick, includes the ones below
+    REFRESH,
+    CMD_SELECT,
+    SCHEDULE_TRANS,
+    CALC_STATS,
+    RETURN_TRANS,
+    EPOCH_STATS,
+    SIZE
+};
+
+// rdtsc where available since it is a handful of cycles, otherwise fall back
+// to steady_clock nanoseconds
+inline uint64_t ReadProfTicks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+}
+
+class PhaseProfiler {
+   public:
+    PhaseProfiler()
+        : ticks_(static_cast<int>(ProfPhase::SIZE), 0),
+          calls_(static_cast<int>(ProfPhase::SIZE), 0) {}
+    void Add(ProfPhase phase, uint64_t ticks) {
+        ticks_[static_cast<int>(phase)] += ticks;
+        calls_[static_cast<int>(phase)] += 1;
+    }
+    void Merge(const PhaseProfiler& other);
+    uint64_t Ticks(ProfPhase phase) const {
+        return ticks_[static_cast<int>(phase)];
+    }
+    uint64_t Calls(ProfPhase phase) const {
+        return calls_[static_cast<int>(phase)];
+    }
+    void Print(std::ostream& where, const std::string& title) const;
+
+   private:
+    std::vector<uint64_t> ticks_;
+    std::vector<uint64_t> calls_;
+};
+
+class ScopedPhaseTimer {
+   public:
+    ScopedPhaseTimer(PhaseProfiler& profiler, ProfPhase phase)
+        : profiler_(profiler), phase_(phase), start_(ReadProfTicks()) {}
+    ~ScopedPhaseTimer() { profiler_.Add(phase_, ReadProfTicks() - start_); }
+
+   private:
+    PhaseProfiler& profiler_;
+    ProfPhase phase_;
+    uint64_t start_;
+};
+
+}  // namespace dramsim3
+
+// Only compiled in with SELF_PROFILE, otherwise the scopes vanish entirely
+#ifdef SELF_PROFILE
+#define PROF_CONCAT_INNER(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(profiler, phase) \
+    dramsim3::ScopedPhaseTimer PROF_CONCAT(prof_timer_, __LINE__)(profiler, phase)
+#else
+#define PROFILE_SCOPE(profiler, phase)
+#endif  // SELF_PROFILE
+
+#endif
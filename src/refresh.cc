@@ -81,4 +81,18 @@ void Refresh::IterateNext() {
     }
 }
 
+void Refresh::SaveState(CheckpointWriter &ckpt) const {
+    Save(ckpt, clk_);
+    Save(ckpt, next_rank_);
+    Save(ckpt, next_bg_);
+    Save(ckpt, next_bank_);
+}
+
+void Refresh::LoadState(CheckpointReader &ckpt) {
+    Load(ckpt, clk_);
+    Load(ckpt, next_rank_);
+    Load(ckpt, next_bg_);
+    Load(ckpt, next_bank_);
+}
+
 }  // namespace dramsim3
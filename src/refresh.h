@@ -12,6 +12,8 @@ class Refresh {
    public:
     Refresh(const Config& config, ChannelState& channel_state);
     void ClockTick();
+    void SaveState(CheckpointWriter& ckpt) const;
+    void LoadState(CheckpointReader& ckpt);
 
    private:
     uint64_t clk_;
@@ -0,0 +1,55 @@
+#ifndef __REQUEST_TYPES_H
+#define __REQUEST_TYPES_H
+
+#include <stdint.h>
+
+// Types the host exchanges with a memory system, shared by common.h and the
+// public dramsim3.h so there is only one definition of each
+
+namespace dramsim3 {
+
+// How a request was served, as reported in its Completion. Writes are
+// posted, they complete once buffered and before they reach any row.
+enum class ServedBy { ROW_HIT, ROW_MISS, WRITE_FORWARD, WRITE_POSTED };
+
+// What the host gets back for every finished request, the cycles are
+// memory cycles of the system the request went to, or host cycles once
+// SetHostFrequency has given the memory system a host clock
+struct Completion {
+    uint64_t req_id;  // as given to AddTransaction, the address if none was
+    uint64_t addr;
+    bool is_write;
+    uint64_t arrival_cycle;
+    uint64_t complete_cycle;
+    ServedBy served_by;
+};
+
+// What TryAddTransaction did with a request. MERGED and FORWARDED requests
+// take no queue slot, so they are accepted even when their queue is full:
+// a write to an address that already has a write buffered, a read to an
+// address with a read already waiting (both MERGED), and a read served
+// from the write buffer (FORWARDED). With a unified queue a full queue is
+// READ_QUEUE_FULL for both reads and writes.
+enum class AddResult {
+    ACCEPTED,
+    MERGED,
+    FORWARDED,
+    READ_QUEUE_FULL,
+    WRITE_BUFFER_FULL
+};
+
+inline bool IsAccepted(AddResult result) {
+    return result != AddResult::READ_QUEUE_FULL &&
+           result != AddResult::WRITE_BUFFER_FULL;
+}
+
+// One request of a batch handed to AddTransactions
+struct Request {
+    uint64_t addr;
+    bool is_write;
+    uint64_t req_id;  // comes back in the Completion
+    uint32_t size;    // bytes, 0 for one burst, see TryAddTransaction
+};
+
+}  // namespace dramsim3
+#endif
@@ -0,0 +1,301 @@
+#include "sampling.h"
+
+#include <algorithm>
+#include <cmath>
+#include "fmt/format.h"
+
+namespace dramsim3 {
+
+namespace {
+// a controller that takes nothing for this many refresh cycles is stuck
+const uint64_t kStallRefreshes = 1000;
+
+// two-sided z scores of the confidence levels we support
+double ZScore(double confidence) {
+    const std::vector<std::pair<double, double>> z_table = {
+        {0.80, 1.282}, {0.90, 1.645}, {0.95, 1.960}, {0.98, 2.326},
+        {0.99, 2.576}, {0.997, 2.968}, {0.999, 3.291}};
+    for (const auto& level_z : z_table) {
+        if (std::fabs(level_z.first - confidence) < 1e-6) {
+            return level_z.second;
+        }
+    }
+    std::cerr << "Unsupported confidence level " << confidence
+              << ", use one of 0.8 0.9 0.95 0.98 0.99 0.997 0.999"
+              << std::endl;
+    AbruptExit(__FILE__, __LINE__);
+    return 0.0;
+}
+
+SampleEstimate EstimateOf(const std::string& name,
+                          const std::vector<double>& samples, double z) {
+    SampleEstimate est = {name, 0.0, 0.0, 0.0, 0.0};
+    if (samples.empty()) {
+        return est;
+    }
+    double n = static_cast<double>(samples.size());
+    for (auto val : samples) {
+        est.mean += val;
+    }
+    est.mean /= n;
+    if (samples.size() > 1) {
+        double var = 0.0;
+        for (auto val : samples) {
+            var += (val - est.mean) * (val - est.mean);
+        }
+        est.stddev = std::sqrt(var / (n - 1));
+    }
+    est.half_width = z * est.stddev / std::sqrt(n);
+    est.rel_error = est.mean == 0.0 ? 0.0 : est.half_width / est.mean;
+    return est;
+}
+}  // namespace
+
+SamplingSim::SamplingSim(const std::string& config_file,
+                         const std::string& output_dir,
+                         const std::string& trace_file,
+                         const SamplingParams& params)
+    : config_(std::make_shared<const Config>(config_file, output_dir)),
+      trace_file_(trace_file),
+      params_(params),
+      z_(ZScore(params.confidence)),
+      trace_reqs_(0),
+      has_trans_(false),
+      clk_(0),
+      time_offset_(0),
+      measuring_(false),
+      stall_cycles_(kStallRefreshes * static_cast<uint64_t>(config_->tRFC)),
+      passes_(0),
+      num_samples_(0),
+      detailed_reqs_(0) {
+    // one cheap pass to know how long the trace is so the samples can be
+    // spread evenly over it
+    trace_.open(trace_file_);
+    if (trace_.fail()) {
+        std::cerr << "Trace file does not exist" << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    while (trace_ >> trans_) {
+        trace_reqs_++;
+    }
+    trace_.close();
+    if (params_.unit_size == 0 || params_.initial_samples <= 0) {
+        std::cerr << "Sampling needs a non-empty unit and at least one sample"
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+}
+
+void SamplingSim::ReadCallBack(uint64_t addr) {
+    // functional accesses call back right away, nothing to measure
+    if (memory_system_->IsFunctionalMode()) {
+        return;
+    }
+    auto it = inflight_reads_.find(addr);
+    if (it == inflight_reads_.end()) {
+        return;
+    }
+    if (measuring_) {
+        latencies_.push_back(clk_ - it->second.front());
+    }
+    it->second.pop_front();
+    if (it->second.empty()) {
+        inflight_reads_.erase(it);
+    }
+}
+
+void SamplingSim::WriteCallBack(uint64_t addr) { return; }
+
+bool SamplingSim::NextTrans() {
+    has_trans_ = static_cast<bool>(trace_ >> trans_);
+    return has_trans_;
+}
+
+void SamplingSim::FastForward(uint64_t num_reqs) {
+    memory_system_->SetFunctionalMode(true);
+    for (uint64_t i = 0; i < num_reqs && has_trans_; i++) {
+        memory_system_->AddTransaction(trans_.addr, trans_.is_write);
+        NextTrans();
+    }
+}
+
+// Same injection as TraceBasedCPU, at most one request per cycle and never
+// ahead of its trace time
+void SamplingSim::Detailed(uint64_t num_reqs) {
+    memory_system_->SetFunctionalMode(false);
+    if (!has_trans_) {
+        return;
+    }
+    time_offset_ = static_cast<int64_t>(trans_.added_cycle) -
+                   static_cast<int64_t>(clk_);
+    uint64_t injected = 0;
+    uint64_t stalled = 0;  // cycles the next request was due but refused
+    while (injected < num_reqs && has_trans_) {
+        memory_system_->ClockTick();
+        if (static_cast<int64_t>(trans_.added_cycle) - time_offset_ <=
+            static_cast<int64_t>(clk_)) {
+            if (memory_system_->WillAcceptTransaction(trans_.addr,
+                                                      trans_.is_write)) {
+                memory_system_->AddTransaction(trans_.addr, trans_.is_write);
+                if (!trans_.is_write) {
+                    inflight_reads_[trans_.addr].push_back(clk_);
+                }
+                injected++;
+                stalled = 0;
+                NextTrans();
+            } else if (++stalled > stall_cycles_) {
+                std::cerr << "The memory system took no request for "
+                          << stalled << " cycles, stuck on "
+                          << (trans_.is_write ? "WRITE " : "READ ") << "0x"
+                          << std::hex << trans_.addr << std::dec
+                          << " at cycle " << clk_ << std::endl;
+                AbruptExit(__FILE__, __LINE__);
+            }
+        }
+        clk_++;
+    }
+    detailed_reqs_ += injected;
+}
+
+uint64_t SamplingSim::RowHits() const {
+    return memory_system_->GetStatCounter("num_read_row_hits") +
+           memory_system_->GetStatCounter("num_write_row_hits");
+}
+
+uint64_t SamplingSim::RowAccesses() const {
+    return memory_system_->GetStatCounter("num_read_cmds") +
+           memory_system_->GetStatCounter("num_write_cmds");
+}
+
+void SamplingSim::RunPass(int num_samples) {
+    // the old one has to give up its output prefix first, otherwise the new
+    // one gets another
+    memory_system_.reset();
+    memory_system_.reset(new MemorySystem(
+        config_,
+        std::bind(&SamplingSim::ReadCallBack, this, std::placeholders::_1),
+        std::bind(&SamplingSim::WriteCallBack, this, std::placeholders::_1)));
+    request_size_ =
+        memory_system_->GetBusBits() / 8 * memory_system_->GetBurstLength();
+    trace_.clear();
+    trace_.open(trace_file_);
+    NextTrans();
+
+    clk_ = 0;
+    inflight_reads_.clear();
+    detailed_reqs_ = 0;
+    sample_cpr_.clear();
+    sample_latency_.clear();
+    sample_row_hit_.clear();
+    num_samples_ = num_samples;
+
+    uint64_t period = trace_reqs_ / num_samples;
+    uint64_t detailed = params_.warm_size + params_.unit_size;
+    uint64_t fast_forward = period > detailed ? period - detailed : 0;
+    for (int i = 0; i < num_samples && has_trans_; i++) {
+        FastForward(fast_forward);
+        Detailed(params_.warm_size);
+
+        uint64_t start_clk = clk_;
+        uint64_t start_hits = RowHits();
+        uint64_t start_cmds = RowAccesses();
+        latencies_.clear();
+        measuring_ = true;
+        Detailed(params_.unit_size);
+        measuring_ = false;
+
+        uint64_t cycles = clk_ - start_clk;
+        uint64_t hits = RowHits() - start_hits;
+        uint64_t cmds = RowAccesses() - start_cmds;
+        sample_cpr_.push_back(static_cast<double>(cycles) /
+                              params_.unit_size);
+        if (!latencies_.empty()) {
+            double sum = 0.0;
+            for (auto l : latencies_) {
+                sum += l;
+            }
+            sample_latency_.push_back(sum / latencies_.size());
+        }
+        if (cmds > 0) {
+            sample_row_hit_.push_back(static_cast<double>(hits) / cmds);
+        }
+    }
+    // rest of the trace only warms state for the final stats
+    FastForward(trace_reqs_);
+    memory_system_->SetFunctionalMode(false);
+    trace_.close();
+}
+
+void SamplingSim::Estimate() {
+    estimates_.clear();
+    // like CPI in SMARTS, time per request is what averages correctly over
+    // equally sized units, bandwidth is derived from it
+    auto cpr = EstimateOf("cycles_per_request", sample_cpr_, z_);
+    estimates_.push_back(cpr);
+    SampleEstimate bw = {"bandwidth(GB/s)", 0.0, 0.0, 0.0, cpr.rel_error};
+    if (cpr.mean > 0.0) {
+        bw.mean = request_size_ / (cpr.mean * memory_system_->GetTCK());
+        bw.stddev = bw.mean * cpr.stddev / cpr.mean;
+        bw.half_width = bw.mean * cpr.rel_error;
+    }
+    estimates_.push_back(bw);
+    estimates_.push_back(
+        EstimateOf("read_latency(cycles)", sample_latency_, z_));
+    estimates_.push_back(EstimateOf("row_hit_rate", sample_row_hit_, z_));
+}
+
+void SamplingSim::Run() {
+    uint64_t detailed = params_.warm_size + params_.unit_size;
+    int max_samples =
+        static_cast<int>(std::max(trace_reqs_ / detailed, uint64_t(1)));
+    int num_samples = std::min(params_.initial_samples, max_samples);
+    for (passes_ = 1; passes_ <= params_.max_passes; passes_++) {
+        RunPass(num_samples);
+        Estimate();
+
+        // SMARTS: n >= (z * V / e)^2 where V is the coefficient of variation
+        int needed = num_samples;
+        for (const auto& est : estimates_) {
+            // bandwidth is derived from cycles per request
+            if (est.name == "bandwidth(GB/s)") {
+                continue;
+            }
+            if (est.rel_error > params_.target_error && est.mean != 0.0) {
+                double cv = est.stddev / est.mean;
+                double n = std::pow(z_ * cv / params_.target_error, 2);
+                needed = std::max(needed, static_cast<int>(std::ceil(n)));
+            }
+        }
+        if (needed <= num_samples || num_samples == max_samples ||
+            passes_ == params_.max_passes) {
+            break;
+        }
+        num_samples = std::min(needed, max_samples);
+    }
+}
+
+void SamplingSim::PrintReport(std::ostream& where) const {
+    where << fmt::format(
+                 "{} requests, {} samples of {}+{} requests, {} pass(es), "
+                 "{:.2f}% simulated in detail",
+                 trace_reqs_, num_samples_, params_.warm_size,
+                 params_.unit_size, passes_,
+                 trace_reqs_ == 0 ? 0.0 : 100.0 * detailed_reqs_ / trace_reqs_)
+          << std::endl;
+    where << fmt::format("{:<24}{:>12}{:>14}{:>12}{:>8}", "metric", "mean",
+                         "+/-", "rel_error", "met")
+          << std::endl;
+    for (const auto& est : estimates_) {
+        where << fmt::format("{:<24}{:>12.4f}{:>14.4f}{:>11.2f}%{:>8}",
+                             est.name, est.mean, est.half_width,
+                             est.rel_error * 100,
+                             est.rel_error <= params_.target_error ? "yes"
+                                                                   : "no")
+              << std::endl;
+    }
+    where << fmt::format("confidence {:.1f}%, target error {:.2f}%",
+                         params_.confidence * 100, params_.target_error * 100)
+          << std::endl;
+}
+
+}  // namespace dramsim3
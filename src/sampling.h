@@ -0,0 +1,93 @@
+#ifndef __SAMPLING_H
+#define __SAMPLING_H
+
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "memory_system.h"
+
+namespace dramsim3 {
+
+struct SamplingParams {
+    uint64_t unit_size;    // requests measured per sample
+    uint64_t warm_size;    // detailed requests simulated before each sample
+    int initial_samples;   // samples taken in the first pass
+    double target_error;   // relative half width of the confidence interval
+    double confidence;     // e.g. 0.997 for 3 sigma
+    int max_passes;
+};
+
+// Estimate of one metric over all samples of a pass
+struct SampleEstimate {
+    std::string name;
+    double mean;
+    double stddev;
+    double half_width;  // of the confidence interval
+    double rel_error;   // half_width / mean
+};
+
+// SMARTS style sampled simulation of a trace. The trace is split into
+// num_samples equal periods, in each period the requests are run through
+// functional warmup until the last warm_size + unit_size requests, the
+// warm_size requests are then simulated in detail to fill the queues and the
+// unit_size requests after them are measured. Cycles per request (and the
+// bandwidth that follows from it), read latency and row hit rate are
+// estimated from the per-sample values. When a metric
+// misses the target error the whole trace is run again with the number of
+// samples the measured variation calls for.
+class SamplingSim {
+   public:
+    SamplingSim(const std::string& config_file, const std::string& output_dir,
+                const std::string& trace_file, const SamplingParams& params);
+    void Run();
+    void PrintReport(std::ostream& where) const;
+    void PrintStats() { memory_system_->PrintStats(); }
+
+   private:
+    void ReadCallBack(uint64_t addr);
+    void WriteCallBack(uint64_t addr);
+    bool NextTrans();
+    void FastForward(uint64_t num_reqs);
+    void Detailed(uint64_t num_reqs);
+    uint64_t RowHits() const;
+    uint64_t RowAccesses() const;
+    void RunPass(int num_samples);
+    void Estimate();
+
+    // parsed once, every pass builds its memory system from it
+    std::shared_ptr<const Config> config_;
+    std::string trace_file_;
+    SamplingParams params_;
+    double z_;
+    uint64_t trace_reqs_;
+
+    std::unique_ptr<MemorySystem> memory_system_;
+    std::ifstream trace_;
+    Transaction trans_;
+    bool has_trans_;
+
+    uint64_t clk_;
+    // trace time minus memory system time, re-anchored at every detailed
+    // interval since the memory system doesn't advance in functional mode
+    int64_t time_offset_;
+    bool measuring_;
+    std::unordered_map<uint64_t, std::deque<uint64_t>> inflight_reads_;
+    std::vector<uint64_t> latencies_;
+
+    int request_size_;
+    // cycles a due request may go unaccepted before the run is given up
+    uint64_t stall_cycles_;
+    int passes_;
+    int num_samples_;
+    uint64_t detailed_reqs_;
+    std::vector<double> sample_cpr_;
+    std::vector<double> sample_latency_;
+    std::vector<double> sample_row_hit_;
+    std::vector<SampleEstimate> estimates_;
+};
+
+}  // namespace dramsim3
+#endif
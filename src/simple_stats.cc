@@ -16,8 +16,15 @@ void PrintStatText(std::ostream& where, std::string name, T value,
     return;
 }
 
-SimpleStats::SimpleStats(const Config& config, int channel_id)
-    : config_(config), channel_id_(channel_id) {
+// precharges that closed a row for a queued READ/WRITE to another row, per
+// READ/WRITE command
+double RowConflictRate(uint64_t conflicts, uint64_t rw_cmds) {
+    return rw_cmds > 0 ? static_cast<double>(conflicts) / rw_cmds : 0.0;
+}
+
+SimpleStats::SimpleStats(const Config& config, const OutputNames& outputs,
+                         int channel_id)
+    : config_(config), outputs_(outputs), channel_id_(channel_id) {
     // counter stats
     InitStat("num_cycles", "counter", "Number of DRAM cycles");
     InitStat("epoch_num", "counter", "Number of epochs");
@@ -37,6 +44,10 @@ SimpleStats::SimpleStats(const Config& config, int channel_id)
     InitStat("num_srefe_cmds", "counter", "Number of SREFE commands");
     InitStat("num_srefx_cmds", "counter", "Number of SREFX commands");
     InitStat("hbm_dual_cmds", "counter", "Number of cycles dual cmds issued");
+    InitStat("num_warmup_accesses", "counter",
+             "Number of functional warmup accesses");
+    InitStat("num_warmup_row_hits", "counter",
+             "Number of functional warmup row buffer hits");
 
     // double stats
     InitStat("act_energy", "double", "Activation energy");
@@ -71,6 +82,8 @@ SimpleStats::SimpleStats(const Config& config, int channel_id)
     InitStat("average_bandwidth", "calculated", "Average bandwidth");
     InitStat("total_energy", "calculated", "Total energy (pJ)");
     InitStat("average_power", "calculated", "Average power (mW)");
+    InitStat("row_conflict_rate", "calculated",
+             "Share of READ/WRITE commands that closed another row first");
     InitStat("average_read_latency", "calculated",
              "Average read request latency (cycles)");
     InitStat("average_interarrival", "calculated",
@@ -125,7 +138,7 @@ std::string SimpleStats::GetTextHeader(bool is_final) const {
 void SimpleStats::PrintEpochStats() {
     UpdateEpochStats();
     if (config_.output_level >= 1) {
-        std::ofstream j_out(config_.json_epoch_name, std::ofstream::app);
+        std::ofstream j_out(outputs_.json_epoch_name, std::ofstream::app);
         j_out << j_data_;
     }
     if (config_.output_level >= 2) {
@@ -142,7 +155,7 @@ void SimpleStats::PrintFinalStats() {
     UpdateFinalStats();
 
     if (config_.output_level >= 0) {
-        std::ofstream j_out(config_.json_stats_name, std::ofstream::app);
+        std::ofstream j_out(outputs_.json_stats_name, std::ofstream::app);
         j_out << "\"" << std::to_string(channel_id_) << "\":";
         j_out << j_data_;
     }
@@ -150,7 +163,7 @@ void SimpleStats::PrintFinalStats() {
     if (config_.output_level >= 1) {
         // HACK: overwrite existing file if this is first channel
         auto perm = channel_id_ == 0 ? std::ofstream::out : std::ofstream::app;
-        std::ofstream txt_out(config_.txt_stats_name, perm);
+        std::ofstream txt_out(outputs_.txt_stats_name, perm);
         txt_out << GetTextHeader(true);
         for (const auto& it : print_pairs_) {
             PrintStatText(txt_out, it.first, it.second,
@@ -436,6 +449,10 @@ void SimpleStats::UpdateEpochStats() {
                           doubles_["refb_energy"] + background_energy;
     calculated_["total_energy"] = total_energy;
     calculated_["average_power"] = total_energy / epoch_counters_["num_cycles"];
+    calculated_["row_conflict_rate"] =
+        RowConflictRate(epoch_counters_["num_ondemand_pres"],
+                        epoch_counters_["num_read_cmds"] +
+                            epoch_counters_["num_write_cmds"]);
     calculated_["average_read_latency"] =
         GetHistoAvg(epoch_histo_counts_.at("read_latency"));
     calculated_["average_interarrival"] =
@@ -497,6 +514,10 @@ void SimpleStats::UpdateFinalStats() {
                           doubles_["refb_energy"] + background_energy;
     calculated_["total_energy"] = total_energy;
     calculated_["average_power"] = total_energy / counters_["num_cycles"];
+    calculated_["row_conflict_rate"] =
+        RowConflictRate(counters_["num_ondemand_pres"],
+                        counters_["num_read_cmds"] +
+                            counters_["num_write_cmds"]);
     calculated_["average_read_latency"] =
         GetHistoAvg(histo_counts_.at("read_latency"));
     calculated_["average_interarrival"] =
@@ -506,4 +527,24 @@ void SimpleStats::UpdateFinalStats() {
     return;
 }
 
+void SimpleStats::SaveState(CheckpointWriter& ckpt) const {
+    Save(ckpt, counters_);
+    Save(ckpt, epoch_counters_);
+    Save(ckpt, vec_counters_);
+    Save(ckpt, epoch_vec_counters_);
+    Save(ckpt, histo_counts_);
+    Save(ckpt, epoch_histo_counts_);
+    Save(ckpt, histo_bins_);
+}
+
+void SimpleStats::LoadState(CheckpointReader& ckpt) {
+    Load(ckpt, counters_);
+    Load(ckpt, epoch_counters_);
+    Load(ckpt, vec_counters_);
+    Load(ckpt, epoch_vec_counters_);
+    Load(ckpt, histo_counts_);
+    Load(ckpt, epoch_histo_counts_);
+    Load(ckpt, histo_bins_);
+}
+
 }  // namespace dramsim3
@@ -6,6 +6,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include "checkpoint.h"
 #include "configuration.h"
 #include "json.hpp"
 
@@ -13,10 +14,16 @@ namespace dramsim3 {
 
 class SimpleStats {
    public:
-    SimpleStats(const Config& config, int channel_id);
+    SimpleStats(const Config& config, const OutputNames& outputs,
+                int channel_id);
     // incrementing counter
     void Increment(const std::string name) { epoch_counters_[name] += 1; }
 
+    // increment counter by number
+    void IncrementBy(const std::string name, int num) {
+        epoch_counters_[name] += num;
+    }
+
     // incrementing for vec counter
     void IncrementVec(const std::string name, int pos) {
         epoch_vec_counters_[name][pos] += 1;
@@ -39,6 +46,16 @@ class SimpleStats {
     // Reset (usually after one phase of simulation)
     void Reset();
 
+    // current value of a counter, including the ongoing epoch
+    uint64_t GetCounter(const std::string& name) const {
+        return counters_.at(name) + epoch_counters_.at(name);
+    }
+
+    // only the accumulating counters are saved, everything else is derived
+    // from them when stats are printed
+    void SaveState(CheckpointWriter& ckpt) const;
+    void LoadState(CheckpointReader& ckpt);
+
     //MZOU
     // 返回read_cmds, write_cmds, read_row_hits, write_row_hits
     uint64_t GetReadCmds() const;
@@ -72,6 +89,7 @@ class SimpleStats {
     void UpdateFinalStats();
 
     const Config& config_;
+    const OutputNames& outputs_;
     int channel_id_;
 
     // map names to descriptions
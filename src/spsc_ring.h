@@ -0,0 +1,72 @@
+#ifndef __SPSC_RING_H
+#define __SPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace dramsim3 {
+
+// Bounded lock-free queue between exactly one producer thread and one
+// consumer thread. The capacity is rounded up to a power of two. Each side
+// keeps a cached copy of the other side's index and only reloads it when the
+// ring looks full (or empty), so the shared indices bounce between the cores
+// once per wrap instead of once per element.
+template <typename T>
+class SPSCRing {
+   public:
+    explicit SPSCRing(size_t capacity)
+        : head_(0), cached_tail_(0), tail_(0), cached_head_(0) {
+        size_t size = 2;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        buffer_.resize(size);
+        mask_ = size - 1;
+    }
+    SPSCRing(const SPSCRing&) = delete;
+    SPSCRing& operator=(const SPSCRing&) = delete;
+
+    size_t Capacity() const { return mask_ + 1; }
+
+    // producer side, false if full
+    bool TryPush(const T& value) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ == Capacity()) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ == Capacity()) {
+                return false;
+            }
+        }
+        buffer_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side, false if empty
+    bool TryPop(T& value) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_) {
+                return false;
+            }
+        }
+        value = buffer_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+   private:
+    std::vector<T> buffer_;
+    size_t mask_;
+    // consumer owned, padded so the two sides don't share a cache line
+    alignas(64) std::atomic<size_t> head_;
+    size_t cached_tail_;
+    // producer owned
+    alignas(64) std::atomic<size_t> tail_;
+    size_t cached_head_;
+};
+
+}  // namespace dramsim3
+#endif
@@ -0,0 +1,276 @@
+#include "sweep.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include "cpu.h"
+#include "fmt/format.h"
+#include "json.hpp"
+
+namespace dramsim3 {
+
+namespace {
+std::string Trim(const std::string& str) {
+    auto start = str.find_first_not_of(" \t\r\n");
+    if (start == std::string::npos) {
+        return "";
+    }
+    auto end = str.find_last_not_of(" \t\r\n");
+    return str.substr(start, end - start + 1);
+}
+
+bool ParseInteger(const std::string& str, long long& val) {
+    const char* start = str.c_str();
+    char* end;
+    val = std::strtoll(start, &end, 0);
+    return end > start && *end == '\0';
+}
+
+bool ParseReal(const std::string& str, double& val) {
+    const char* start = str.c_str();
+    char* end;
+    val = std::strtod(start, &end);
+    return end > start && *end == '\0';
+}
+
+void BadSweep(const std::string& key, const std::string& spec) {
+    std::cerr << "Can't expand sweep " << key << " = {" << spec
+              << "}, use {a, b, c}, {start:stop} or {start:stop:step}"
+              << std::endl;
+    AbruptExit(__FILE__, __LINE__);
+}
+
+// values of one {} spec, ranges include stop when the steps land on it
+std::vector<std::string> ExpandSweep(const std::string& key,
+                                     const std::string& spec) {
+    std::vector<std::string> values;
+    if (spec.find(':') == std::string::npos) {
+        for (const auto& item : StringSplit(spec, ',')) {
+            if (!Trim(item).empty()) {
+                values.push_back(Trim(item));
+            }
+        }
+        if (values.empty()) {
+            BadSweep(key, spec);
+        }
+        return values;
+    }
+
+    auto parts = StringSplit(spec, ':');
+    if (parts.size() < 2 || parts.size() > 3) {
+        BadSweep(key, spec);
+    }
+    for (auto& part : parts) {
+        part = Trim(part);
+    }
+    long long start, stop, step = 1;
+    if (ParseInteger(parts[0], start) && ParseInteger(parts[1], stop) &&
+        (parts.size() == 2 || ParseInteger(parts[2], step))) {
+        if (step == 0 || (step > 0 && stop < start) ||
+            (step < 0 && stop > start)) {
+            BadSweep(key, spec);
+        }
+        for (long long val = start; step > 0 ? val <= stop : val >= stop;
+             val += step) {
+            values.push_back(std::to_string(val));
+        }
+        return values;
+    }
+    double real_start, real_stop, real_step = 1.0;
+    if (!ParseReal(parts[0], real_start) || !ParseReal(parts[1], real_stop) ||
+        (parts.size() == 3 && !ParseReal(parts[2], real_step)) ||
+        real_step == 0.0 || (real_stop - real_start) / real_step < 0.0) {
+        BadSweep(key, spec);
+    }
+    // count the steps up front so rounding can't add or drop the last one
+    int steps = static_cast<int>((real_stop - real_start) / real_step + 1e-9);
+    for (int i = 0; i <= steps; i++) {
+        values.push_back(fmt::format("{}", real_start + i * real_step));
+    }
+    return values;
+}
+}  // namespace
+
+SweepResult SimulatePoint(std::shared_ptr<const Config> config,
+                          const std::string& trace_file,
+                          const std::string& stream_type, uint64_t cycles) {
+    double tck = config->tCK;
+    int request_size = config->bus_width / 8 * config->BL;
+
+    std::unique_ptr<CPU> cpu;
+    if (!trace_file.empty()) {
+        cpu.reset(new TraceBasedCPU(config, trace_file));
+    } else if (stream_type == "stream" || stream_type == "s") {
+        cpu.reset(new StreamCPU(config));
+    } else {
+        cpu.reset(new RandomCPU(config));
+    }
+    // the name is only final once the memory system claimed it
+    std::string stats_file = cpu->GetJsonStatsName();
+    for (uint64_t clk = 0; clk < cycles; clk++) {
+        cpu->ClockTick();
+    }
+    cpu->PrintStats();
+
+    // per channel stats as written by PrintStats
+    SweepResult result = {cycles, 0, 0, 0.0, 0.0, 0.0};
+    std::ifstream stats_in(stats_file);
+    nlohmann::json stats = nlohmann::json::parse(stats_in, nullptr, false);
+    uint64_t cmds = 0, hits = 0;
+    double latency_sum = 0.0;
+    if (stats.is_object()) {
+        for (const auto& channel : stats) {
+            uint64_t reads = channel.value("num_reads_done", uint64_t(0));
+            result.reads += reads;
+            result.writes += channel.value("num_writes_done", uint64_t(0));
+            cmds += channel.value("num_read_cmds", uint64_t(0)) +
+                    channel.value("num_write_cmds", uint64_t(0));
+            hits += channel.value("num_read_row_hits", uint64_t(0)) +
+                    channel.value("num_write_row_hits", uint64_t(0));
+            latency_sum += reads * channel.value("average_read_latency", 0.0);
+        }
+    }
+    result.bandwidth = (result.reads + result.writes) * request_size /
+                       (cycles * tck);
+    result.read_latency = result.reads > 0 ? latency_sum / result.reads : 0.0;
+    result.row_hit_rate = cmds > 0 ? static_cast<double>(hits) / cmds : 0.0;
+    return result;
+}
+
+SweepRunner::SweepRunner(const std::string& sweep_file,
+                         const std::string& output_dir)
+    : output_dir_(output_dir), ini_(sweep_file), num_points_(1) {
+    if (ini_.ParseError() < 0) {
+        std::cerr << "Can't load config file - " << sweep_file << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    // INIReader has no way to list its keys, the swept ones are picked out
+    // of the text here, everything else is left to it
+    std::ifstream in(sweep_file);
+    std::string line, section;
+    while (std::getline(in, line)) {
+        line = Trim(line);
+        if (line.empty() || line[0] == ';' || line[0] == '#') {
+            continue;
+        }
+        if (line[0] == '[') {
+            section = Trim(line.substr(1, line.find(']') - 1));
+            continue;
+        }
+        auto eq = line.find('=');
+        auto open = line.find('{', eq);
+        if (eq == std::string::npos || open == std::string::npos ||
+            Trim(line.substr(eq + 1, open - eq - 1)) != "") {
+            continue;
+        }
+        auto close = line.find('}', open);
+        std::string key = section + "." + Trim(line.substr(0, eq));
+        if (close == std::string::npos) {
+            BadSweep(key, line.substr(open + 1));
+        }
+        SweepAxis axis;
+        axis.key = key;
+        axis.values = ExpandSweep(key, line.substr(open + 1, close - open - 1));
+        num_points_ *= axis.values.size();
+        axes_.push_back(axis);
+    }
+    if (axes_.empty()) {
+        std::cout << "WARNING: " << sweep_file
+                  << " has no {} values, sweeping a single point" << std::endl;
+    }
+}
+
+// first axis varies slowest, same order as nested loops over the file
+ConfigOverrides SweepRunner::PointOverrides(size_t point) const {
+    ConfigOverrides overrides;
+    for (auto it = axes_.rbegin(); it != axes_.rend(); ++it) {
+        overrides[it->key] = it->values[point % it->values.size()];
+        point /= it->values.size();
+    }
+    return overrides;
+}
+
+void SweepRunner::RunPoint(size_t point, const std::string& trace_file,
+                           const std::string& stream_type, uint64_t cycles) {
+    std::string point_dir = output_dir_ + "/point_" + std::to_string(point);
+    if (!MakeDir(point_dir)) {
+        std::cerr << "Can't create output directory " << point_dir
+                  << std::endl;
+        AbruptExit(__FILE__, __LINE__);
+    }
+    auto config =
+        std::make_shared<const Config>(ini_, PointOverrides(point), point_dir);
+    results_[point] = SimulatePoint(config, trace_file, stream_type, cycles);
+}
+
+void SweepRunner::Run(const std::string& trace_file,
+                      const std::string& stream_type, uint64_t cycles,
+                      int num_threads) {
+    results_.assign(num_points_, SweepResult());
+    std::atomic<size_t> next_point(0);
+    auto worker = [&]() {
+        for (size_t point = next_point++; point < num_points_;
+             point = next_point++) {
+            RunPoint(point, trace_file, stream_type, cycles);
+        }
+    };
+    int threads = std::max(1, std::min(num_threads,
+                                       static_cast<int>(num_points_)));
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(worker);
+    }
+    for (auto& t : workers) {
+        t.join();
+    }
+    WriteCSV();
+}
+
+void SweepRunner::PrintTable(std::ostream& where) const {
+    std::string header = fmt::format("{:>6}", "point");
+    for (const auto& axis : axes_) {
+        header +=
+            fmt::format(" {:>16}", axis.key.substr(axis.key.find('.') + 1));
+    }
+    header += fmt::format(" {:>10} {:>10} {:>8} {:>10} {:>10}", "bw(GB/s)",
+                          "rd_lat", "row_hit", "reads", "writes");
+    where << header << std::endl;
+    for (size_t point = 0; point < results_.size(); point++) {
+        auto overrides = PointOverrides(point);
+        std::string row = fmt::format("{:>6}", point);
+        for (const auto& axis : axes_) {
+            row += fmt::format(" {:>16}", overrides[axis.key]);
+        }
+        const auto& result = results_[point];
+        row += fmt::format(" {:>10.3f} {:>10.2f} {:>8.3f} {:>10} {:>10}",
+                           result.bandwidth, result.read_latency,
+                           result.row_hit_rate, result.reads, result.writes);
+        where << row << std::endl;
+    }
+}
+
+void SweepRunner::WriteCSV() const {
+    std::ofstream csv_out(output_dir_ + "/sweep.csv");
+    csv_out << "point";
+    for (const auto& axis : axes_) {
+        csv_out << "," << axis.key;
+    }
+    csv_out << ",cycles,bandwidth,read_latency,row_hit_rate,reads,writes"
+            << std::endl;
+    for (size_t point = 0; point < results_.size(); point++) {
+        auto overrides = PointOverrides(point);
+        csv_out << point;
+        for (const auto& axis : axes_) {
+            csv_out << "," << overrides[axis.key];
+        }
+        const auto& result = results_[point];
+        csv_out << "," << result.cycles << "," << result.bandwidth << ","
+                << result.read_latency << "," << result.row_hit_rate << ","
+                << result.reads << "," << result.writes << std::endl;
+    }
+}
+
+}  // namespace dramsim3
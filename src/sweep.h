@@ -0,0 +1,66 @@
+#ifndef __SWEEP_H
+#define __SWEEP_H
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "configuration.h"
+
+namespace dramsim3 {
+
+// One swept key and the values it takes, in order
+struct SweepAxis {
+    std::string key;  // section.key
+    std::vector<std::string> values;
+};
+
+// What the summary table reports for one point
+struct SweepResult {
+    uint64_t cycles;
+    uint64_t reads;
+    uint64_t writes;
+    double bandwidth;     // GB/s, summed over channels
+    double read_latency;  // cycles, averaged over all reads
+    double row_hit_rate;
+};
+
+// Runs the same workloads as dramsim3main on config, the trace if one is
+// given, otherwise the stream or random generator, and totals the per
+// channel stats it wrote
+SweepResult SimulatePoint(std::shared_ptr<const Config> config,
+                          const std::string& trace_file,
+                          const std::string& stream_type, uint64_t cycles);
+
+// Design space sweeps from a single ini file. Any value written in braces is
+// swept, either as a list {16, 32, 64} / {OPEN_PAGE, CLOSE_PAGE} or as an
+// inclusive range {start:stop} or {start:stop:step}. The cross product of
+// all swept keys is run on worker threads inside this process, each point
+// with its own Config built from the once parsed file plus the point's
+// values, and its stats in output_dir/point_<n>/. The results are collected
+// into one table, also written to output_dir/sweep.csv.
+class SweepRunner {
+   public:
+    SweepRunner(const std::string& sweep_file, const std::string& output_dir);
+    size_t NumPoints() const { return num_points_; }
+    // same workloads as dramsim3main, the trace if one is given, otherwise
+    // the stream or random generator
+    void Run(const std::string& trace_file, const std::string& stream_type,
+             uint64_t cycles, int num_threads);
+    void PrintTable(std::ostream& where) const;
+
+   private:
+    ConfigOverrides PointOverrides(size_t point) const;
+    void RunPoint(size_t point, const std::string& trace_file,
+                  const std::string& stream_type, uint64_t cycles);
+    void WriteCSV() const;
+
+    std::string output_dir_;
+    INIReader ini_;
+    std::vector<SweepAxis> axes_;
+    size_t num_points_;
+    std::vector<SweepResult> results_;
+};
+
+}  // namespace dramsim3
+#endif
@@ -22,7 +22,8 @@ namespace dramsim3 {
 
 std::function<Address(const Address &addr)> GetPhyAddress;
 
-ThermalCalculator::ThermalCalculator(const Config &config)
+ThermalCalculator::ThermalCalculator(const Config &config,
+                                     const OutputNames &outputs)
     : config_(config),
       time_iter0(10),
       sample_id(0),
@@ -104,23 +105,23 @@ ThermalCalculator::ThermalCalculator(const Config &config)
 
     if (config_.output_level >= 0) {
         // Initialize the output file
-        final_temperature_file_csv_.open(config_.output_prefix +
+        final_temperature_file_csv_.open(outputs.output_prefix +
                                          "final_temp.csv");
         PrintCSVHeader_final(final_temperature_file_csv_);
 
         // print bank position
-        bank_position_csv_.open(config_.output_prefix + "bank_pos.csv");
+        bank_position_csv_.open(outputs.output_prefix + "bank_pos.csv");
         PrintCSV_bank(bank_position_csv_);
 
         // a quick preview of max temperature for each layer of each epoch
-        epoch_max_temp_file_csv_.open(config_.output_prefix +
+        epoch_max_temp_file_csv_.open(outputs.output_prefix +
                                       "epoch_max_temp.csv");
         epoch_max_temp_file_csv_ << "layer,max_temp,epoch_time" << std::endl;
     }
 
     // print header to csv files
     if (config_.output_level >= 2) {
-        epoch_temperature_file_csv_.open(config_.output_prefix +
+        epoch_temperature_file_csv_.open(outputs.output_prefix +
                                          "epoch_temp.csv");
         epoch_temperature_file_csv_
             << "rank_channel_index,x,y,z,power,temperature,epoch" << std::endl;
@@ -18,7 +18,7 @@ extern std::function<Address(const Address &addr)> GetPhyAddress;
 
 class ThermalCalculator {
    public:
-    ThermalCalculator(const Config &config);
+    ThermalCalculator(const Config &config, const OutputNames &outputs);
     ~ThermalCalculator();
     void UpdateCMDPower(const int channel, const Command &cmd,
                         const uint64_t clk);
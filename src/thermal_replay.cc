@@ -7,11 +7,12 @@ using namespace dramsim3;
 ThermalReplay::ThermalReplay(std::string trace_name, std::string config_file,
                              std::string output_dir, uint64_t repeat)
     : config_(config_file, output_dir),
-      thermal_calc_(config_),
+      outputs_(config_),
+      thermal_calc_(config_, outputs_),
       repeat_(repeat),
       last_clk_(0) {
     for (int i = 0; i < config_.channels; i++) {
-        channel_stats_.emplace_back(config_, i);
+        channel_stats_.emplace_back(config_, outputs_, i);
     }
 
     // Initialize bank states, for power calculation we only need to know
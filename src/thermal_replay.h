@@ -22,6 +22,7 @@ class ThermalReplay {
    private:
     std::vector<std::pair<uint64_t, Command>> timed_commands_;
     Config config_;
+    OutputNames outputs_;
     ThermalCalculator thermal_calc_;
     uint64_t repeat_;
     uint64_t last_clk_;
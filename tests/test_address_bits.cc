@@ -0,0 +1,110 @@
+// address_bits decoding: the table gather (and PEXT in -DBMI2=ON builds)
+// against a plain bit by bit reference on layouts with split fields, and
+// AddressMapping against the fields the reference picks.
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "configuration.h"
+
+using namespace dramsim3;
+
+namespace {
+
+int Width(uint64_t mask) {
+    int width = 0;
+    for (; mask != 0; mask >>= 1) {
+        width++;
+    }
+    return width;
+}
+
+// the address bits picked by bits, lowest first, packed from bit 0
+uint64_t Pick(uint64_t hex_addr, uint64_t bits) {
+    uint64_t value = 0;
+    int out = 0;
+    for (int b = 0; b < 64; b++) {
+        if (bits >> b & 1) {
+            value |= (hex_addr >> b & 1) << out++;
+        }
+    }
+    return value;
+}
+
+uint64_t ReferenceGather(const Config &config, uint64_t hex_addr) {
+    return Pick(hex_addr, config.ch_bits) << config.ch_pos |
+           Pick(hex_addr, config.ra_bits) << config.ra_pos |
+           Pick(hex_addr, config.bg_bits) << config.bg_pos |
+           Pick(hex_addr, config.ba_bits) << config.ba_pos |
+           Pick(hex_addr, config.ro_bits) << config.ro_pos |
+           Pick(hex_addr, config.co_bits) << config.co_pos;
+}
+
+bool Check(const Config &config, uint64_t hex_addr) {
+    uint64_t shifted = hex_addr >> config.shift_bits;
+    uint64_t expected = ReferenceGather(config, shifted);
+    bool ok = config.GatherFieldsLUT(shifted) == expected;
+#ifdef __BMI2__
+    ok = ok && config.GatherFieldsPEXT(shifted) == expected;
+#endif  // __BMI2__
+    Address addr = config.AddressMapping(hex_addr);
+    ok = ok && addr.channel == static_cast<int>(Pick(shifted, config.ch_bits));
+    ok = ok && addr.rank == static_cast<int>(Pick(shifted, config.ra_bits));
+    ok = ok &&
+         addr.bankgroup == static_cast<int>(Pick(shifted, config.bg_bits));
+    ok = ok && addr.bank == static_cast<int>(Pick(shifted, config.ba_bits));
+    ok = ok && addr.row == static_cast<int>(Pick(shifted, config.ro_bits));
+    ok = ok && addr.column == static_cast<int>(Pick(shifted, config.co_bits));
+    if (!ok) {
+        std::cerr << config.address_bits << ": " << std::hex << hex_addr
+                  << std::dec << " decodes differently from the reference"
+                  << std::endl;
+    }
+    return ok;
+}
+
+}  // namespace
+
+// argv[1] is the configs directory
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <configs dir>" << std::endl;
+        return 1;
+    }
+    INIReader ini(std::string(argv[1]) + "/DDR4_8Gb_x8_3200.ini");
+    Config plain(ini, {{"system.channels", "2"}}, ".");
+    std::string ro = std::to_string(Width(plain.ro_mask));
+    std::string ra = std::to_string(Width(plain.ra_mask));
+    std::string bg = std::to_string(Width(plain.bg_mask));
+    std::string ba = std::to_string(Width(plain.ba_mask));
+    std::string co_high = std::to_string(Width(plain.co_mask) - 2);
+    // channel pairs interleaved every 256B with the other channel bit above
+    // the row, and two channels below the row with the low column bits under
+    // the bank group
+    std::vector<ConfigOverrides> layouts = {
+        {{"system.channels", "4"},
+         {"system.address_bits", "ch1 ro" + ro + " ra" + ra + " ba" + ba +
+                                     " bg" + bg + " co" + co_high + " ch1 co2"}},
+        {{"system.channels", "2"},
+         {"system.address_bits", "ro" + ro + " ch1 ra" + ra + " ba" + ba +
+                                     " co" + co_high + " bg" + bg + " co2"}}};
+
+    bool ok = true;
+    for (const auto &overrides : layouts) {
+        Config config(ini, overrides, ".");
+        std::vector<uint64_t> addrs = {0, ~uint64_t(0)};
+        for (int b = 0; b < 64; b++) {
+            addrs.push_back(uint64_t(1) << b);
+        }
+        std::mt19937_64 gen(39);
+        for (int i = 0; i < 100000; i++) {
+            addrs.push_back(gen());
+        }
+        for (auto hex_addr : addrs) {
+            ok = Check(config, hex_addr) && ok;
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+// Memory systems built on one shared Config and ticked from their own
+// threads have to finish their traffic exactly like the same systems run one
+// after another, anything else means instances share state. Built with
+// -DTSAN=ON this also catches races that happen not to change the results.
+
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "memory_system.h"
+
+using namespace dramsim3;
+
+namespace {
+
+const int kInstances = 4;
+const uint64_t kCycles = 30000;
+
+// Random reads and writes, some of them several bursts, different for each
+// seed. Returns a hash of every completion in order.
+uint64_t RunTraffic(std::shared_ptr<const Config> config, uint64_t seed) {
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](uint64_t value) {
+        hash = (hash ^ value) * 1099511628211ull;
+    };
+    auto callback = [](uint64_t) {};
+    MemorySystem memory_system(config, callback, callback);
+    memory_system.RegisterCompletionCallback([&mix](const Completion &done) {
+        mix(done.req_id);
+        mix(done.complete_cycle);
+        mix(static_cast<uint64_t>(done.served_by));
+    });
+
+    std::mt19937_64 gen(seed);
+    uint64_t req_id = 0;
+    uint64_t addr = gen() & 0xffffffc0;
+    bool is_write = gen() % 3 == 0;
+    uint32_t size = gen() % 8 == 0 ? 256 : 64;
+    for (uint64_t clk = 0; clk < kCycles; clk++) {
+        if (IsAccepted(memory_system.TryAddTransaction(addr, is_write, req_id,
+                                                       size))) {
+            req_id++;
+            addr = gen() & 0xffffffc0;
+            is_write = gen() % 3 == 0;
+            size = gen() % 8 == 0 ? 256 : 64;
+        }
+        memory_system.ClockTick();
+    }
+    mix(req_id);
+    return hash;
+}
+
+bool TestConfig(const std::string &config_file) {
+    auto config = std::make_shared<const Config>(config_file, ".");
+    std::vector<uint64_t> expected(kInstances);
+    for (int i = 0; i < kInstances; i++) {
+        expected[i] = RunTraffic(config, i + 1);
+    }
+
+    std::vector<uint64_t> hashes(kInstances);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kInstances; i++) {
+        threads.emplace_back(
+            [&, i]() { hashes[i] = RunTraffic(config, i + 1); });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    bool ok = true;
+    for (int i = 0; i < kInstances; i++) {
+        if (hashes[i] != expected[i]) {
+            std::cerr << config_file << ": instance " << i << " of "
+                      << kInstances << " diverged from its sequential run"
+                      << std::endl;
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+}  // namespace
+
+// argv[1] is the configs directory
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <configs dir>" << std::endl;
+        return 1;
+    }
+    std::string configs = argv[1];
+    bool ok = true;
+    for (const char *name : {"DDR4_8Gb_x8_3200.ini", "HBM2_4Gb_x128.ini"}) {
+        ok = TestConfig(configs + "/" + name) && ok;
+    }
+    return ok ? 0 : 1;
+}
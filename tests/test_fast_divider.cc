@@ -0,0 +1,134 @@
+// FastDivider against plain / and % on the divisors the radix mapping meets
+// and on the dividends where a multiply and shift division goes wrong first,
+// then a 3 channel DDR4 decoded against a mixed radix reference: every field
+// in range, the channels evenly used and GetChannel agreeing.
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "configuration.h"
+
+using namespace dramsim3;
+
+namespace {
+
+bool TestDivisor(uint64_t divisor) {
+    std::vector<uint64_t> dividends = {0, 1, ~uint64_t(0), ~uint64_t(0) - 1,
+                                       uint64_t(1) << 63,
+                                       (uint64_t(1) << 63) - 1,
+                                       uint64_t(1) << 32,
+                                       (uint64_t(1) << 32) - 1};
+    // around the first multiples and the last ones below 2^64
+    uint64_t last = ~uint64_t(0) / divisor * divisor;
+    for (uint64_t k = 1; k <= 4; k++) {
+        for (uint64_t base : {divisor * k, last - divisor * (k - 1)}) {
+            dividends.push_back(base - 1);
+            dividends.push_back(base);
+            if (base != ~uint64_t(0)) {
+                dividends.push_back(base + 1);
+            }
+        }
+    }
+    std::mt19937_64 gen(divisor);
+    for (int i = 0; i < 100000; i++) {
+        dividends.push_back(gen());
+        dividends.push_back(gen() >> (i % 64));
+    }
+
+    FastDivider divider(divisor);
+    for (auto n : dividends) {
+        if (divider.Divide(n) != n / divisor ||
+            divider.Modulo(n) != n % divisor) {
+            std::cerr << n << " / " << divisor << " gives "
+                      << divider.Divide(n) << " remainder "
+                      << divider.Modulo(n) << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TestThreeChannels(const INIReader &ini) {
+    Config config(ini, {{"system.channels", "3"}}, ".");
+    if (!config.IsRadixMapping()) {
+        std::cerr << "3 channels should use the radix mapping" << std::endl;
+        return false;
+    }
+    // least significant first, in the rochrababgco order of the config
+    const int counts[] = {config.columns / config.BL, config.bankgroups,
+                          config.banks_per_group, config.ranks,
+                          config.channels, config.rows};
+    auto reference = [&counts](uint64_t block) {
+        std::vector<int> fields;
+        for (int count : counts) {
+            fields.push_back(static_cast<int>(block % count));
+            block /= count;
+        }
+        return Address(fields[4], fields[3], fields[1], fields[2], fields[5],
+                       fields[0]);
+    };
+    uint64_t period = 1;
+    for (int i = 0; i < 5; i++) {
+        period *= counts[i];
+    }
+
+    // two channel periods from 0 and two from an unaligned block, then
+    // random blocks anywhere in the address space
+    std::vector<uint64_t> blocks;
+    for (uint64_t start : {uint64_t(0), period * 1000 + 7}) {
+        for (uint64_t b = start; b < start + 2 * period; b++) {
+            blocks.push_back(b);
+        }
+    }
+    std::mt19937_64 gen(40);
+    for (int i = 0; i < 100000; i++) {
+        blocks.push_back(gen() >> config.shift_bits);
+    }
+
+    std::vector<uint64_t> per_channel(config.channels, 0);
+    for (size_t i = 0; i < blocks.size(); i++) {
+        uint64_t hex_addr = blocks[i] << config.shift_bits;
+        Address addr = config.AddressMapping(hex_addr);
+        Address expected = reference(blocks[i]);
+        if (addr.channel != expected.channel || addr.rank != expected.rank ||
+            addr.bankgroup != expected.bankgroup ||
+            addr.bank != expected.bank || addr.row != expected.row ||
+            addr.column != expected.column ||
+            config.GetChannel(hex_addr) != expected.channel) {
+            std::cerr << std::hex << hex_addr << std::dec
+                      << " decodes differently from the reference"
+                      << std::endl;
+            return false;
+        }
+        if (i < 4 * period) {
+            per_channel[addr.channel]++;
+        }
+    }
+    for (auto count : per_channel) {
+        if (count != 4 * period / config.channels) {
+            std::cerr << "channels are not evenly used" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+// argv[1] is the configs directory
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <configs dir>" << std::endl;
+        return 1;
+    }
+    bool ok = true;
+    for (uint64_t divisor :
+         {uint64_t(3), uint64_t(6), uint64_t(12), (uint64_t(1) << 63) + 1}) {
+        ok = TestDivisor(divisor) && ok;
+    }
+    INIReader ini(std::string(argv[1]) + "/DDR4_8Gb_x8_3200.ini");
+    ok = TestThreeChannels(ini) && ok;
+    return ok ? 0 : 1;
+}